@@ -32,6 +32,9 @@ int main(int argc, char** argv)
   // port
   std::string port = "4141";
 
+  // reconnect automatically when the connection drops
+  bool reconnect = false;
+
   description.add_options()
     ("help,h", "Display this help message.")
     ("settings-file,s", po::value<std::string>(),
@@ -63,7 +66,9 @@ int main(int argc, char** argv)
       "minimum cloud size; produces an error and ignores clouds smaller than this.")
     ("max-cloud-size", po::value<std::int32_t>(&pipeline_settings.max_cloud_size)->
       default_value(pipeline_settings.max_cloud_size),
-      "maximum cloud size; produces an error and ignores clouds larger than this.");
+      "maximum cloud size; produces an error and ignores clouds larger than this.")
+    ("reconnect", po::bool_switch(&reconnect),
+      "Flag indicating the client should keep reconnecting when the connection fails or drops.");
 
   try
   {
@@ -136,6 +141,15 @@ int main(int argc, char** argv)
 
   // create client to get raw packets from the sensor
   quanergy::client::SensorClient client(pipeline_settings.host, port, 100);
+  client.setOptions(pipeline_settings.client_options);
+  // kernel timestamps come with bulk reads only
+  if (pipeline_settings.client_options.kernel_timestamps)
+    client.setReceiveMode(quanergy::client::ReceiveMode::BULK);
+  if (reconnect)
+  {
+    client.setReconnect(true);
+    client.setConnectTimeout(std::chrono::seconds(2));
+  }
 
   // create pipeline to produce point cloud from raw packets
   quanergy::pipeline::SensorPipeline pipeline(pipeline_settings);
@@ -146,19 +160,35 @@ int main(int argc, char** argv)
   ////////////////////////////////////////////
   /// if you'd like to parse the packets yourself, connect here
   ////////////////////////////////////////////
-  // connect the packets from the client to the sensor pipeline
-  connections.push_back(client.connect(
-      [&pipeline](const std::shared_ptr<std::vector<char>>& packet){ pipeline.slot(packet); }
+  // connect the packets from the client to the sensor pipeline; batches save a signal call per packet
+  connections.push_back(client.connectBatch(
+      [&pipeline](const quanergy::client::SensorClient::BatchType& packets){ pipeline.batchSlot(packets); }
   ));
   
   ////////////////////////////////////////////
   /// connect application specific logic here to consume the point cloud
   ////////////////////////////////////////////
-  // here we'll simply count the number of packets and output every 100
+  // here we'll simply count the number of packets and output every 100 along with any packets dropped
   unsigned int cloud_count = 0;
   connections.push_back(pipeline.connect(
-      [&cloud_count](const boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>& /*pc*/)
-      { ++cloud_count; if(cloud_count % 100 == 0) std::cout << "clouds received: " << cloud_count << std::endl; }
+      [&cloud_count, &client](const boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>& pc)
+      {
+        ++cloud_count;
+        if(cloud_count == 1)
+          std::cout << "client options applied: " << client.appliedOptions() << std::endl;
+        if(cloud_count % 100 == 0)
+        {
+          // time from the last packet of the frame arriving to the cloud getting here
+          std::uint64_t arrival_ns = quanergy::common::getArrivalTime(pc);
+          std::int64_t latency_us = (arrival_ns == 0) ? 0 :
+            (static_cast<std::int64_t>(quanergy::common::arrivalClockNanoseconds()) -
+             static_cast<std::int64_t>(arrival_ns)) / 1000;
+
+          std::cout << "clouds received: " << cloud_count
+                    << "; packets dropped: " << client.queueStatistics().dropped_items
+                    << "; latency: " << latency_us << " us" << std::endl;
+        }
+      }
   ));
 
   // variables to help with control flow
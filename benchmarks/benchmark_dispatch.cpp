@@ -0,0 +1,111 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file benchmark_dispatch.cpp
+ *
+ *  \brief Measures the per packet cost of finding the parser in VariadicPacketParser,
+ *         walking the parsers' validate functions versus dispatching on the packet key
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+
+#include <quanergy/parsers/variadic_packet_parser.h>
+
+namespace
+{
+  /// parser doing nothing but the header check of the data packet parsers; matched by validate only
+  template <std::uint8_t TYPE>
+  struct ValidatedParser : public quanergy::client::PacketParserBase<int>
+  {
+    virtual bool validate(const std::vector<char>& packet) override
+    {
+      using quanergy::client::deserialize;
+      const quanergy::client::PacketHeader* h =
+        reinterpret_cast<const quanergy::client::PacketHeader*>(packet.data());
+
+      return (deserialize(h->packet_type) == TYPE
+              && deserialize(h->version_major) == 0x00
+              && deserialize(h->version_minor) == 0x01
+              && deserialize(h->version_patch) == 0x00);
+    }
+
+    virtual bool parse(const std::vector<char>&, int& result) override
+    {
+      ++result;
+      return false;
+    }
+  };
+
+  /// the same parser with a packet key, as the data packet parsers have
+  template <std::uint8_t TYPE>
+  struct KeyedParser : public ValidatedParser<TYPE>
+  {
+    static constexpr quanergy::client::PacketKey packetKey()
+    {
+      return quanergy::client::makePacketKey(TYPE, 0x00, 0x01, 0x00);
+    }
+  };
+
+  std::vector<char> packet(std::uint8_t packet_type)
+  {
+    std::vector<char> ret(sizeof(quanergy::client::PacketHeader));
+    quanergy::client::PacketHeader& header = *reinterpret_cast<quanergy::client::PacketHeader*>(ret.data());
+    header.version_major = 0x00;
+    header.version_minor = 0x01;
+    header.version_patch = 0x00;
+    header.packet_type = packet_type;
+    return ret;
+  }
+
+  template <class PARSER>
+  void runCase(const std::string& name, const std::vector<std::vector<char>>& packets, std::size_t count)
+  {
+    PARSER parser;
+    int parsed = 0;
+
+    auto start_time = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      parser.validateParse(packets[i % packets.size()], parsed);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::cout << std::left << std::setw(36) << name
+              << " packets: " << std::setw(10) << parsed
+              << " dispatch: " << std::fixed << std::setprecision(2) << elapsed / count << " ns/packet"
+              << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t count = 50000000;
+  if (argc > 1)
+    count = std::stoul(argv[1]);
+
+  // the parser order of SensorPipeline; the last parser is tried first
+  typedef quanergy::client::VariadicPacketParser<int, ValidatedParser<0x00>, ValidatedParser<0x01>,
+                                                 ValidatedParser<0x04>, ValidatedParser<0x06>> Validated;
+  typedef quanergy::client::VariadicPacketParser<int, KeyedParser<0x00>, KeyedParser<0x01>,
+                                                 KeyedParser<0x04>, KeyedParser<0x06>> Keyed;
+
+  const std::vector<std::vector<char>> first_tried = {packet(0x06)};
+  const std::vector<std::vector<char>> last_tried = {packet(0x00)};
+  const std::vector<std::vector<char>> mixed = {packet(0x00), packet(0x04), packet(0x06), packet(0x01)};
+
+  runCase<Validated>("validate walk, first parser tried", first_tried, count);
+  runCase<Keyed>("packet key, first parser tried", first_tried, count);
+  runCase<Validated>("validate walk, last parser tried", last_tried, count);
+  runCase<Keyed>("packet key, last parser tried", last_tried, count);
+  runCase<Validated>("validate walk, mixed types", mixed, count);
+  runCase<Keyed>("packet key, mixed types", mixed, count);
+
+  return 0;
+}
@@ -0,0 +1,127 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file benchmark_fused.cpp
+ *
+ *  \brief Measures the per frame cost of getting from a parsed HVDIR cloud to XYZIR, through the
+ *         encoder correction, filter and conversion modules versus FusedPolarToCartConverter
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+
+#include <quanergy/modules/encoder_angle_calibration.h>
+#include <quanergy/modules/distance_filter.h>
+#include <quanergy/modules/ring_intensity_filter.h>
+#include <quanergy/modules/polar_to_cart_converter.h>
+#include <quanergy/modules/fused_polar_to_cart_converter.h>
+#include <quanergy/parsers/data_packet_parser_m_series.h>
+
+namespace
+{
+  /// an organized M8 frame of one revolution
+  quanergy::PointCloudHVDIRPtr frame()
+  {
+    using namespace quanergy::client;
+
+    quanergy::PointCloudHVDIRPtr ret(new quanergy::PointCloudHVDIR());
+    for (int laser = 0; laser < M_SERIES_NUM_LASERS; ++laser)
+    {
+      for (int i = 0; i < M_SERIES_NUM_ROT_ANGLES; ++i)
+      {
+        quanergy::PointHVDIR point;
+        point.h = static_cast<double>(i) / M_SERIES_NUM_ROT_ANGLES * 2. * M_PI - M_PI;
+        point.v = M8_VERTICAL_ANGLES[laser];
+        point.d = i % 97 == 0 ? std::numeric_limits<float>::quiet_NaN() : 1.f + (i % 5000) * 0.01f;
+        point.intensity = static_cast<float>(i % 256);
+        point.ring = laser;
+        ret->points.push_back(point);
+      }
+    }
+
+    ret->width = M_SERIES_NUM_ROT_ANGLES;
+    ret->height = M_SERIES_NUM_LASERS;
+    ret->is_dense = false;
+    return ret;
+  }
+
+  void report(const std::string& name, std::size_t count, std::size_t points, double elapsed)
+  {
+    std::cout << std::left << std::setw(20) << name
+              << " frames: " << std::setw(6) << count
+              << " points: " << std::setw(10) << points
+              << " convert: " << std::fixed << std::setprecision(3) << elapsed / count / 1E6 << " ms/frame"
+              << std::endl;
+  }
+
+  void runModules(std::size_t count)
+  {
+    quanergy::calibration::EncoderAngleCalibration encoder_corrector;
+    quanergy::client::DistanceFilter distance_filter;
+    quanergy::client::RingIntensityFilter ring_intensity_filter;
+    quanergy::client::PolarToCartConverter cartesian_converter;
+
+    encoder_corrector.setParams(0.01, 0.5);
+    distance_filter.setMinimumDistanceThreshold(1.f);
+    distance_filter.setMaximumDistanceThreshold(40.f);
+
+    std::size_t points = 0;
+    encoder_corrector.connect([&](const quanergy::PointCloudHVDIRPtr& pc){ distance_filter.slot(pc); });
+    distance_filter.connect([&](const quanergy::PointCloudHVDIRPtr& pc){ ring_intensity_filter.slot(pc); });
+    ring_intensity_filter.connect([&](const quanergy::PointCloudHVDIRPtr& pc){ cartesian_converter.slot(pc); });
+    cartesian_converter.connect([&](const quanergy::PointCloudXYZIRPtr& pc){ points += pc->size(); });
+
+    // the corrector corrects in place, shifting the angles a little more each time, which costs the same
+    auto input = frame();
+
+    auto start_time = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      encoder_corrector.slot(input);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+
+    report("modules", count, points, elapsed);
+  }
+
+  void runFused(std::size_t count)
+  {
+    quanergy::client::FusedPolarToCartConverter fused_converter;
+
+    fused_converter.setEncoderParams(0.01, 0.5);
+    fused_converter.setMinimumDistanceThreshold(1.f);
+    fused_converter.setMaximumDistanceThreshold(40.f);
+
+    std::size_t points = 0;
+    fused_converter.connect([&](const quanergy::PointCloudXYZIRPtr& pc){ points += pc->size(); });
+
+    auto input = frame();
+
+    auto start_time = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      fused_converter.slot(input);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+
+    report("fused", count, points, elapsed);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t count = 200;
+  if (argc > 1)
+    count = std::stoul(argv[1]);
+
+  runModules(count);
+  runFused(count);
+
+  return 0;
+}
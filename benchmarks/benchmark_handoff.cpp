@@ -0,0 +1,98 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file benchmark_handoff.cpp
+ *
+ *  \brief Compares the locked queue and SPSC ring handoff in TCPClient
+ *         by streaming packets over loopback
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+
+#include <quanergy/client/sensor_client.h>
+
+#include "loopback_sender.h"
+
+namespace
+{
+  // M8 packet size and rate (53828 firings per second, 50 firings per packet)
+  const std::uint32_t PACKET_SIZE = 6632;
+  const double SENSOR_PACKET_RATE = 53828. / 50.;
+
+  void runCase(const std::string& name, quanergy::client::HandoffMode mode,
+               std::size_t count, double packets_per_second)
+  {
+    quanergy::benchmark::LoopbackSender sender;
+    quanergy::client::SensorClient client("127.0.0.1", sender.port(), 100);
+    client.setHandoffMode(mode);
+
+    std::atomic<std::size_t> received {0};
+    client.connect([&received](const quanergy::client::SensorClient::ResultType&) { ++received; });
+
+    sender.start(count, PACKET_SIZE, packets_per_second);
+
+    auto start_time = std::chrono::steady_clock::now();
+    std::thread client_thread([&client]
+    {
+      try
+      {
+        client.run();
+      }
+      catch (std::exception&)
+      {
+        // the sender closing the connection ends the run
+      }
+    });
+
+    sender.join();
+
+    // wait for the client to drain; packets dropped on a full queue never arrive
+    auto last_progress = std::chrono::steady_clock::now();
+    std::size_t last_received = received;
+    while (received < count &&
+           std::chrono::steady_clock::now() - last_progress < std::chrono::milliseconds(200))
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      if (received != last_received)
+      {
+        last_received = received;
+        last_progress = std::chrono::steady_clock::now();
+      }
+    }
+    auto elapsed = std::chrono::duration<double>(last_progress - start_time).count();
+
+    client.stop();
+    client_thread.join();
+
+    const auto& latency = client.handoffLatency();
+    std::cout << std::left << std::setw(28) << name
+              << " packets: " << std::setw(8) << received
+              << " dropped: " << std::setw(6) << count - received
+              << " rate: " << std::setw(10) << static_cast<std::size_t>(received / elapsed) << " pkt/s"
+              << " p50: " << std::setw(8) << latency.percentile(0.5) << " ns"
+              << " p99: " << std::setw(8) << latency.percentile(0.99) << " ns"
+              << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t count = 20000;
+  if (argc > 1)
+    count = std::stoul(argv[1]);
+
+  using quanergy::client::HandoffMode;
+
+  runCase("locked queue, sensor rate", HandoffMode::LOCKED_QUEUE, count / 4, SENSOR_PACKET_RATE * 4);
+  runCase("spsc ring, sensor rate", HandoffMode::SPSC_RING, count / 4, SENSOR_PACKET_RATE * 4);
+  runCase("locked queue, flood", HandoffMode::LOCKED_QUEUE, count, 0.);
+  runCase("spsc ring, flood", HandoffMode::SPSC_RING, count, 0.);
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file benchmark_m1.cpp
+ *
+ *  \brief Measures the per packet parse time of DataPacketParser06 on a stream of
+ *         synthetic M1 packets, with single and triple returns, in full and for a region of interest
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+
+#include <quanergy/parsers/data_packet_parser_06.h>
+
+namespace
+{
+  // one encoder count per firing; a revolution is a whole number of packets
+  const std::size_t PACKETS_PER_REVOLUTION =
+    quanergy::client::M_SERIES_NUM_ROT_ANGLES / quanergy::client::M_SERIES_FIRING_PER_PKT;
+
+  /// one M1 packet in network order
+  template <std::uint8_t R>
+  std::vector<char> packet06(std::size_t packet_index, std::uint8_t return_id)
+  {
+    using namespace quanergy::client;
+
+    std::vector<char> ret(sizeof(DataPacket06<R>));
+    DataPacket06<R>& packet = *reinterpret_cast<DataPacket06<R>*>(ret.data());
+
+    packet.packet_header.signature = htonl(SIGNATURE);
+    packet.packet_header.size = htonl(ret.size());
+    packet.packet_header.version_major = 0;
+    packet.packet_header.version_minor = 1;
+    packet.packet_header.version_patch = 0;
+    packet.packet_header.packet_type = 0x06;
+
+    packet.data_header.status = 0;
+    packet.data_header.return_id = return_id;
+
+    for (int f = 0; f < M_SERIES_FIRING_PER_PKT; ++f)
+    {
+      const std::size_t firing = packet_index * M_SERIES_FIRING_PER_PKT + f;
+      M1FiringData<R>& data = packet.data.firings[f];
+      data.position = htons(static_cast<std::uint16_t>(firing % M_SERIES_NUM_ROT_ANGLES));
+
+      for (int r = 0; r < R; ++r)
+      {
+        // an occasional missing return
+        data.radius[r] = htonl(firing % 97 == 0 ? 0 : static_cast<std::uint32_t>(100000 + firing % 5000 + r));
+        data.intensity[r] = static_cast<std::uint8_t>(firing + r);
+      }
+    }
+
+    return ret;
+  }
+
+  template <std::uint8_t R>
+  void runCase(const std::string& name, std::uint8_t return_id, int return_selection, std::size_t count,
+               const std::vector<quanergy::client::AzimuthInterval>& region = {})
+  {
+    // a revolution of packets, parsed over and over with increasing stamps
+    std::vector<std::vector<char>> packets;
+    for (std::size_t i = 0; i < PACKETS_PER_REVOLUTION; ++i)
+      packets.push_back(packet06<R>(i, return_id));
+
+    quanergy::client::DataPacketParser06 parser;
+    parser.setReturnSelection(return_selection);
+    parser.setRegionOfInterest(region);
+
+    std::size_t clouds = 0;
+    std::size_t points = 0;
+
+    auto start_time = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      std::vector<char>& packet = packets[i % packets.size()];
+      auto& header = *reinterpret_cast<quanergy::client::PacketHeader*>(packet.data());
+      header.seconds = htonl(static_cast<std::uint32_t>(i / 1000));
+      header.nanoseconds = htonl(static_cast<std::uint32_t>(i % 1000 * 1000000));
+
+      quanergy::PointCloudHVDIRPtr cloud;
+      if (parser.parse(packet, cloud))
+      {
+        ++clouds;
+        points += cloud->size();
+      }
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::cout << std::left << std::setw(30) << name
+              << " packets: " << std::setw(8) << count
+              << " clouds: " << std::setw(6) << clouds
+              << " points: " << std::setw(10) << points
+              << " parse: " << std::fixed << std::setprecision(1) << elapsed / count << " ns/packet"
+              << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t count = 200000;
+  if (argc > 1)
+    count = std::stoul(argv[1]);
+
+  runCase<1>("single return", 0, 0, count);
+  runCase<3>("triple, return 1", 3, 1, count);
+  runCase<3>("triple, all returns", 3, quanergy::client::ALL_RETURNS, count);
+
+  // a forward facing 120 degree wedge
+  const std::vector<quanergy::client::AzimuthInterval> wedge = {{8667, 1733}};
+  runCase<1>("single return, 120 deg", 0, 0, count, wedge);
+  runCase<3>("triple, all returns, 120 deg", 3, quanergy::client::ALL_RETURNS, count, wedge);
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file benchmark_receive.cpp
+ *
+ *  \brief Compares the per packet, bulk and io_uring receive modes in TCPClient
+ *         by streaming packets over loopback and measuring socket thread CPU time
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <ctime>
+
+#include <quanergy/client/sensor_client.h>
+
+#include "loopback_sender.h"
+
+namespace
+{
+  // M8 packet size and rate (53828 firings per second, 50 firings per packet)
+  const std::uint32_t PACKET_SIZE = 6632;
+  const double SENSOR_PACKET_RATE = 53828. / 50.;
+
+  /// CPU time of the calling thread in seconds; process time where not available
+  double threadCpuSeconds()
+  {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1E-9;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+  }
+
+  void runCase(const std::string& name, quanergy::client::ReceiveMode mode,
+               std::size_t count, double packets_per_second)
+  {
+    quanergy::benchmark::LoopbackSender sender;
+    quanergy::client::SensorClient client("127.0.0.1", sender.port(), 100);
+    client.setReceiveMode(mode);
+    // measure the receive path, not drops
+    client.setBackpressurePolicy(quanergy::common::BackpressurePolicy::BLOCK_PRODUCER);
+
+    std::atomic<std::size_t> received {0};
+    client.connectBatch([&received](const quanergy::client::SensorClient::BatchType& packets)
+                        {
+                          received += packets.size();
+                        });
+
+    sender.start(count, PACKET_SIZE, packets_per_second);
+
+    double cpu_seconds = 0.;
+    auto start_time = std::chrono::steady_clock::now();
+    std::thread client_thread([&client, &cpu_seconds]
+    {
+      double start_cpu = threadCpuSeconds();
+      try
+      {
+        client.run();
+      }
+      catch (std::exception&)
+      {
+        // the sender closing the connection ends the run
+      }
+      cpu_seconds = threadCpuSeconds() - start_cpu;
+    });
+
+    sender.join();
+
+    // wait for the client to drain
+    auto last_progress = std::chrono::steady_clock::now();
+    std::size_t last_received = received;
+    while (received < count &&
+           std::chrono::steady_clock::now() - last_progress < std::chrono::milliseconds(200))
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      if (received != last_received)
+      {
+        last_received = received;
+        last_progress = std::chrono::steady_clock::now();
+      }
+    }
+    auto elapsed = std::chrono::duration<double>(last_progress - start_time).count();
+
+    client.stop();
+    client_thread.join();
+
+    std::string mode_used = "";
+    for (const auto& error : client.appliedOptions().errors)
+      mode_used += " (" + error + ")";
+
+    std::cout << std::left << std::setw(26) << name
+              << " packets: " << std::setw(8) << received
+              << " rate: " << std::setw(10) << static_cast<std::size_t>(received / elapsed) << " pkt/s"
+              << " socket thread CPU: " << std::setw(8)
+              << static_cast<std::size_t>(received ? cpu_seconds * 1E9 / received : 0) << " ns/pkt"
+              << mode_used
+              << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::size_t count = 20000;
+  if (argc > 1)
+    count = std::stoul(argv[1]);
+
+  using quanergy::client::ReceiveMode;
+
+  runCase("per packet, sensor rate", ReceiveMode::PER_PACKET, count / 4, SENSOR_PACKET_RATE * 4);
+  runCase("bulk, sensor rate", ReceiveMode::BULK, count / 4, SENSOR_PACKET_RATE * 4);
+  runCase("io_uring, sensor rate", ReceiveMode::IO_URING, count / 4, SENSOR_PACKET_RATE * 4);
+  runCase("per packet, flood", ReceiveMode::PER_PACKET, count, 0.);
+  runCase("bulk, flood", ReceiveMode::BULK, count, 0.);
+  runCase("io_uring, flood", ReceiveMode::IO_URING, count, 0.);
+
+  return 0;
+}
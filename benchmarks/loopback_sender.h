@@ -0,0 +1,126 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file loopback_sender.h
+ *
+ *  \brief Serves synthetic sensor packets on a loopback port for benchmarks
+ */
+
+#ifndef QUANERGY_BENCHMARKS_LOOPBACK_SENDER_H
+#define QUANERGY_BENCHMARKS_LOOPBACK_SENDER_H
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstring>
+
+#include <boost/asio.hpp>
+
+#include <quanergy/client/packet_header.h>
+
+namespace quanergy
+{
+  namespace benchmark
+  {
+    /// build a packet with a valid header and a recognizable body
+    inline std::vector<char> makePacket(std::uint32_t size, std::uint32_t sequence, std::uint8_t packet_type = 0x00)
+    {
+      std::vector<char> packet(size, 0);
+
+      client::PacketHeader header;
+      header.signature     = htonl(client::SIGNATURE);
+      header.size          = htonl(size);
+      header.seconds       = htonl(sequence);
+      header.nanoseconds   = 0;
+      header.version_major = 0;
+      header.version_minor = 1;
+      header.version_patch = 0;
+      header.packet_type   = packet_type;
+      std::memcpy(packet.data(), &header, sizeof(header));
+
+      for (std::size_t i = sizeof(header); i < size; ++i)
+        packet[i] = static_cast<char>(sequence + i);
+
+      return packet;
+    }
+
+    /** \brief LoopbackSender accepts one connection and writes packets to it
+     *  \details packets_per_second of 0 sends as fast as the socket allows
+     */
+    class LoopbackSender
+    {
+    public:
+      LoopbackSender()
+        : acceptor_(io_service_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+      {
+      }
+
+      ~LoopbackSender()
+      {
+        if (thread_.joinable())
+          thread_.join();
+      }
+
+      std::string port() const
+      {
+        return std::to_string(acceptor_.local_endpoint().port());
+      }
+
+      /// start serving count packets of packet_size bytes on a separate thread
+      void start(std::size_t count, std::uint32_t packet_size, double packets_per_second)
+      {
+        thread_ = std::thread([this, count, packet_size, packets_per_second]
+        {
+          boost::asio::ip::tcp::socket socket(io_service_);
+          acceptor_.accept(socket);
+
+          // send in batches so pacing doesn't cost a syscall per packet at high rates
+          const std::size_t batch = packets_per_second > 0. ? 1 : 64;
+          std::vector<char> buffer;
+          auto start_time = std::chrono::steady_clock::now();
+
+          for (std::size_t i = 0; i < count; i += batch)
+          {
+            buffer.clear();
+            for (std::size_t j = i; j < std::min(count, i + batch); ++j)
+            {
+              auto packet = makePacket(packet_size, static_cast<std::uint32_t>(j));
+              buffer.insert(buffer.end(), packet.begin(), packet.end());
+            }
+
+            if (packets_per_second > 0.)
+            {
+              std::this_thread::sleep_until(start_time + std::chrono::nanoseconds(
+                static_cast<std::int64_t>(1E9 * static_cast<double>(i) / packets_per_second)));
+            }
+
+            boost::system::error_code error;
+            boost::asio::write(socket, boost::asio::buffer(buffer), error);
+            if (error)
+              return;
+          }
+        });
+      }
+
+      /// wait for the sender to finish
+      void join()
+      {
+        if (thread_.joinable())
+          thread_.join();
+      }
+
+    private:
+      boost::asio::io_service         io_service_;
+      boost::asio::ip::tcp::acceptor  acceptor_;
+      std::thread                     thread_;
+    };
+
+  } // namespace benchmark
+
+} // namespace quanergy
+
+#endif
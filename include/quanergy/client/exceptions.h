@@ -109,6 +109,13 @@ namespace quanergy
         : std::runtime_error(message) {}
     };
 
+    /** \brief Invalid region of interest provided */
+    struct InvalidRegionOfInterest: public std::runtime_error
+    {
+      explicit InvalidRegionOfInterest(const std::string& message)
+        : std::runtime_error(message) {}
+    };
+
     /** \brief HTTP response malformed */
     struct InvalidHTTPResponse : public std::exception
     {
@@ -10,8 +10,8 @@
 #include <quanergy/client/tcp_client.h>
 
 #include <iostream>
-
-#include <boost/version.hpp>
+#include <cstring>
+#include <algorithm>
 
 namespace quanergy
 {
@@ -23,8 +23,33 @@ namespace quanergy
                    std::string const & port,
                    std::size_t max_queue_size)
       : buff_(sizeof(HEADER))
+      , own_io_service_(new boost::asio::io_service())
+      , io_service_(*own_io_service_)
+      , strand_(io_service_)
+      , connect_timer_(io_service_)
+      , reconnect_timer_(io_service_)
+      , resolver_(io_service_)
       , host_query_(host, port)
-      , max_queue_size_(max_queue_size)
+      , buff_queue_(max_queue_size)
+      , buffer_pool_(2 * max_queue_size + MAX_STREAM_BUFFERS)
+      , kill_(true)
+    {
+    }
+
+    template <class HEADER>
+    TCPClient<HEADER>::TCPClient(boost::asio::io_service& io_service,
+                   std::string const & host,
+                   std::string const & port,
+                   std::size_t max_queue_size)
+      : buff_(sizeof(HEADER))
+      , io_service_(io_service)
+      , strand_(io_service_)
+      , connect_timer_(io_service_)
+      , reconnect_timer_(io_service_)
+      , resolver_(io_service_)
+      , host_query_(host, port)
+      , buff_queue_(max_queue_size)
+      , buffer_pool_(2 * max_queue_size + MAX_STREAM_BUFFERS)
       , kill_(true)
     {
     }
@@ -33,6 +58,7 @@ namespace quanergy
     TCPClient<HEADER>::~TCPClient()
     {
       stop();
+      closeUring();
       read_socket_.reset();
     }
 
@@ -42,6 +68,12 @@ namespace quanergy
       return signal_.connect(subscriber);
     }
 
+    template <class HEADER>
+    boost::signals2::connection TCPClient<HEADER>::connectBatch(const typename BatchSignal::slot_type& subscriber)
+    {
+      return batch_signal_.connect(subscriber);
+    }
+
     template <class HEADER>
     void TCPClient<HEADER>::run()
     {
@@ -50,8 +82,19 @@ namespace quanergy
 
       kill_ = false;
       read_socket_.reset(new boost::asio::ip::tcp::socket(io_service_));
+
       io_service_.reset();
 
+      resetSession();
+
+      // this thread runs the io_service; it belongs to the caller, so it is put back as it was below
+      SavedThreadOptions saved_io_thread;
+      {
+        std::lock_guard<std::mutex> lk(options_mutex_);
+        applyThreadOptions(options_.io_thread, "io thread",
+                           applied_options_.io_thread, applied_options_.errors, &saved_io_thread);
+      }
+
       std::exception_ptr eptr;
       try
       {
@@ -62,6 +105,13 @@ namespace quanergy
                                             {
                                               try
                                               {
+                                                {
+                                                  std::lock_guard<std::mutex> lk(options_mutex_);
+                                                  applyThreadOptions(options_.signal_thread, "signal thread",
+                                                                     applied_options_.signal_thread,
+                                                                     applied_options_.errors);
+                                                }
+
                                                 signalPackets();
                                               }
                                               catch (...)
@@ -82,19 +132,66 @@ namespace quanergy
 
       signal_thread_->join();
       signal_thread_.reset();
+      restoreThreadOptions(saved_io_thread);
+
+      // the io_service may have stopped on an exception before the close posted by stop ran;
+      // the io_uring receive lets go of the socket before it is closed
+      closeUring();
+      {
+        boost::system::error_code ignored;
+        read_socket_->close(ignored);
+      }
+
+      // run what is left, including the handlers of cancelled operations, while they still see
+      // kill_ rather than in the next run
+      io_service_.reset();
+      io_service_.poll();
+      packet_.reset();
+      stream_buffers_.clear();
+      batch_.clear();
 
+      // remove anything still in the queue
+      buff_queue_.clear();
+
+      if (ring_)
       {
-        std::unique_lock<std::mutex> lk(buff_queue_mutex_);
-        // remove anything still in the queue
-        while (!buff_queue_.empty())
+        QueuedPacket queued;
+        while (ring_->pop(queued))
         {
-          buff_queue_.pop();
         }
       }
 
       if (eptr) std::rethrow_exception(eptr);
     }
 
+    template <class HEADER>
+    void TCPClient<HEADER>::start(std::function<void ()> packets_ready)
+    {
+      if (!kill_)
+        return;
+
+      kill_ = false;
+      packets_ready_ = packets_ready;
+      drain_scheduled_ = false;
+      {
+        std::lock_guard<std::mutex> lk(error_mutex_);
+        error_ = nullptr;
+      }
+
+      read_socket_.reset(new boost::asio::ip::tcp::socket(io_service_));
+      resetSession();
+
+      if (!options_.io_thread.cpus.empty() || options_.io_thread.policy != SchedulingPolicy::DEFAULT ||
+          !options_.signal_thread.cpus.empty() || options_.signal_thread.policy != SchedulingPolicy::DEFAULT)
+      {
+        std::lock_guard<std::mutex> lk(options_mutex_);
+        applied_options_.errors.push_back("thread options: threads belong to the owner of the shared io_service");
+      }
+
+      // connect from an io thread so resolve errors are handled like any other
+      io_service_.post(guard([this]{ startDataConnect(); }));
+    }
+
     template <class HEADER>
     void TCPClient<HEADER>::stop()
     {
@@ -102,70 +199,346 @@ namespace quanergy
         return;
 
       kill_ = true;
-      // close socket before stopping service to cancel async operations
-      read_socket_->close();
-      // guarantee we recognize the closed socket before stopping
-      io_service_.run_one();
-      io_service_.stop();
+      // release a socket thread blocked on a full queue before waiting on it below
+      buff_queue_.close();
+      ring_waiter_.notifyAll();
+
+      if (!own_io_service_)
+      {
+        // other clients keep the io_service running; close on the strand to cancel our operations
+        strand_.post([this]
+                     {
+                       boost::system::error_code ignored;
+                       closeUring();
+                       read_socket_->close(ignored);
+                       resolver_.cancel();
+                       connect_timer_.cancel(ignored);
+                       reconnect_timer_.cancel(ignored);
+                     });
+
+        if (packets_ready_)
+          packets_ready_();
+
+        return;
+      }
+
+      // close socket and cancel timers on the io thread to cancel async operations, after which
+      // io_service_.run returns; the io_uring receive must let go of the socket before it closes,
+      // as in scheduleReconnect
+      strand_.post([this]
+                   {
+                     // a run started since has a socket and receiver of its own
+                     if (!kill_)
+                       return;
+
+                     boost::system::error_code ignored;
+                     closeUring();
+                     read_socket_->close(ignored);
+                     resolver_.cancel();
+                     connect_timer_.cancel(ignored);
+                     reconnect_timer_.cancel(ignored);
+                   });
+    }
+
+    template <class HEADER>
+    std::exception_ptr TCPClient<HEADER>::error() const
+    {
+      std::lock_guard<std::mutex> lk(error_mutex_);
+      return error_;
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::fail(std::exception_ptr error)
+    {
+      {
+        std::lock_guard<std::mutex> lk(error_mutex_);
+        if (!error_)
+          error_ = error;
+      }
+
+      stop();
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::resetSession()
+    {
+      buff_queue_.open();
+      if (handoff_mode_ == HandoffMode::SPSC_RING)
+        ring_.reset(new SPSCQueue<QueuedPacket>(buff_queue_.getMaxItems()));
+      else
+        ring_.reset();
+      ring_bytes_ = 0;
+      ring_dropping_frame_ = false;
+      batch_.clear();
+      batch_.reserve(buff_queue_.getMaxItems());
+
+      {
+        std::lock_guard<std::mutex> lk(options_mutex_);
+        applied_options_ = AppliedTCPClientOptions();
+        socket_option_errors_.clear();
+      }
+
+      // resolve again on every run; reconnects within a run reuse the endpoints
+      endpoints_.clear();
+      connected_before_ = false;
+      retrying_ = false;
+      reconnect_delay_ = reconnect_initial_delay_;
+
+      resetFraming();
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::resetFraming()
+    {
+      // start framing from scratch; the first bulk read only asks for a header
+      packet_.reset();
+      stream_buffers_.clear();
+      stream_fill_ = 0;
+      stream_packet_size_ = sizeof(HEADER);
+      stream_kernel_arrival_ns_ = 0;
+      header_fill_ = 0;
+      packet_fill_ = 0;
+      resyncing_ = false;
+    }
+
+    template <class HEADER>
+    bool TCPClient<HEADER>::headerUsable(const HEADER& header)
+    {
+      if (resync_)
+        return isPlausibleHeader(header, max_packet_size_);
+
+      if (!validateHeader(header))
+        return false;
+
+      std::size_t size = getPacketSize(header);
+      return (size >= sizeof(HEADER) && size <= max_packet_size_);
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::beginResync()
+    {
+      if (resyncing_)
+        return;
 
-      // notify that we are killing
-      buff_queue_conditional_.notify_one();
+      // counted rather than printed; this runs on the io thread and losses can come in bursts
+      resyncing_ = true;
+      ++framing_statistics_.resyncs;
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::closeUring()
+    {
+      // waits for the kernel to finish with the socket and buffers
+      uring_.reset();
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::scheduleReconnect()
+    {
+      boost::system::error_code ignored;
+      closeUring();
+      read_socket_->close(ignored);
+
+      // a partial packet from the old connection can't be completed
+      resetFraming();
+
+      // attempts are counted in connection_statistics_ rather than printed; this runs on the io thread
+      reconnect_timer_.expires_from_now(reconnect_delay_);
+      reconnect_timer_.async_wait(guard([this](const boost::system::error_code& error)
+                                        {
+                                          if (!error && !kill_)
+                                            startDataConnect();
+                                        }));
+
+      reconnect_delay_ = std::min(reconnect_delay_ * 2, reconnect_max_delay_);
     }
 
     template <class HEADER>
     void TCPClient<HEADER>::startDataConnect()
     {
-      std::cout << "Attempting to connect (" << host_query_.host_name()
-                << ":" << host_query_.service_name() << ")..." << std::endl;
-      boost::asio::ip::tcp::resolver resolver(io_service_);
+      // only the first attempt of an outage is reported
+      if (!retrying_)
+      {
+        std::cout << "Attempting to connect (" << host_query_.host_name()
+                  << ":" << host_query_.service_name() << ")..." << std::endl;
+      }
 
-      try
+      // resolve once and reuse the endpoints when reconnecting
+      if (!endpoints_.empty())
       {
-        auto endpoint = resolver.resolve(host_query_);
+        connectEndpoints();
+        return;
+      }
 
-        boost::asio::async_connect(*read_socket_, endpoint,
-                                   [this](boost::system::error_code error,
-#if BOOST_VERSION < 106600
-                                          boost::asio::ip::tcp::resolver::iterator
-#else
-                                          boost::asio::ip::tcp::endpoint
-#endif
-                                         )
-                                   {
-                                     if (kill_)
-                                     {
-                                       return;
-                                     }
-                                     else if (error)
-                                     {
-                                       std::cerr << "Unable to bind to socket (" << host_query_.host_name()
-                                                 << ":" << host_query_.service_name() << ")! "
-                                                 << error.message() << std::endl;
-                                       throw SocketBindError(error.message());
-                                     }
-                                     else
-                                     {
-                                       std::cout << "Connection established" << std::endl;
-                                       startDataRead();
-                                     }
-                                   });
-      }
-      catch (boost::system::system_error& e)
-      {
-        std::cerr << "Unable to resolve host (" << host_query_.host_name()
-                  << ":" << host_query_.service_name() << ")! "
-                  << e.what() << std::endl;
-        throw SocketBindError(e.what());
+      // asynchronously, so a slow lookup doesn't hold up other clients on a shared io_service
+      resolver_.async_resolve(host_query_,
+                              guard([this](const boost::system::error_code& error,
+                                           boost::asio::ip::tcp::resolver::iterator it)
+                                    {
+                                      if (kill_)
+                                      {
+                                        return;
+                                      }
+
+                                      if (error)
+                                      {
+                                        if (!retrying_)
+                                        {
+                                          std::cerr << "Unable to resolve host (" << host_query_.host_name()
+                                                    << ":" << host_query_.service_name() << ")! "
+                                                    << error.message() << std::endl;
+                                        }
+                                        retrying_ = true;
+                                        ++connection_statistics_.connect_failures;
+                                        if (reconnect_)
+                                        {
+                                          scheduleReconnect();
+                                          return;
+                                        }
+
+                                        throw SocketBindError(error.message());
+                                      }
+
+                                      for (; it != boost::asio::ip::tcp::resolver::iterator(); ++it)
+                                      {
+                                        endpoints_.push_back(it->endpoint());
+                                      }
+
+                                      connectEndpoints();
+                                    }));
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::connectEndpoints()
+    {
+      ++connection_statistics_.connect_attempts;
+      connecting_ = true;
+      connect_timed_out_ = false;
+
+      if (connect_timeout_.count() > 0)
+      {
+        connect_timer_.expires_from_now(connect_timeout_);
+        connect_timer_.async_wait(guard([this](const boost::system::error_code& error)
+                                        {
+                                          // closing the socket makes the connect complete with an error
+                                          if (!error && connecting_ && !kill_)
+                                          {
+                                            connect_timed_out_ = true;
+                                            boost::system::error_code ignored;
+                                            read_socket_->close(ignored);
+                                          }
+                                        }));
       }
+
+      boost::asio::async_connect(*read_socket_, endpoints_.begin(), endpoints_.end(),
+                                 guard([this](boost::system::error_code error,
+                                              std::vector<boost::asio::ip::tcp::endpoint>::iterator)
+                                       {
+                                         connecting_ = false;
+                                         boost::system::error_code ignored;
+                                         connect_timer_.cancel(ignored);
+
+                                         if (kill_)
+                                         {
+                                           return;
+                                         }
+
+                                         if (connect_timed_out_)
+                                         {
+                                           ++connection_statistics_.connect_timeouts;
+                                           error = boost::asio::error::timed_out;
+                                         }
+
+                                         if (error)
+                                         {
+                                           if (!retrying_)
+                                           {
+                                             std::cerr << "Unable to bind to socket (" << host_query_.host_name()
+                                                       << ":" << host_query_.service_name() << ")! "
+                                                       << error.message() << std::endl;
+                                           }
+                                           retrying_ = true;
+                                           ++connection_statistics_.connect_failures;
+
+                                           // the host may have moved; resolve again before the next attempt
+                                           endpoints_.clear();
+                                           if (reconnect_)
+                                           {
+                                             scheduleReconnect();
+                                             return;
+                                           }
+
+                                           throw SocketBindError(error.message());
+                                         }
+
+                                         std::cout << "Connection established" << std::endl;
+                                         retrying_ = false;
+                                         ++connection_statistics_.connects;
+
+                                         {
+                                           // every connect has a new socket; report the latest
+                                           TCPClientOptions options = options_;
+                                           AppliedTCPClientOptions applied;
+                                           if (options.kernel_timestamps && receive_mode_ != ReceiveMode::BULK)
+                                           {
+                                             // per packet reads are composed by asio; we never see the messages
+                                             options.kernel_timestamps = false;
+                                             applied.errors.push_back("kernel timestamps: need bulk receive mode");
+                                           }
+
+                                           applySocketOptions(*read_socket_, options, applied);
+                                           kernel_timestamps_ = applied.kernel_timestamps;
+
+                                           if (receive_mode_ == ReceiveMode::IO_URING)
+                                           {
+                                             try
+                                             {
+                                               uring_.reset(new UringReceiver(io_service_, *read_socket_,
+                                                                              uring_buffer_count_,
+                                                                              uring_buffer_size_));
+                                             }
+                                             catch (boost::system::system_error& e)
+                                             {
+                                               applied.errors.push_back(std::string("io_uring: ") + e.what() +
+                                                                        "; using bulk receive");
+                                             }
+                                           }
+
+                                           std::lock_guard<std::mutex> lk(options_mutex_);
+                                           applied_options_.receive_buffer_size = applied.receive_buffer_size;
+                                           applied_options_.tcp_no_delay = applied.tcp_no_delay;
+                                           applied_options_.busy_poll = applied.busy_poll;
+                                           applied_options_.kernel_timestamps = applied.kernel_timestamps;
+                                           socket_option_errors_ = applied.errors;
+                                         }
+                                         if (connected_before_)
+                                           ++connection_statistics_.reconnects;
+                                         connected_before_ = true;
+                                         reconnect_delay_ = reconnect_initial_delay_;
+
+                                         startDataRead();
+                                       }));
     }
 
     template <class HEADER>
     void TCPClient<HEADER>::startDataRead()
     {
+      if (uring_)
+      {
+        startUringRead();
+        return;
+      }
+
+      if (receive_mode_ == ReceiveMode::BULK || receive_mode_ == ReceiveMode::IO_URING)
+      {
+        startStreamRead();
+        return;
+      }
+
       boost::asio::async_read(*read_socket_,
                               boost::asio::buffer(buff_.data(), sizeof(HEADER)),
-                              boost::bind(&TCPClient<HEADER>::handleReadHeader, this,
-                                          boost::asio::placeholders::error));
+                              guard(boost::bind(&TCPClient<HEADER>::handleReadHeader, this,
+                                                boost::asio::placeholders::error)));
     }
 
     template <class HEADER>
@@ -179,6 +552,13 @@ namespace quanergy
       {
         std::cerr << "Error reading header: "
                   << error.message() << std::endl;
+        if (reconnect_)
+        {
+          ++connection_statistics_.disconnects;
+          scheduleReconnect();
+          return;
+        }
+
         throw SocketReadError(error.message());
       }
       else
@@ -186,16 +566,32 @@ namespace quanergy
         HEADER* h = reinterpret_cast<HEADER*>(buff_.data());
 
         // validate
-        if (validateHeader(*h))
+        if (headerUsable(*h))
         {
+          resyncing_ = false;
           std::size_t size = getPacketSize(*h);
-          buff_.resize(size); // invalidates h pointer because of potential reallocate and move
+
+          // read the body straight into a pooled buffer so it can be handed off without a copy
+          packet_ = buffer_pool_.acquire(size);
+          std::memcpy(packet_->data(), buff_.data(), sizeof(HEADER));
 
           boost::asio::async_read(*read_socket_,
-                                  boost::asio::buffer(buff_.data() + sizeof(HEADER),
+                                  boost::asio::buffer(packet_->data() + sizeof(HEADER),
                                                       size - sizeof(HEADER)),
-                                  boost::bind(&TCPClient<HEADER>::handleReadBody, this,
-                                              boost::asio::placeholders::error));
+                                  guard(boost::bind(&TCPClient<HEADER>::handleReadBody, this,
+                                                    boost::asio::placeholders::error)));
+        }
+        else if (resync_)
+        {
+          // drop the first byte and read one more; reading no further keeps us from overshooting
+          beginResync();
+          ++framing_statistics_.skipped_bytes;
+          std::memmove(buff_.data(), buff_.data() + 1, sizeof(HEADER) - 1);
+
+          boost::asio::async_read(*read_socket_,
+                                  boost::asio::buffer(buff_.data() + sizeof(HEADER) - 1, 1),
+                                  guard(boost::bind(&TCPClient<HEADER>::handleReadHeader, this,
+                                                    boost::asio::placeholders::error)));
         }
         else
         {
@@ -215,65 +611,534 @@ namespace quanergy
       {
         std::cerr << "Error reading body: "
                   << error.message() << std::endl;
+        if (reconnect_)
+        {
+          ++connection_statistics_.disconnects;
+          scheduleReconnect();
+          return;
+        }
+
         throw SocketReadError(error.message());
       }
       else
       {
-        std::unique_lock<std::mutex> lk(buff_queue_mutex_);
+        read_arrival_ns_ = common::arrivalClockNanoseconds();
+        enqueuePacket(std::move(packet_));
+      }
 
-        // copy into shared_ptr
-        buff_queue_.push(std::make_shared<std::vector<char>>(buff_));
+      // get ready to read again
+      startDataRead();
+    }
 
-        while (buff_queue_.size() > max_queue_size_)
+    template <class HEADER>
+    void TCPClient<HEADER>::enqueuePacket(ResultType packet)
+    {
+      std::size_t bytes = packet->size();
+      bool frame_start = (!frame_start_detector_ || frame_start_detector_(*packet));
+
+      PacketBufferPool::setArrivalTime(packet, read_arrival_ns_);
+
+      QueuedPacket queued;
+      queued.packet = std::move(packet);
+      queued.queued_ns = nowNanoseconds();
+
+      if (handoff_mode_ == HandoffMode::SPSC_RING)
+      {
+        common::BackpressurePolicy policy = buff_queue_.getPolicy();
+        common::QueueStatistics& statistics = buff_queue_.statistics();
+
+        if (ring_dropping_frame_)
         {
-          buff_queue_.pop();
-          std::cout << "Warning: Client dropped packet due to full buffer" << std::endl;
+          if (!frame_start)
+          {
+            statistics.recordDrop(bytes);
+            return;
+          }
+
+          ring_dropping_frame_ = false;
         }
-        lk.unlock();
+
+        // count the bytes before the consumer can see the packet; an empty ring always takes one
+        std::size_t max_bytes = buff_queue_.getMaxBytes();
+        auto try_push = [&]
+        {
+          std::size_t ring_bytes = ring_bytes_.fetch_add(bytes);
+          if ((max_bytes == 0 || ring_bytes == 0 || ring_bytes + bytes <= max_bytes) &&
+              ring_->push(std::move(queued)))
+          {
+            return true;
+          }
+
+          ring_bytes_.fetch_sub(bytes);
+          return false;
+        };
+
+        bool pushed = try_push();
+        if (!pushed && policy == common::BackpressurePolicy::BLOCK_PRODUCER)
+        {
+          // only the consumer can make room; keep it awake and wait for it
+          auto start = std::chrono::steady_clock::now();
+          while (!kill_ && !pushed)
+          {
+            ring_waiter_.notify();
+            std::this_thread::yield();
+            pushed = try_push();
+          }
+          statistics.recordBlock(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        }
+
+        if (!pushed)
+        {
+          // only the consumer may pop, so when full the newest packet is the one dropped
+          statistics.recordDrop(bytes);
+          if (policy == common::BackpressurePolicy::DROP_WHOLE_FRAME)
+          {
+            statistics.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+            ring_dropping_frame_ = true;
+          }
+        }
+
+        // cheap unless the signal thread is parked; no yield, the waiter wakes it
+        ring_waiter_.notify();
+      }
+      else
+      {
+        // hand off the pooled buffer; it returns to the pool once downstream releases it
+        buff_queue_.push(std::move(queued), bytes, frame_start);
 
         // Free up the CPU to allow the consumer thread a chance to keep up.
         if (buff_queue_.size() > 1)
         {
           std::this_thread::yield();
         }
-        else
+      }
+
+      // on a shared io_service, ask for a drain unless one is already pending
+      if (packets_ready_ && !drain_scheduled_.exchange(true))
+      {
+        packets_ready_();
+      }
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::startStreamRead()
+    {
+      // top up the buffers posted for reading; each is sized for the packet expected to land in it
+      std::size_t posted = 0;
+      for (std::size_t i = 0; i < stream_buffers_.size(); ++i)
+        posted += stream_buffers_[i]->size() - (i == 0 ? stream_fill_ : 0);
+
+      while (stream_buffers_.empty() ||
+             (posted < bulk_read_size_ && stream_buffers_.size() < MAX_STREAM_BUFFERS))
+      {
+        stream_buffers_.push_back(buffer_pool_.acquire(stream_packet_size_));
+        posted += stream_packet_size_;
+      }
+
+      // scatter the read across the buffers; the first one continues where the last read stopped
+      stream_read_buffers_.clear();
+      for (std::size_t i = 0; i < stream_buffers_.size(); ++i)
+      {
+        std::size_t offset = (i == 0 ? stream_fill_ : 0);
+        stream_read_buffers_.push_back(boost::asio::buffer(stream_buffers_[i]->data() + offset,
+                                                           stream_buffers_[i]->size() - offset));
+      }
+
+      if (kernel_timestamps_)
+      {
+        waitStreamReady();
+        return;
+      }
+
+      read_socket_->async_read_some(stream_read_buffers_,
+                                    guard(boost::bind(&TCPClient<HEADER>::handleStreamRead, this,
+                                                      boost::asio::placeholders::error,
+                                                      boost::asio::placeholders::bytes_transferred)));
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::waitStreamReady()
+    {
+      // asio reads don't return the control messages carrying the stamp, so read once readable
+#if (BOOST_VERSION >= 106600)
+      read_socket_->async_wait(boost::asio::ip::tcp::socket::wait_read,
+                               guard(boost::bind(&TCPClient<HEADER>::handleStreamReady, this,
+                                                 boost::asio::placeholders::error)));
+#else
+      read_socket_->async_read_some(boost::asio::null_buffers(),
+                                    guard(boost::bind(&TCPClient<HEADER>::handleStreamReady, this,
+                                                      boost::asio::placeholders::error)));
+#endif
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::handleStreamReady(const boost::system::error_code& error)
+    {
+      if (kill_)
+      {
+        return;
+      }
+      else if (error)
+      {
+        handleStreamRead(error, 0);
+        return;
+      }
+
+      boost::system::error_code read_error;
+      std::uint64_t arrival_ns = 0;
+      std::size_t bytes_transferred = receiveWithTimestamp(*read_socket_, stream_read_buffers_,
+                                                           arrival_ns, read_error);
+
+      if (read_error == boost::asio::error::would_block ||
+          read_error == boost::asio::error::try_again ||
+          read_error == boost::asio::error::interrupted)
+      {
+        waitStreamReady();
+        return;
+      }
+
+      stream_kernel_arrival_ns_ = arrival_ns;
+      handleStreamRead(read_error, bytes_transferred);
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::handleStreamRead(const boost::system::error_code& error,
+                                             std::size_t bytes_transferred)
+    {
+      if (kill_)
+      {
+        return;
+      }
+      else if (error)
+      {
+        std::cerr << "Error reading stream: "
+                  << error.message() << std::endl;
+        if (reconnect_)
         {
-          // Consumer thread only waits to be notified when the queue is (was) empty
-          buff_queue_conditional_.notify_one();
+          ++connection_statistics_.disconnects;
+          scheduleReconnect();
+          return;
         }
+
+        throw SocketReadError(error.message());
       }
 
-      // get ready to read again
-      startDataRead();
+      // packets completed by this read share its arrival time
+      read_arrival_ns_ = (stream_kernel_arrival_ns_ != 0 ? stream_kernel_arrival_ns_
+                                                         : common::arrivalClockNanoseconds());
+      stream_kernel_arrival_ns_ = 0;
+
+      // bytes received so far starting at the beginning of the first buffer
+      std::size_t available = stream_fill_ + bytes_transferred;
+      std::size_t index = 0;
+
+      for (; index < stream_buffers_.size(); ++index)
+      {
+        ResultType& buffer = stream_buffers_[index];
+        std::size_t filled = std::min(available, buffer->size());
+
+        // wait for the rest of the header
+        if (filled < sizeof(HEADER))
+          break;
+
+        const HEADER* h = reinterpret_cast<const HEADER*>(buffer->data());
+        if (!headerUsable(*h))
+        {
+          if (!resync_)
+          {
+            throw InvalidHeaderError();
+          }
+
+          // scan the received bytes for the next header
+          reframeStream(index, available);
+          startStreamRead();
+          return;
+        }
+
+        resyncing_ = false;
+        std::size_t size = getPacketSize(*h);
+        if (size != buffer->size())
+        {
+          // packet size changed so later bytes landed in the wrong buffers; copy and frame them
+          reframeStream(index, available);
+          startStreamRead();
+          return;
+        }
+
+        // wait for the rest of the packet
+        if (filled < size)
+          break;
+
+        enqueuePacket(std::move(buffer));
+        available -= size;
+      }
+
+      // the first remaining buffer holds the start of the next packet
+      stream_buffers_.erase(stream_buffers_.begin(), stream_buffers_.begin() + index);
+      stream_fill_ = available;
+
+      startStreamRead();
     }
 
     template <class HEADER>
-    void TCPClient<HEADER>::signalPackets()
+    void TCPClient<HEADER>::startUringRead()
+    {
+      uring_->asyncWait(guard(boost::bind(&TCPClient<HEADER>::handleUringRead, this,
+                                          boost::asio::placeholders::error)));
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::handleUringRead(const boost::system::error_code& error)
     {
-      // define condition to continue: something in buffer or kill flag set
-      auto continue_condition = [this]{return (!buff_queue_.empty() || kill_);};
+      // the wait is only aborted when the receiver is closed; its replacement has its own wait
+      if (kill_ || error == boost::asio::error::operation_aborted)
+      {
+        return;
+      }
 
-      for (;;)
+      boost::system::error_code read_error = error;
+      if (!read_error)
       {
-        std::unique_lock<std::mutex> lk(buff_queue_mutex_);
-        // if queue is empty, wait for something to be in the queue
-        if (!continue_condition())
-          buff_queue_conditional_.wait(lk, continue_condition);
+        // packets completed by this wake-up share its arrival time
+        read_arrival_ns_ = common::arrivalClockNanoseconds();
+        uring_->reap([this](const char* data, std::size_t size) { frameBytes(data, size); }, read_error);
+      }
 
-        if (kill_)
+      if (read_error)
+      {
+        std::cerr << "Error reading stream: "
+                  << read_error.message() << std::endl;
+        if (reconnect_)
+        {
+          ++connection_statistics_.disconnects;
+          scheduleReconnect();
           return;
+        }
+
+        throw SocketReadError(read_error.message());
+      }
+
+      startUringRead();
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::frameBytes(const char* data, std::size_t size)
+    {
+      while (size > 0)
+      {
+        if (!packet_)
+        {
+          // gather the header first; it tells us what size of buffer to take from the pool
+          std::size_t count = std::min(size, sizeof(HEADER) - header_fill_);
+          std::memcpy(buff_.data() + header_fill_, data, count);
+          header_fill_ += count;
+          data += count;
+          size -= count;
+
+          if (header_fill_ < sizeof(HEADER))
+            return;
+
+          const HEADER* h = reinterpret_cast<const HEADER*>(buff_.data());
+          if (!headerUsable(*h))
+          {
+            if (!resync_)
+            {
+              throw InvalidHeaderError();
+            }
+
+            // drop the first byte and try again with the next one
+            beginResync();
+            ++framing_statistics_.skipped_bytes;
+            std::memmove(buff_.data(), buff_.data() + 1, sizeof(HEADER) - 1);
+            --header_fill_;
+            continue;
+          }
+
+          resyncing_ = false;
+          packet_ = buffer_pool_.acquire(getPacketSize(*h));
+          std::memcpy(packet_->data(), buff_.data(), sizeof(HEADER));
+          packet_fill_ = sizeof(HEADER);
+          header_fill_ = 0;
+        }
+
+        std::size_t count = std::min(size, packet_->size() - packet_fill_);
+        std::memcpy(packet_->data() + packet_fill_, data, count);
+        packet_fill_ += count;
+        data += count;
+        size -= count;
+
+        if (packet_fill_ == packet_->size())
+        {
+          enqueuePacket(std::move(packet_));
+          packet_.reset();
+        }
+      }
+    }
 
-        decltype(buff_queue_) local_q;
-        std::swap(buff_queue_, local_q);
-        lk.unlock();
+    template <class HEADER>
+    void TCPClient<HEADER>::reframeStream(std::size_t index, std::size_t available)
+    {
+      // gather the received bytes from index on
+      stream_carry_.clear();
+      for (std::size_t i = index; i < stream_buffers_.size() && available > 0; ++i)
+      {
+        std::size_t filled = std::min(available, stream_buffers_[i]->size());
+        stream_carry_.insert(stream_carry_.end(), stream_buffers_[i]->data(), stream_buffers_[i]->data() + filled);
+        available -= filled;
+      }
+      stream_buffers_.clear();
+
+      std::size_t offset = 0;
+      std::size_t size = std::max(stream_packet_size_, sizeof(HEADER));
+      while (stream_carry_.size() - offset >= sizeof(HEADER))
+      {
+        const HEADER* h = reinterpret_cast<const HEADER*>(stream_carry_.data() + offset);
+        if (!headerUsable(*h))
+        {
+          if (!resync_)
+          {
+            throw InvalidHeaderError();
+          }
+
+          beginResync();
+          ++framing_statistics_.skipped_bytes;
+          ++offset;
+          continue;
+        }
+
+        resyncing_ = false;
+        size = getPacketSize(*h);
+
+        // predict the following packets will be the same size
+        stream_packet_size_ = size;
 
-        while (!local_q.empty())
+        if (stream_carry_.size() - offset < size)
+          break;
+
+        ResultType packet = buffer_pool_.acquire(size);
+        std::memcpy(packet->data(), stream_carry_.data() + offset, size);
+        enqueuePacket(std::move(packet));
+        offset += size;
+      }
+
+      // keep the start of the next packet in the first buffer
+      stream_fill_ = stream_carry_.size() - offset;
+      if (stream_fill_ > 0)
+      {
+        stream_buffers_.push_back(buffer_pool_.acquire(size));
+        std::memcpy(stream_buffers_.front()->data(), stream_carry_.data() + offset, stream_fill_);
+      }
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::signalPackets()
+    {
+      if (ring_)
+      {
+        QueuedPacket queued;
+        for (;;)
+        {
+          // spin briefly, then park until the socket thread has something for us
+          ring_waiter_.wait([this]{return (!ring_->empty() || kill_);});
+
+          if (kill_)
+            return;
+
+          // stop at a queue's worth so the buffers in flight stay within the pool
+          while (batch_.size() < buff_queue_.getMaxItems() && ring_->pop(queued))
+          {
+            ring_bytes_.fetch_sub(queued.packet->size());
+            batchPacket(queued);
+          }
+
+          signalBatch();
+        }
+      }
+
+      // take everything queued at once; fails once stopped
+      std::deque<typename common::BoundedQueue<QueuedPacket>::Entry> local_q;
+      while (buff_queue_.popAll(local_q))
+      {
+        for (auto& entry : local_q)
+        {
+          batchPacket(entry.item);
+        }
+
+        signalBatch();
+      }
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::drainPackets()
+    {
+      // clear first so anything queued from here on asks for another drain
+      drain_scheduled_ = false;
+
+      try
+      {
+        if (ring_)
+        {
+          QueuedPacket queued;
+          while (!kill_ && batch_.size() < buff_queue_.getMaxItems() && ring_->pop(queued))
+          {
+            ring_bytes_.fetch_sub(queued.packet->size());
+            batchPacket(queued);
+          }
+
+          signalBatch();
+
+          // whatever is left would otherwise wait for the next packet, forever at the end of a stream
+          if (packets_ready_ && !kill_ && !ring_->empty() && !drain_scheduled_.exchange(true))
+          {
+            packets_ready_();
+          }
+        }
+        else if (buff_queue_.tryPopAll(drain_queue_))
+        {
+          for (auto& entry : drain_queue_)
+          {
+            batchPacket(entry.item);
+          }
+          drain_queue_.clear();
+
+          signalBatch();
+        }
+      }
+      catch (...)
+      {
+        batch_.clear();
+        fail(std::current_exception());
+      }
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::batchPacket(QueuedPacket& queued)
+    {
+      handoff_latency_.record(nowNanoseconds() - queued.queued_ns);
+      batch_.push_back(std::move(queued.packet));
+    }
+
+    template <class HEADER>
+    void TCPClient<HEADER>::signalBatch()
+    {
+      if (batch_.empty())
+        return;
+
+      // each signal call locks and walks its slots; check once per batch rather than per packet
+      if (!signal_.empty())
+      {
+        for (const auto& packet : batch_)
         {
-          auto packet = local_q.front();
-          local_q.pop();
           signal_(packet);
         }
       }
+
+      if (!batch_signal_.empty())
+        batch_signal_(batch_);
+
+      // release the buffers back to the pool right away
+      batch_.clear();
     }
 
   } // namespace client
@@ -0,0 +1,128 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file latency_histogram.h
+ *
+ *  \brief Provide a lock-free log-linear latency histogram
+ */
+
+#ifndef QUANERGY_CLIENT_LATENCY_HISTOGRAM_H
+#define QUANERGY_CLIENT_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /** \brief LatencyHistogram records durations in nanoseconds
+     *  \details Values below 8 ns get their own bucket; above that each power of two
+     *           is split into 4 buckets so percentiles are accurate to within 25%.
+     *           Recording is wait-free and may happen concurrently with reading.
+     */
+    class LatencyHistogram
+    {
+    public:
+      static const std::size_t NUM_BUCKETS = 256;
+
+      LatencyHistogram()
+      {
+        reset();
+      }
+
+      /// add a sample
+      void record(std::uint64_t nanoseconds)
+      {
+        buckets_[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+      }
+
+      /// clear all samples
+      void reset()
+      {
+        for (auto& bucket : buckets_)
+          bucket.store(0, std::memory_order_relaxed);
+      }
+
+      /// number of samples recorded
+      std::uint64_t count() const
+      {
+        std::uint64_t total = 0;
+        for (const auto& bucket : buckets_)
+          total += bucket.load(std::memory_order_relaxed);
+        return total;
+      }
+
+      /** \brief get the value below which the fraction p of the samples falls
+       *  \param p is in [0, 1], e.g. 0.99 for p99
+       *  \return upper bound of the bucket holding the percentile, in nanoseconds; 0 if empty
+       */
+      std::uint64_t percentile(double p) const
+      {
+        std::array<std::uint64_t, NUM_BUCKETS> counts;
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+          counts[i] = buckets_[i].load(std::memory_order_relaxed);
+          total += counts[i];
+        }
+
+        if (total == 0)
+          return 0;
+
+        std::uint64_t target = static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(total)));
+        if (target == 0)
+          target = 1;
+
+        std::uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+          cumulative += counts[i];
+          if (cumulative >= target)
+            return bucketUpperBound(i);
+        }
+
+        return bucketUpperBound(NUM_BUCKETS - 1);
+      }
+
+    private:
+      static std::size_t bucketIndex(std::uint64_t value)
+      {
+        if (value < 8)
+          return static_cast<std::size_t>(value);
+
+        unsigned int msb = 3;
+        while (msb < 63 && (value >> (msb + 1)) != 0)
+          ++msb;
+
+        return 8 + (msb - 3) * 4 + static_cast<std::size_t>((value >> (msb - 2)) & 3);
+      }
+
+      static std::uint64_t bucketUpperBound(std::size_t index)
+      {
+        if (index < 8)
+          return index;
+
+        const unsigned int msb = static_cast<unsigned int>((index - 8) / 4 + 3);
+        const std::uint64_t sub = (index - 8) % 4;
+
+        if (msb == 63 && sub == 3)
+          return ~std::uint64_t(0);
+
+        return ((4 + sub + 1) << (msb - 2)) - 1;
+      }
+
+      std::array<std::atomic<std::uint64_t>, NUM_BUCKETS> buckets_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,185 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file packet_buffer_pool.h
+ *
+ *  \brief Provide a recycling pool of raw packet buffers
+ */
+
+#ifndef QUANERGY_CLIENT_PACKET_BUFFER_POOL_H
+#define QUANERGY_CLIENT_PACKET_BUFFER_POOL_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /// default capacity reserved for each pooled buffer; fits the largest M-series packet
+    const std::size_t DEFAULT_PACKET_BUFFER_RESERVE = 8192;
+
+    /** \brief PacketBufferPool hands out packet buffers that return to the pool when released
+     *  \details Buffers are std::shared_ptr<std::vector<char>> with a deleter that puts
+     *           the vector back on the free list instead of freeing it. When no free buffer
+     *           is available, a transient buffer is allocated and the exhaustion counter
+     *           is incremented. The pool never holds more than its capacity; buffers
+     *           released beyond that are freed. Buffers may safely outlive the pool.
+     */
+    class PacketBufferPool
+    {
+    public:
+      typedef std::shared_ptr<std::vector<char>> BufferType;
+
+      /** \brief Constructor
+       *  \param capacity is the number of buffers kept by the pool
+       *  \param buffer_reserve is the number of bytes reserved in each buffer up front
+       */
+      explicit PacketBufferPool(std::size_t capacity,
+                                std::size_t buffer_reserve = DEFAULT_PACKET_BUFFER_RESERVE)
+        : state_(std::make_shared<State>())
+      {
+        state_->capacity = capacity;
+        state_->buffer_reserve = buffer_reserve;
+
+        state_->free_list.reserve(capacity);
+        for (std::size_t i = 0; i < capacity; ++i)
+        {
+          std::unique_ptr<std::vector<char>> buffer(new std::vector<char>());
+          buffer->reserve(buffer_reserve);
+          state_->free_list.push_back(buffer.release());
+        }
+      }
+
+      // noncopyable
+      PacketBufferPool(const PacketBufferPool&) = delete;
+      PacketBufferPool& operator=(const PacketBufferPool&) = delete;
+
+      /** \brief get a buffer of the requested size
+       *  \details contents are unspecified; the caller is expected to overwrite all of it
+       */
+      BufferType acquire(std::size_t size)
+      {
+        std::vector<char>* buffer = nullptr;
+
+        {
+          std::lock_guard<std::mutex> lk(state_->mutex);
+          if (!state_->free_list.empty())
+          {
+            buffer = state_->free_list.back();
+            state_->free_list.pop_back();
+          }
+        }
+
+        if (!buffer)
+        {
+          ++state_->exhausted;
+          buffer = new std::vector<char>();
+          buffer->reserve(std::max(size, state_->buffer_reserve));
+        }
+
+        // resize is a no-op once the buffer has held a packet of the same size
+        buffer->resize(size);
+
+        std::size_t in_use = ++state_->in_use;
+        std::size_t high_water = state_->high_water_mark;
+        while (in_use > high_water &&
+               !state_->high_water_mark.compare_exchange_weak(high_water, in_use))
+        {
+        }
+
+        return BufferType(buffer, Releaser(state_));
+      }
+
+      /// number of buffers kept by the pool
+      std::size_t capacity() const { return state_->capacity; }
+
+      /// number of buffers currently handed out (including transient ones)
+      std::size_t inUse() const { return state_->in_use; }
+
+      /// largest number of buffers handed out at the same time
+      std::size_t highWaterMark() const { return state_->high_water_mark; }
+
+      /// number of times a buffer was requested while the pool was empty
+      std::size_t exhaustedCount() const { return state_->exhausted; }
+
+      /** \brief arrival time of the packet in a buffer, on common::arrivalClockNanoseconds
+       *  \return nanoseconds since the epoch; 0 if not set or the buffer is not from a pool
+       */
+      static std::uint64_t arrivalTime(const BufferType& buffer)
+      {
+        const Releaser* releaser = std::get_deleter<Releaser>(buffer);
+        return (releaser ? releaser->arrival_ns : 0);
+      }
+
+      /// stamp a buffer from a pool with the arrival time of its packet
+      static void setArrivalTime(const BufferType& buffer, std::uint64_t arrival_ns)
+      {
+        Releaser* releaser = std::get_deleter<Releaser>(buffer);
+        if (releaser)
+          releaser->arrival_ns = arrival_ns;
+      }
+
+    private:
+      /// state shared with outstanding buffers so they can be released after the pool is gone
+      struct State
+      {
+        ~State()
+        {
+          for (auto buffer : free_list)
+            delete buffer;
+        }
+
+        std::mutex                       mutex;
+        std::vector<std::vector<char>*>  free_list;
+        std::size_t                      capacity = 0;
+        std::size_t                      buffer_reserve = 0;
+        std::atomic<std::size_t>         in_use {0};
+        std::atomic<std::size_t>         high_water_mark {0};
+        std::atomic<std::size_t>         exhausted {0};
+      };
+
+      /// deleter returning the buffer to the free list; a new one comes with every acquire
+      struct Releaser
+      {
+        explicit Releaser(const std::shared_ptr<State>& state)
+          : state(state)
+        {
+        }
+
+        void operator()(std::vector<char>* buffer) const
+        {
+          --state->in_use;
+
+          {
+            std::lock_guard<std::mutex> lk(state->mutex);
+            if (state->free_list.size() < state->capacity)
+            {
+              state->free_list.push_back(buffer);
+              buffer = nullptr;
+            }
+          }
+
+          delete buffer;
+        }
+
+        std::shared_ptr<State> state;
+        std::uint64_t          arrival_ns = 0;
+      };
+
+      std::shared_ptr<State> state_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
@@ -112,6 +112,43 @@ namespace quanergy
       return deserialize(object.size);
     }
 
+    /** \brief whether the packet type is one the parsers know */
+    inline bool isKnownPacketType(std::uint8_t packet_type)
+    {
+      return (packet_type == 0x00 || packet_type == 0x01 ||
+              packet_type == 0x04 || packet_type == 0x06);
+    }
+
+    /** \brief check used to find the next header after losing sync; unlike validateHeader it is silent
+     *  \return true if the signature matches, the size is within [sizeof(PacketHeader), max_packet_size]
+     *          and the packet type is known
+     */
+    inline bool isPlausibleHeader(const PacketHeader& object, std::size_t max_packet_size)
+    {
+      std::size_t size = deserialize(object.size);
+
+      return (deserialize(object.signature) == SIGNATURE &&
+              size >= sizeof(PacketHeader) && size <= max_packet_size &&
+              isKnownPacketType(deserialize(object.packet_type)));
+    }
+
+    /** \brief packet type and version in a single value, so parsers can be picked with one compare */
+    typedef std::uint32_t PacketKey;
+
+    /** \brief make the key of a packet type and version */
+    constexpr PacketKey makePacketKey(std::uint8_t packet_type, std::uint8_t version_major,
+                                      std::uint8_t version_minor, std::uint8_t version_patch)
+    {
+      return (static_cast<PacketKey>(packet_type) << 24) | (static_cast<PacketKey>(version_major) << 16)
+             | (static_cast<PacketKey>(version_minor) << 8) | static_cast<PacketKey>(version_patch);
+    }
+
+    /** \brief key of the packet with this header; the fields are single bytes so need no swapping */
+    inline PacketKey makePacketKey(const PacketHeader& object)
+    {
+      return makePacketKey(object.packet_type, object.version_major, object.version_minor, object.version_patch);
+    }
+
   } // namespace client
 
 } // namespace quanergy
@@ -0,0 +1,96 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file sensor_fleet.h
+ *
+ *  \brief Provide a front end running many sensor clients on shared threads
+ */
+
+#ifndef QUANERGY_CLIENT_SENSOR_FLEET_H
+#define QUANERGY_CLIENT_SENSOR_FLEET_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <quanergy/client/sensor_client.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /** \brief SensorFleet runs any number of SensorClient connections on a fixed set of threads
+     *  \details All sockets are serviced by a pool of io threads and packets are signaled by a
+     *           pool of dispatch threads. Each sensor is pinned to one dispatch thread, so its
+     *           packets are signaled in order and never concurrently. A sensor that fails
+     *           stops on its own; the others keep running.
+     */
+    class SensorFleet
+    {
+    public:
+      /** \brief Constructor
+       *  \param io_threads is the number of threads servicing sockets
+       *  \param dispatch_threads is the number of threads signaling packets
+       */
+      SensorFleet(std::size_t io_threads = 1, std::size_t dispatch_threads = 1);
+
+      // noncopyable
+      SensorFleet(const SensorFleet&) = delete;
+      SensorFleet& operator=(const SensorFleet&) = delete;
+
+      /** \brief stops the fleet; run must have returned before the fleet is destroyed */
+      virtual ~SensorFleet();
+
+      /** \brief add a sensor; configure it and connect its signal before calling run
+       *  \details The io threads are shared, so the sensor can't use BLOCK_PRODUCER backpressure.
+       *  \return the client, valid for the life of the fleet
+       */
+      SensorClient& addSensor(std::string const & host,
+                              std::string const & port,
+                              std::size_t max_queue_size = 100);
+
+      /** \brief number of sensors added */
+      std::size_t size() const { return sensors_.size(); }
+
+      /** \brief access a sensor by the order it was added */
+      SensorClient& sensor(std::size_t index) { return *sensors_.at(index); }
+
+      /** \brief Starts all sensors and blocks until stop is called or every sensor has failed
+       *  \details If every sensor failed, the first error is rethrown. Errors of individual
+       *           sensors are available from SensorClient::error.
+       */
+      void run();
+
+      /** \brief Makes run stop all sensors and return */
+      void stop();
+
+    private:
+      /// called on a dispatch thread after a sensor asked for a drain
+      void drain(std::size_t index);
+
+      boost::asio::io_service                                 io_service_;
+      std::size_t                                             io_thread_count_;
+      std::vector<std::unique_ptr<boost::asio::io_service>>   dispatchers_;
+
+      std::vector<std::unique_ptr<SensorClient>>              sensors_;
+      /// sensors whose failure was counted; each only touched by its own dispatcher
+      std::vector<char>                                       failed_;
+
+      std::mutex                                              state_mutex_;
+      std::condition_variable                                 state_condition_;
+      bool                                                    running_ = false;
+      bool                                                    stopping_ = false;
+      std::size_t                                             failed_count_ = 0;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
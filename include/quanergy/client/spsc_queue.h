@@ -0,0 +1,187 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file spsc_queue.h
+ *
+ *  \brief Provide a bounded single-producer/single-consumer ring buffer
+ *         and a spin-then-park wake-up strategy to go with it
+ */
+
+#ifndef QUANERGY_CLIENT_SPSC_QUEUE_H
+#define QUANERGY_CLIENT_SPSC_QUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  #include <immintrin.h>
+  #define QUANERGY_CPU_RELAX() _mm_pause()
+#else
+  #define QUANERGY_CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace quanergy
+{
+  namespace client
+  {
+    /// size of a cache line; used to keep producer and consumer indices apart
+    const std::size_t CACHE_LINE_SIZE = 64;
+
+    /** \brief SPSCQueue is a lock-free bounded ring buffer
+     *  \details push may only be called from one thread and pop from one (other) thread.
+     *           Storage is rounded up to a power of two for cheap indexing but the queue
+     *           never holds more than the capacity asked for.
+     */
+    template <class T>
+    class SPSCQueue
+    {
+    public:
+      explicit SPSCQueue(std::size_t capacity)
+        : capacity_(std::max<std::size_t>(capacity, 1))
+      {
+        std::size_t size = 1;
+        while (size < capacity_)
+          size <<= 1;
+
+        slots_.resize(size);
+        mask_ = size - 1;
+      }
+
+      // noncopyable
+      SPSCQueue(const SPSCQueue&) = delete;
+      SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+      /** \brief add an item; producer only
+       *  \return false if the queue is full, in which case item is untouched
+       */
+      bool push(T&& item)
+      {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ >= capacity_)
+        {
+          head_cache_ = head_.load(std::memory_order_acquire);
+          if (tail - head_cache_ >= capacity_)
+            return false;
+        }
+
+        slots_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+      }
+
+      /** \brief remove the oldest item; consumer only
+       *  \return false if the queue is empty
+       */
+      bool pop(T& item)
+      {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_)
+        {
+          tail_cache_ = tail_.load(std::memory_order_acquire);
+          if (head == tail_cache_)
+            return false;
+        }
+
+        item = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+      }
+
+      /// whether the queue is empty; exact from the consumer, approximate elsewhere
+      bool empty() const
+      {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+      }
+
+      /// approximate number of items in the queue
+      std::size_t size() const
+      {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+      }
+
+      std::size_t capacity() const { return capacity_; }
+
+    private:
+      std::size_t    capacity_;
+      std::vector<T> slots_;
+      std::size_t    mask_ = 0;
+
+      // consumer owned
+      char                      pad0_[CACHE_LINE_SIZE];
+      std::atomic<std::size_t>  head_ {0};
+      std::size_t               tail_cache_ = 0;
+
+      // producer owned
+      char                      pad1_[CACHE_LINE_SIZE];
+      std::atomic<std::size_t>  tail_ {0};
+      std::size_t               head_cache_ = 0;
+      char                      pad2_[CACHE_LINE_SIZE];
+    };
+
+    /** \brief SpinParkWaiter lets a consumer spin briefly before blocking on a condition variable
+     *  \details The producer only pays for a lock and notify when the consumer is actually parked.
+     *           Spinning is skipped on single core machines where it would only starve the producer.
+     */
+    class SpinParkWaiter
+    {
+    public:
+      explicit SpinParkWaiter(unsigned int spin_count = 2000)
+        : spin_count_(std::thread::hardware_concurrency() > 1 ? spin_count : 0)
+      {
+      }
+
+      /// wait until ready() returns true
+      template <class Predicate>
+      void wait(Predicate ready)
+      {
+        for (unsigned int i = 0; i < spin_count_; ++i)
+        {
+          if (ready())
+            return;
+
+          QUANERGY_CPU_RELAX();
+        }
+
+        std::unique_lock<std::mutex> lk(mutex_);
+        parked_.store(true);
+        // pairs with the fence in notify so either we see the new item or the producer sees us parked
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond_.wait(lk, ready);
+        parked_.store(false);
+      }
+
+      /// wake the consumer if it is parked; cheap when it is not
+      void notify()
+      {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load())
+          notifyAll();
+      }
+
+      /// unconditionally wake the consumer; used for shutdown
+      void notifyAll()
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        cond_.notify_all();
+      }
+
+    private:
+      unsigned int              spin_count_;
+      std::atomic<bool>         parked_ {false};
+      std::mutex                mutex_;
+      std::condition_variable   cond_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
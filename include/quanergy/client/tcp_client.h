@@ -13,30 +13,104 @@
 #ifndef QUANERGY_CLIENT_TCP_CLIENT_H
 #define QUANERGY_CLIENT_TCP_CLIENT_H
 
-#include <queue>
-#include <mutex>
-#include <condition_variable>
 #include <thread>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
 
 // networking
 #include <boost/asio.hpp>
+#include <boost/version.hpp>
 // signals for output
 #include <boost/signals2.hpp>
 
 // exception library
 #include <quanergy/client/exceptions.h>
 
+// recycled packet buffers
+#include <quanergy/client/packet_buffer_pool.h>
+// lock-free handoff to the signal thread
+#include <quanergy/client/spsc_queue.h>
+// handoff latency statistics
+#include <quanergy/client/latency_histogram.h>
+// queue with selectable backpressure
+#include <quanergy/common/bounded_queue.h>
+// socket and thread tuning
+#include <quanergy/client/tcp_client_options.h>
+// packet arrival clock
+#include <quanergy/common/arrival_time.h>
+// io_uring receive mode
+#include <quanergy/client/uring_receiver.h>
+
 namespace quanergy
 {
   namespace client
   {
+    /** \brief how packets are passed from the socket thread to the signal thread */
+    enum struct HandoffMode
+    {
+      LOCKED_QUEUE, ///< mutex protected queue supporting every backpressure policy
+      SPSC_RING     ///< lock-free ring with spin-then-park wake-up; queued packets cannot be dropped
+                    ///< so DROP_OLDEST drops the newest and DROP_WHOLE_FRAME only the rest of the frame
+    };
+
+    /** \brief how packets are read from the socket */
+    enum struct ReceiveMode
+    {
+      PER_PACKET, ///< one read for the header and one for the body of each packet
+      BULK,       ///< large scatter reads into pooled buffers with packets framed in place
+      IO_URING    ///< multishot io_uring receive into registered buffers, packets copied out;
+                  ///< Linux only, falls back to BULK where io_uring is not available
+    };
+
+    /// default number of bytes requested per read in bulk receive mode
+    const std::size_t DEFAULT_BULK_READ_SIZE = 64 * 1024;
+
+    /// default upper limit on the size of a packet; larger sizes are treated as corrupt headers
+    const std::size_t DEFAULT_MAX_PACKET_SIZE = 8 * 1024 * 1024;
+
+    /** \brief FramingStatistics counts losses of packet framing over the life of a client */
+    struct FramingStatistics
+    {
+      /// number of times an invalid header started a scan for the next one
+      std::atomic<std::uint64_t> resyncs {0};
+      /// bytes discarded while scanning
+      std::atomic<std::uint64_t> skipped_bytes {0};
+    };
+
+    /// default delay before the first reconnect attempt
+    const std::chrono::milliseconds DEFAULT_RECONNECT_INITIAL_DELAY(100);
+    /// default upper limit of the reconnect delay
+    const std::chrono::milliseconds DEFAULT_RECONNECT_MAX_DELAY(5000);
+
+    /** \brief ConnectionStatistics counts connection events over the life of a client */
+    struct ConnectionStatistics
+    {
+      /// connection attempts, after resolving succeeded
+      std::atomic<std::uint64_t> connect_attempts {0};
+      /// connections established
+      std::atomic<std::uint64_t> connects {0};
+      /// connections established after the link was lost within the same run
+      std::atomic<std::uint64_t> reconnects {0};
+      /// failed attempts to resolve or connect, including timeouts
+      std::atomic<std::uint64_t> connect_failures {0};
+      /// attempts abandoned after the connect timeout
+      std::atomic<std::uint64_t> connect_timeouts {0};
+      /// read errors that dropped an established link while reconnecting was enabled
+      std::atomic<std::uint64_t> disconnects {0};
+    };
+
     /** \brief TCPClient is a generic TCP data receiver that outputs packets based on header
      *  \tparam HEADER is the packet header type
-     *  \attention The following two functions must be provided for HEADER type
+     *  \attention The following three functions must be provided for HEADER type
      *             bool validateHeader(const HEADER&); // returns true if valid
      *             std::size_t getPacketSize(const HEADER&);  // returns the size of the full packet including header
+     *             bool isPlausibleHeader(const HEADER&, std::size_t max_packet_size); // silent check used to resync
+     *  \note Every packet is stamped with its arrival time; see PacketBufferPool::arrivalTime.
+     *        That is the kernel receive time when TCPClientOptions::kernel_timestamps is applied
+     *        and otherwise the time the read completing the packet returned.
      */
     template <class HEADER>
     class TCPClient
@@ -48,13 +122,30 @@ namespace quanergy
       typedef HEADER HeaderType;
       /// The packet is output on a signal
       typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      /// packets signaled together, in the order received
+      typedef std::vector<ResultType> BatchType;
+      /// All packets taken off the queue at once are also output on a batch signal
+      typedef boost::signals2::signal<void (const BatchType&)> BatchSignal;
+      /// returns true if the packet is the first of a frame
+      typedef std::function<bool (const std::vector<char>&)> FrameStartDetector;
 
       /** \brief Constructor taking a host, port, and queue size.
+       *  \details The packet buffer pool holds enough buffers for a full queue on each
+       *           side of the handoff to the signal thread plus those posted for a bulk read.
        */
       TCPClient(std::string const & host,
              std::string const & port,
              std::size_t max_queue_size = 100);
 
+      /** \brief Constructor for a client sharing an io_service with others; see start.
+       *  \details The io_service must be run until the client has been stopped and its
+       *           socket closed, and it must outlive the client.
+       */
+      TCPClient(boost::asio::io_service& io_service,
+             std::string const & host,
+             std::string const & port,
+             std::size_t max_queue_size = 100);
+
       // no default constructor
       TCPClient() = delete;
 
@@ -67,12 +158,150 @@ namespace quanergy
       /** \brief Connect a slot to the signal which will be emitted when a new RESULT is available */
       boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
 
-      /** \brief Starts processing the Quanergy packets */
+      /** \brief Connect a slot to the signal emitted once for all packets taken off the queue together
+       *  \details The batch is emitted after the per packet signal has been emitted for each of its
+       *           packets; per packet slots are skipped entirely when none are connected. Buffers
+       *           return to the pool after the batch signal, so a slot keeping packets must copy the
+       *           pointers.
+       */
+      boost::signals2::connection connectBatch(const typename BatchSignal::slot_type& subscriber);
+
+      /** \brief Starts processing the Quanergy packets; only for a client owning its io_service */
       virtual void run();
 
+      /** \brief Start connecting and reading on a shared io_service without blocking
+       *  \param packets_ready is called from an io thread when packets are queued and no call to
+       *         drainPackets is pending anymore, and once when the client stops
+       *  \details No signal thread is created; packets are signaled by drainPackets on whatever
+       *           thread the caller picks. Errors stop only this client; see error.
+       */
+      void start(std::function<void ()> packets_ready);
+
+      /** \brief Signal the packets queued so far on the calling thread; call from one thread at a time */
+      void drainPackets();
+
+      /** \brief The error that stopped a started client, if any */
+      std::exception_ptr error() const;
+
       /** \brief Stops processing the Quanergy packets */
       virtual void stop();
 
+      /** \brief Access the packet buffer pool for its counters */
+      const PacketBufferPool& bufferPool() const { return buffer_pool_; }
+
+      /** \brief Select how packets are handed to the signal thread; takes effect on the next run */
+      void setHandoffMode(HandoffMode mode) { handoff_mode_ = mode; }
+      HandoffMode getHandoffMode() const { return handoff_mode_; }
+
+      /** \brief Select how packets are read from the socket; takes effect on the next run
+       *  \details In bulk mode each read is scattered across pooled buffers sized for the
+       *           packets expected next, so packets are framed where they land and the number
+       *           of reads scales with bytes rather than packets. When the packet size changes,
+       *           the bytes already read are copied into correctly sized buffers once.
+       */
+      void setReceiveMode(ReceiveMode mode) { receive_mode_ = mode; }
+      ReceiveMode getReceiveMode() const { return receive_mode_; }
+
+      /** \brief Set the number of bytes requested per read in bulk receive mode */
+      void setBulkReadSize(std::size_t bytes) { bulk_read_size_ = bytes; }
+
+      /** \brief Set the number and size of the buffers registered in io_uring receive mode; takes
+       *         effect on the next connect
+       */
+      void setUringBuffers(std::size_t count, std::size_t size)
+      {
+        uring_buffer_count_ = count;
+        uring_buffer_size_ = size;
+      }
+
+      /** \brief Select what happens to a packet that does not fit in the queue; defaults to DROP_OLDEST
+       *  \details BLOCK_PRODUCER stops reading the socket until there is room, leaving TCP flow
+       *           control to slow the sensor down. DROP_WHOLE_FRAME needs a frame start detector.
+       *  \throws std::invalid_argument for BLOCK_PRODUCER on a shared io_service, where waiting
+       *          would stall every other client serviced by the same io thread
+       */
+      void setBackpressurePolicy(common::BackpressurePolicy policy)
+      {
+        if (policy == common::BackpressurePolicy::BLOCK_PRODUCER && !own_io_service_)
+          throw std::invalid_argument("BLOCK_PRODUCER needs a client owning its io_service");
+
+        buff_queue_.setPolicy(policy);
+      }
+
+      common::BackpressurePolicy getBackpressurePolicy() const { return buff_queue_.getPolicy(); }
+
+      /** \brief Limit the queue by bytes as well as packet count; 0 (the default) disables the byte limit */
+      void setMaxQueueBytes(std::size_t max_bytes) { buff_queue_.setMaxBytes(max_bytes); }
+
+      /** \brief Set the function marking the first packet of each frame; set before run
+       *  \details Without one, every packet counts as a frame of its own.
+       */
+      void setFrameStartDetector(FrameStartDetector detector) { frame_start_detector_ = detector; }
+
+      /** \brief Set socket and thread tuning; socket settings are applied on connect and thread
+       *         settings when run starts
+       *  \details The thread calling run gets its previous affinity and scheduling back when run
+       *           returns. On a shared io_service the threads belong to the caller so thread
+       *           settings are not applied. Kernel timestamps are only applied in bulk receive mode.
+       */
+      void setOptions(const TCPClientOptions& options) { options_ = options; }
+      const TCPClientOptions& getOptions() const { return options_; }
+
+      /** \brief What was actually applied for the current or last run */
+      AppliedTCPClientOptions appliedOptions() const
+      {
+        std::lock_guard<std::mutex> lk(options_mutex_);
+        AppliedTCPClientOptions applied = applied_options_;
+        applied.errors.insert(applied.errors.end(), socket_option_errors_.begin(), socket_option_errors_.end());
+        return applied;
+      }
+
+      /** \brief Scan for the next plausible header after an invalid one instead of stopping
+       *  \details Bytes are discarded until isPlausibleHeader accepts a header and framing resumes
+       *           there, so a corrupted byte costs the packet it is in rather than the connection.
+       *           In bulk receive mode the bytes already received are scanned in place; in per
+       *           packet mode the header is slid forward a byte per read.
+       */
+      void setResync(bool resync) { resync_ = resync; }
+      bool getResync() const { return resync_; }
+
+      /** \brief Treat headers announcing more than max_packet_size bytes as invalid */
+      void setMaxPacketSize(std::size_t max_packet_size) { max_packet_size_ = max_packet_size; }
+
+      /** \brief Counters for resyncs and skipped bytes, accumulated over all runs */
+      const FramingStatistics& framingStatistics() const { return framing_statistics_; }
+
+      /** \brief Reconnect after a failed connect or read instead of stopping with an error
+       *  \details Attempts are delayed starting at initial_delay and doubling up to max_delay;
+       *           the delay resets once connected. The queues, the resolved endpoints and
+       *           anything connected downstream (parser state included) carry over, so output
+       *           resumes as soon as packets flow again. Invalid headers still stop the client.
+       *           Only the first failed attempt of an outage is printed; connectionStatistics
+       *           counts them all.
+       */
+      void setReconnect(bool reconnect,
+                        std::chrono::milliseconds initial_delay = DEFAULT_RECONNECT_INITIAL_DELAY,
+                        std::chrono::milliseconds max_delay = DEFAULT_RECONNECT_MAX_DELAY)
+      {
+        reconnect_ = reconnect;
+        reconnect_initial_delay_ = initial_delay;
+        reconnect_max_delay_ = std::max(max_delay, initial_delay);
+      }
+
+      bool getReconnect() const { return reconnect_; }
+
+      /** \brief Abandon a connection attempt after timeout; 0 (the default) leaves it to the OS */
+      void setConnectTimeout(std::chrono::milliseconds timeout) { connect_timeout_ = timeout; }
+
+      /** \brief Counters for connects, reconnects and failures, accumulated over all runs */
+      const ConnectionStatistics& connectionStatistics() const { return connection_statistics_; }
+
+      /** \brief Counters for dropped packets and socket thread waits, accumulated over all runs */
+      const common::QueueStatistics& queueStatistics() const { return buff_queue_.statistics(); }
+
+      /** \brief Time from a packet being queued to it being signaled, accumulated over all runs */
+      const LatencyHistogram& handoffLatency() const { return handoff_latency_; }
+
     protected:
 
       /** \brief Asynchronously wait for connection. */
@@ -87,27 +316,212 @@ namespace quanergy
       /** \brief Handle read of packet body. */
       virtual void handleReadBody(const boost::system::error_code& error);
 
+      /** \brief Asynchronously read as much as is available in bulk receive mode. */
+      virtual void startStreamRead();
+
+      /** \brief Handle a bulk read; frames and queues every complete packet. */
+      virtual void handleStreamRead(const boost::system::error_code& error, std::size_t bytes_transferred);
+
+      /** \brief Handle the socket becoming readable in bulk mode with kernel timestamps; reads and
+       *         passes the result on to handleStreamRead.
+       */
+      virtual void handleStreamReady(const boost::system::error_code& error);
+
+      /** \brief Wait for io_uring receive completions. */
+      virtual void startUringRead();
+
+      /** \brief Handle io_uring receive completions; frames and queues every complete packet. */
+      virtual void handleUringRead(const boost::system::error_code& error);
+
+      /** \brief Queue a complete packet for the signal thread. */
+      void enqueuePacket(ResultType packet);
+
       /** \brief Pulls packets off buffer queue and calls signal. */
       virtual void signalPackets();
 
       std::unique_ptr<boost::asio::ip::tcp::socket>       read_socket_;
+      /// header of the packet being read
       std::vector<char>                                   buff_;
+      /// pooled buffer the packet being read is received into
+      ResultType                                          packet_;
 
     private:
 
-      boost::asio::io_service                       io_service_;
+      /// packet with the time it was queued for latency statistics
+      struct QueuedPacket
+      {
+        ResultType    packet;
+        std::uint64_t queued_ns = 0;
+      };
+
+      /// steady clock in nanoseconds
+      static std::uint64_t nowNanoseconds()
+      {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      /// record handoff latency and add the packet to the batch
+      void batchPacket(QueuedPacket& queued);
+
+      /// fire the signals for the batched packets and release them
+      void signalBatch();
+
+      /// set up the queues and framing state for a new run
+      void resetSession();
+
+      /// forget any partially received packet
+      void resetFraming();
+
+      /// whether a header can be framed; silent while resynchronizing
+      bool headerUsable(const HEADER& header);
+
+      /// note that framing was lost; counts once per loss
+      void beginResync();
+
+      /// close the socket and connect again after the reconnect delay
+      void scheduleReconnect();
+
+      /// connect to the resolved endpoints
+      void connectEndpoints();
+
+      /// record the error and stop; for a shared io_service
+      void fail(std::exception_ptr error);
+
+      /// completion handler wrapper; on a shared io_service an exception stops only this client
+      template <class Handler>
+      struct GuardedHandler
+      {
+        template <class... Args>
+        void operator()(Args&&... args)
+        {
+          try
+          {
+            handler(std::forward<Args>(args)...);
+          }
+          catch (...)
+          {
+            // a client owning its io_service lets run() catch it
+            if (client->own_io_service_)
+              throw;
+
+            client->fail(std::current_exception());
+          }
+        }
+
+        TCPClient* client;
+        Handler    handler;
+      };
+
+      /// guard a handler and serialize it with the other handlers of this client
+      template <class Handler>
+      auto guard(Handler handler)
+        -> decltype(std::declval<boost::asio::io_service::strand&>().wrap(std::declval<GuardedHandler<Handler>>()))
+      {
+        return strand_.wrap(GuardedHandler<Handler>{this, handler});
+      }
+
+      /// copy the received bytes from stream_buffers_[index] on into correctly sized buffers
+      void reframeStream(std::size_t index, std::size_t available);
+
+      /// wait for the socket to become readable; bulk mode with kernel timestamps
+      void waitStreamReady();
+
+      /// frame bytes received in io_uring mode, completing packets in packet_
+      void frameBytes(const char* data, std::size_t size);
+
+      /// cancel io_uring receiving for the current connection, if any
+      void closeUring();
+
+      /// upper limit on the number of buffers a single bulk read is scattered across
+      static const std::size_t MAX_STREAM_BUFFERS = 32;
+
+      /// set unless the io_service is shared
+      std::unique_ptr<boost::asio::io_service>      own_io_service_;
+      boost::asio::io_service&                      io_service_;
+      boost::asio::io_service::strand               strand_;
+      boost::asio::steady_timer                     connect_timer_;
+      boost::asio::steady_timer                     reconnect_timer_;
+      boost::asio::ip::tcp::resolver                resolver_;
       boost::asio::ip::tcp::resolver::query         host_query_;
+      std::vector<boost::asio::ip::tcp::endpoint>   endpoints_;
+
+      bool                                          reconnect_ = false;
+      std::chrono::milliseconds                     reconnect_initial_delay_ = DEFAULT_RECONNECT_INITIAL_DELAY;
+      std::chrono::milliseconds                     reconnect_max_delay_ = DEFAULT_RECONNECT_MAX_DELAY;
+      std::chrono::milliseconds                     reconnect_delay_ = DEFAULT_RECONNECT_INITIAL_DELAY;
+      std::chrono::milliseconds                     connect_timeout_ {0};
+      bool                                          connecting_ = false;
+      bool                                          connect_timed_out_ = false;
+      bool                                          connected_before_ = false;
+      /// a connect or resolve failed since the last connect; later attempts go unreported
+      bool                                          retrying_ = false;
+      ConnectionStatistics                          connection_statistics_;
+
+      TCPClientOptions                              options_;
+      mutable std::mutex                            options_mutex_;
+      AppliedTCPClientOptions                       applied_options_;
+      std::vector<std::string>                      socket_option_errors_;
+
+      /// shared io_service only
+      std::function<void ()>                        packets_ready_;
+      std::atomic<bool>                             drain_scheduled_ {false};
+      std::deque<typename common::BoundedQueue<QueuedPacket>::Entry> drain_queue_;
+      mutable std::mutex                            error_mutex_;
+      std::exception_ptr                            error_;
 
       /// thread for running signals
       std::unique_ptr<std::thread> signal_thread_;
 
-      std::queue<std::shared_ptr<std::vector<char>>> buff_queue_;
-      std::size_t max_queue_size_;
-      std::mutex                  buff_queue_mutex_;
-      std::condition_variable     buff_queue_conditional_;
-      std::atomic<bool>           kill_; // std::atomic_bool lacks proper constructors in MSVC
+      common::BoundedQueue<QueuedPacket>  buff_queue_;
+      PacketBufferPool                    buffer_pool_;
+      std::atomic<bool>                   kill_; // std::atomic_bool lacks proper constructors in MSVC
+      FrameStartDetector                  frame_start_detector_;
+
+      HandoffMode                                 handoff_mode_ = HandoffMode::LOCKED_QUEUE;
+      std::unique_ptr<SPSCQueue<QueuedPacket>>    ring_;
+      SpinParkWaiter                              ring_waiter_;
+      /// bytes in the ring for the byte limit; added by the producer, removed by the consumer
+      std::atomic<std::size_t>                    ring_bytes_ {0};
+      /// socket thread is dropping the rest of a frame
+      bool                                        ring_dropping_frame_ = false;
+      LatencyHistogram                            handoff_latency_;
+
+      ReceiveMode                                 receive_mode_ = ReceiveMode::PER_PACKET;
+      std::size_t                                 bulk_read_size_ = DEFAULT_BULK_READ_SIZE;
+      /// buffers posted for the next bulk read; the first holds stream_fill_ bytes of a packet
+      std::vector<ResultType>                     stream_buffers_;
+      std::size_t                                 stream_fill_ = 0;
+      /// packet size expected next; the following buffers are sized for it
+      std::size_t                                 stream_packet_size_ = sizeof(HEADER);
+      std::vector<boost::asio::mutable_buffer>    stream_read_buffers_;
+      std::vector<char>                           stream_carry_;
+
+      /// io_uring receive of the current connection; null unless in io_uring mode
+      std::unique_ptr<UringReceiver>              uring_;
+      std::size_t                                 uring_buffer_count_ = DEFAULT_URING_BUFFER_COUNT;
+      std::size_t                                 uring_buffer_size_ = DEFAULT_URING_BUFFER_SIZE;
+      /// bytes of the header in buff_, then of the packet in packet_, received so far in io_uring mode
+      std::size_t                                 header_fill_ = 0;
+      std::size_t                                 packet_fill_ = 0;
+
+      /// arrival time given to packets completed by the current read
+      std::uint64_t                               read_arrival_ns_ = 0;
+      /// kernel receive time of the bytes handed to handleStreamRead; 0 for none
+      std::uint64_t                               stream_kernel_arrival_ns_ = 0;
+      /// socket of the current connection has kernel timestamps applied
+      bool                                        kernel_timestamps_ = false;
+
+      bool                                        resync_ = false;
+      bool                                        resyncing_ = false;
+      std::size_t                                 max_packet_size_ = DEFAULT_MAX_PACKET_SIZE;
+      FramingStatistics                           framing_statistics_;
+
+      /// packets taken off the queue in one go; only touched by the thread signaling
+      BatchType                                   batch_;
 
       Signal signal_;
+      BatchSignal batch_signal_;
     };
 
   } // namespace client
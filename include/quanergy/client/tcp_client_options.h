@@ -0,0 +1,142 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file tcp_client_options.h
+ *
+ *  \brief Provide socket and thread tuning options for the TCP client
+ */
+
+#ifndef QUANERGY_CLIENT_TCP_CLIENT_OPTIONS_H
+#define QUANERGY_CLIENT_TCP_CLIENT_OPTIONS_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+// networking
+#include <boost/asio.hpp>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /** \brief scheduling policy for a client thread */
+    enum struct SchedulingPolicy
+    {
+      DEFAULT,    ///< leave the policy and priority alone
+      FIFO,       ///< real-time first in, first out (SCHED_FIFO)
+      ROUND_ROBIN ///< real-time round robin (SCHED_RR)
+    };
+
+    /** \brief placement and scheduling of one client thread; defaults change nothing */
+    struct DLLEXPORT ThreadOptions
+    {
+      /// CPUs the thread may run on; empty leaves the affinity alone
+      std::vector<int> cpus;
+      SchedulingPolicy policy = SchedulingPolicy::DEFAULT;
+      /// real-time priority; only used with FIFO and ROUND_ROBIN
+      int priority = 0;
+    };
+
+    /** \brief socket and thread settings applied by TCPClient; defaults change nothing */
+    struct DLLEXPORT TCPClientOptions
+    {
+      /// SO_RCVBUF in bytes; 0 leaves the OS default
+      int receive_buffer_size = 0;
+      /// TCP_NODELAY
+      bool tcp_no_delay = false;
+      /// SO_BUSY_POLL in microseconds; 0 leaves it off; Linux only
+      int busy_poll = 0;
+      /// stamp packets with the kernel receive time (SO_TIMESTAMPING) instead of the time the
+      /// read completed; bulk receive mode on Linux only
+      bool kernel_timestamps = false;
+      /// thread running the io_service, i.e. the one calling run; its previous affinity and
+      /// scheduling are restored when run returns
+      ThreadOptions io_thread;
+      /// thread firing the signal
+      ThreadOptions signal_thread;
+
+      /// \brief convert a comma separated list of CPUs and ranges such as "2,4-6" to CPU indices
+      static std::vector<int> cpusFromString(const std::string& cpus);
+
+      /// \brief convert "default", "fifo" or "rr" to a scheduling policy
+      static SchedulingPolicy policyFromString(const std::string& policy);
+    };
+
+    /** \brief what was applied to a thread */
+    struct DLLEXPORT AppliedThreadOptions
+    {
+      bool affinity = false;
+      bool scheduling = false;
+    };
+
+    /** \brief placement and scheduling of a thread from before applyThreadOptions changed them */
+    struct DLLEXPORT SavedThreadOptions
+    {
+      /// the affinity was changed and cpus holds the previous one
+      bool affinity = false;
+      std::vector<int> cpus;
+      /// the scheduling was changed and policy and priority hold the previous ones, in OS terms
+      bool scheduling = false;
+      int policy = 0;
+      int priority = 0;
+    };
+
+    /** \brief what TCPClient actually applied; socket values are read back from the OS */
+    struct DLLEXPORT AppliedTCPClientOptions
+    {
+      /// SO_RCVBUF as reported by the OS; Linux reports double the requested size
+      int receive_buffer_size = 0;
+      bool tcp_no_delay = false;
+      int busy_poll = 0;
+      bool kernel_timestamps = false;
+      AppliedThreadOptions io_thread;
+      AppliedThreadOptions signal_thread;
+      /// settings that could not be applied and why
+      std::vector<std::string> errors;
+    };
+
+    DLLEXPORT std::ostream& operator<<(std::ostream& os, const AppliedTCPClientOptions& applied);
+
+    /** \brief apply the socket settings to a connected socket and read back the result */
+    DLLEXPORT void applySocketOptions(boost::asio::ip::tcp::socket& socket,
+                                      const TCPClientOptions& options,
+                                      AppliedTCPClientOptions& applied);
+
+    /** \brief read what is available on a socket with kernel_timestamps applied
+     *  \details The socket must be in non-blocking mode; error is would_block if nothing was
+     *           available and eof once the peer closed the connection.
+     *  \param arrival_ns is set to the kernel receive time of the data read, in nanoseconds
+     *         since the epoch on the system clock; left alone if the kernel supplied none
+     *  \return number of bytes read, scattered across buffers in order
+     */
+    DLLEXPORT std::size_t receiveWithTimestamp(boost::asio::ip::tcp::socket& socket,
+                                               const std::vector<boost::asio::mutable_buffer>& buffers,
+                                               std::uint64_t& arrival_ns,
+                                               boost::system::error_code& error);
+
+    /** \brief apply thread settings to the calling thread
+     *  \param name identifies the thread in error messages
+     *  \param saved if not null, receives what was changed so restoreThreadOptions can undo it
+     */
+    DLLEXPORT void applyThreadOptions(const ThreadOptions& options,
+                                      const std::string& name,
+                                      AppliedThreadOptions& applied,
+                                      std::vector<std::string>& errors,
+                                      SavedThreadOptions* saved = nullptr);
+
+    /** \brief restore what applyThreadOptions changed on the calling thread */
+    DLLEXPORT void restoreThreadOptions(const SavedThreadOptions& saved);
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,83 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file uring_receiver.h
+ *
+ *  \brief Provide an io_uring receive path for a connected TCP socket
+ */
+
+#ifndef QUANERGY_CLIENT_URING_RECEIVER_H
+#define QUANERGY_CLIENT_URING_RECEIVER_H
+
+#include <memory>
+#include <functional>
+
+// networking
+#include <boost/asio.hpp>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /// default number of buffers registered with the ring
+    const std::size_t DEFAULT_URING_BUFFER_COUNT = 64;
+    /// default size of each registered buffer
+    const std::size_t DEFAULT_URING_BUFFER_SIZE = 64 * 1024;
+
+    /** \brief UringReceiver keeps a multishot receive armed on a socket with io_uring
+     *  \details The kernel receives into a ring of registered buffers without a submission per
+     *           read; an eventfd wakes the io_service when completions are pending so the rest of
+     *           the client stays on asio. Each buffer goes back to the kernel as soon as its bytes
+     *           have been handled. Linux only; needs a kernel with multishot receive (6.0).
+     */
+    class DLLEXPORT UringReceiver
+    {
+    public:
+      /// called with the bytes of each completed receive, in order
+      typedef std::function<void (const char* data, std::size_t size)> DataHandler;
+      /// called when completions are pending, or with an error once the wait was cancelled
+      typedef std::function<void (const boost::system::error_code& error)> WaitHandler;
+
+      /** \brief Constructor; sets up the ring and starts receiving
+       *  \param socket is a connected socket; it must stay open for the life of the receiver
+       *  \throws boost::system::system_error if io_uring is not available
+       */
+      UringReceiver(boost::asio::io_service& io_service,
+                    boost::asio::ip::tcp::socket& socket,
+                    std::size_t buffer_count = DEFAULT_URING_BUFFER_COUNT,
+                    std::size_t buffer_size = DEFAULT_URING_BUFFER_SIZE);
+
+      // noncopyable
+      UringReceiver(const UringReceiver&) = delete;
+      UringReceiver& operator=(const UringReceiver&) = delete;
+
+      /** \brief cancels the receive and waits for the kernel to let go of the buffers */
+      ~UringReceiver();
+
+      /** \brief wait on the io_service for completions */
+      void asyncWait(WaitHandler handler);
+
+      /** \brief hand all pending data to handler
+       *  \param error is set to eof once the peer closed the connection, or to the receive error
+       */
+      void reap(const DataHandler& handler, boost::system::error_code& error);
+
+      /** \brief number of times the kernel ran out of buffers because we fell behind */
+      std::size_t bufferExhaustedCount() const;
+
+    private:
+      struct Impl;
+      std::unique_ptr<Impl> impl_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,104 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file arrival_time.h
+ *
+ *  \brief Provide the arrival time of the packet data a cloud was built from
+ *         and the deleter carrying it
+ */
+
+#ifndef QUANERGY_COMMON_ARRIVAL_TIME_H
+#define QUANERGY_COMMON_ARRIVAL_TIME_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <boost/shared_ptr.hpp>
+
+namespace quanergy
+{
+  namespace common
+  {
+    /** \brief current time on the arrival clock in nanoseconds since the epoch
+     *  \details This is the system clock, which is also the clock kernel receive timestamps
+     *           and the sensor use, so arrival times can be compared with both.
+     */
+    inline std::uint64_t arrivalClockNanoseconds()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /** \brief CloudRecycler takes back clouds handed out by a pool instead of deleting them */
+    struct CloudRecycler
+    {
+      virtual ~CloudRecycler() {}
+
+      /// take back a cloud of the type the pool hands out
+      virtual void recycle(void* cloud) = 0;
+    };
+
+    /** \brief CloudDeleter deletes or recycles a cloud and carries its arrival time
+     *  \details The arrival time lives in the control block of the shared pointer so the
+     *           cloud types stay plain PCL clouds. Only clouds allocated with makeCloud or
+     *           handed out by a FramePool have one; for any other cloud it reads as 0 and
+     *           setting it has no effect.
+     */
+    struct CloudDeleter
+    {
+      template <class T>
+      void operator()(T* cloud) const
+      {
+        if (recycler)
+          recycler->recycle(cloud);
+        else
+          delete cloud;
+      }
+
+      /// arrival time of the packet that completed the cloud; 0 if unknown
+      std::uint64_t arrival_ns = 0;
+      /// pool the cloud goes back to; null to delete it
+      std::shared_ptr<CloudRecycler> recycler;
+    };
+
+    /// allocate an empty cloud able to carry an arrival time
+    template <class CLOUD>
+    boost::shared_ptr<CLOUD> makeCloud()
+    {
+      return boost::shared_ptr<CLOUD>(new CLOUD(), CloudDeleter());
+    }
+
+    /// arrival time of the data in a cloud on the arrival clock; 0 if unknown
+    template <class T>
+    std::uint64_t getArrivalTime(const boost::shared_ptr<T>& cloud)
+    {
+      const CloudDeleter* deleter = boost::get_deleter<CloudDeleter>(cloud);
+      return (deleter ? deleter->arrival_ns : 0);
+    }
+
+    /// set the arrival time of a cloud allocated with makeCloud
+    template <class T>
+    void setArrivalTime(const boost::shared_ptr<T>& cloud, std::uint64_t arrival_ns)
+    {
+      CloudDeleter* deleter = boost::get_deleter<CloudDeleter>(cloud);
+      if (deleter)
+        deleter->arrival_ns = arrival_ns;
+    }
+
+    /// pass the arrival time on from an input cloud to the cloud computed from it
+    template <class T, class U>
+    void copyArrivalTime(const boost::shared_ptr<T>& from, const boost::shared_ptr<U>& to)
+    {
+      setArrivalTime(to, getArrivalTime(from));
+    }
+
+  } // namespace common
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,366 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file bounded_queue.h
+ *
+ *  \brief Provide a bounded producer/consumer queue with selectable backpressure
+ */
+
+#ifndef QUANERGY_COMMON_BOUNDED_QUEUE_H
+#define QUANERGY_COMMON_BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace quanergy
+{
+  namespace common
+  {
+    /** \brief what a bounded queue does with a new item when it is full */
+    enum struct BackpressurePolicy
+    {
+      DROP_OLDEST,     ///< queue the new item and drop from the front until within limits
+      DROP_NEWEST,     ///< drop the new item
+      BLOCK_PRODUCER,  ///< wait until the consumer makes room
+      DROP_WHOLE_FRAME ///< drop the partially queued frame and everything up to the next frame start
+    };
+
+    /** \brief QueueStatistics counts what a bounded queue dropped or waited for
+     *  \details Counters are atomic so they can be read from any thread while the queue is in use.
+     */
+    struct QueueStatistics
+    {
+      void recordDrop(std::size_t bytes)
+      {
+        dropped_items.fetch_add(1, std::memory_order_relaxed);
+        dropped_bytes.fetch_add(bytes, std::memory_order_relaxed);
+      }
+
+      void recordBlock(std::uint64_t nanoseconds)
+      {
+        blocked_count.fetch_add(1, std::memory_order_relaxed);
+        blocked_ns.fetch_add(nanoseconds, std::memory_order_relaxed);
+      }
+
+      void reset()
+      {
+        dropped_items = 0;
+        dropped_bytes = 0;
+        dropped_frames = 0;
+        blocked_count = 0;
+        blocked_ns = 0;
+      }
+
+      /// items dropped, under any policy
+      std::atomic<std::uint64_t> dropped_items {0};
+      /// bytes in the dropped items, as reported by the producer
+      std::atomic<std::uint64_t> dropped_bytes {0};
+      /// frames dropped under DROP_WHOLE_FRAME
+      std::atomic<std::uint64_t> dropped_frames {0};
+      /// number of times the producer waited under BLOCK_PRODUCER
+      std::atomic<std::uint64_t> blocked_count {0};
+      /// total time the producer waited under BLOCK_PRODUCER
+      std::atomic<std::uint64_t> blocked_ns {0};
+    };
+
+    /** \brief BoundedQueue is a mutex protected queue limited by item count and, optionally, bytes
+     *  \details Drops are counted in statistics() rather than reported, so an overloaded
+     *           producer does not also pay for console output. For DROP_WHOLE_FRAME the
+     *           producer marks the items that start a frame; an item that is never marked
+     *           is treated as a frame of its own.
+     */
+    template <class T>
+    class BoundedQueue
+    {
+    public:
+      /// queued item with its accounting
+      struct Entry
+      {
+        T           item;
+        std::size_t bytes;
+        bool        frame_start;
+      };
+
+      /** \brief Constructor
+       *  \param max_items is the maximum number of queued items
+       *  \param max_bytes is the maximum number of queued bytes; 0 for no byte limit
+       *  \param policy determines what happens to an item that does not fit
+       */
+      explicit BoundedQueue(std::size_t max_items,
+                            std::size_t max_bytes = 0,
+                            BackpressurePolicy policy = BackpressurePolicy::DROP_OLDEST)
+        : max_items_(max_items)
+        , max_bytes_(max_bytes)
+        , policy_(policy)
+      {
+      }
+
+      // noncopyable
+      BoundedQueue(const BoundedQueue&) = delete;
+      BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+      void setPolicy(BackpressurePolicy policy)
+      {
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          policy_.store(policy, std::memory_order_relaxed);
+          dropping_frame_ = false;
+        }
+        not_full_.notify_all();
+      }
+
+      BackpressurePolicy getPolicy() const { return policy_.load(std::memory_order_relaxed); }
+
+      void setMaxItems(std::size_t max_items)
+      {
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          max_items_.store(max_items, std::memory_order_relaxed);
+        }
+        not_full_.notify_all();
+      }
+
+      std::size_t getMaxItems() const { return max_items_.load(std::memory_order_relaxed); }
+
+      /// 0 disables the byte limit
+      void setMaxBytes(std::size_t max_bytes)
+      {
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          max_bytes_.store(max_bytes, std::memory_order_relaxed);
+        }
+        not_full_.notify_all();
+      }
+
+      std::size_t getMaxBytes() const { return max_bytes_.load(std::memory_order_relaxed); }
+
+      /// clear the queue and accept items again
+      void open()
+      {
+        clear();
+        std::lock_guard<std::mutex> lk(mutex_);
+        dropping_frame_ = false;
+        closed_ = false;
+      }
+
+      /// remove all items without counting them as dropped
+      void clear()
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        entries_.clear();
+        bytes_ = 0;
+      }
+
+      /// wake all waiters; pushes are refused and pops fail until open is called
+      void close()
+      {
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+      }
+
+      /** \brief add an item
+       *  \param bytes is the size used for the byte limit and drop statistics
+       *  \param frame_start marks the first item of a frame for DROP_WHOLE_FRAME
+       *  \return false if the item was not queued
+       */
+      bool push(T item, std::size_t bytes = 0, bool frame_start = true)
+      {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (closed_)
+          return false;
+
+        if (dropping_frame_)
+        {
+          if (!frame_start)
+          {
+            statistics_.recordDrop(bytes);
+            return false;
+          }
+
+          dropping_frame_ = false;
+        }
+
+        if (full(bytes))
+        {
+          BackpressurePolicy policy = policy_.load(std::memory_order_relaxed);
+          if (policy == BackpressurePolicy::BLOCK_PRODUCER)
+          {
+            auto start = std::chrono::steady_clock::now();
+            not_full_.wait(lk, [this, bytes]{return (closed_ || !full(bytes));});
+            statistics_.recordBlock(std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start).count());
+
+            if (closed_)
+              return false;
+          }
+          else if (policy == BackpressurePolicy::DROP_NEWEST)
+          {
+            statistics_.recordDrop(bytes);
+            return false;
+          }
+          else if (policy == BackpressurePolicy::DROP_WHOLE_FRAME)
+          {
+            // the queued part of the current frame goes too; a new frame start is dropped on its own
+            if (!frame_start)
+            {
+              while (!entries_.empty())
+              {
+                bool start = entries_.back().frame_start;
+                popBack();
+                if (start)
+                  break;
+              }
+            }
+
+            statistics_.recordDrop(bytes);
+            statistics_.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+            dropping_frame_ = true;
+            return false;
+          }
+        }
+
+        entries_.push_back(Entry{std::move(item), bytes, frame_start});
+        bytes_ += bytes;
+
+        // DROP_OLDEST; the newest item always stays
+        while (entries_.size() > 1 && overLimit())
+        {
+          statistics_.recordDrop(entries_.front().bytes);
+          bytes_ -= entries_.front().bytes;
+          entries_.pop_front();
+        }
+
+        lk.unlock();
+        not_empty_.notify_one();
+        return true;
+      }
+
+      /** \brief wait for items and take all of them
+       *  \param entries receives the queued entries, replacing its contents
+       *  \return false if the queue was closed
+       */
+      bool popAll(std::deque<Entry>& entries)
+      {
+        std::unique_lock<std::mutex> lk(mutex_);
+        not_empty_.wait(lk, [this]{return (!entries_.empty() || closed_);});
+
+        if (closed_)
+          return false;
+
+        entries.clear();
+        // swapping keeps the allocated blocks of both deques in use
+        std::swap(entries_, entries);
+        bytes_ = 0;
+        lk.unlock();
+
+        not_full_.notify_all();
+        return true;
+      }
+
+      /** \brief take all queued items without waiting
+       *  \param entries receives the queued entries, replacing its contents
+       *  \return false if the queue was empty or closed
+       */
+      bool tryPopAll(std::deque<Entry>& entries)
+      {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if (entries_.empty() || closed_)
+          return false;
+
+        entries.clear();
+        std::swap(entries_, entries);
+        bytes_ = 0;
+        lk.unlock();
+
+        not_full_.notify_all();
+        return true;
+      }
+
+      /** \brief wait for an item and take it
+       *  \return false if the queue was closed
+       */
+      bool pop(T& item)
+      {
+        std::unique_lock<std::mutex> lk(mutex_);
+        not_empty_.wait(lk, [this]{return (!entries_.empty() || closed_);});
+
+        if (closed_)
+          return false;
+
+        item = std::move(entries_.front().item);
+        bytes_ -= entries_.front().bytes;
+        entries_.pop_front();
+        lk.unlock();
+
+        not_full_.notify_all();
+        return true;
+      }
+
+      std::size_t size() const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return entries_.size();
+      }
+
+      QueueStatistics& statistics() { return statistics_; }
+      const QueueStatistics& statistics() const { return statistics_; }
+
+    private:
+      /// whether adding bytes would exceed a limit; an empty queue always takes one item
+      bool full(std::size_t bytes) const
+      {
+        if (entries_.empty())
+          return false;
+
+        std::size_t max_bytes = max_bytes_.load(std::memory_order_relaxed);
+        return (entries_.size() >= max_items_.load(std::memory_order_relaxed) ||
+                (max_bytes != 0 && bytes_ + bytes > max_bytes));
+      }
+
+      bool overLimit() const
+      {
+        std::size_t max_bytes = max_bytes_.load(std::memory_order_relaxed);
+        return (entries_.size() > max_items_.load(std::memory_order_relaxed) ||
+                (max_bytes != 0 && bytes_ > max_bytes));
+      }
+
+      void popBack()
+      {
+        statistics_.recordDrop(entries_.back().bytes);
+        bytes_ -= entries_.back().bytes;
+        entries_.pop_back();
+      }
+
+      std::deque<Entry>         entries_;
+      std::size_t               bytes_ = 0;
+      // limits are written under the mutex but atomic so the getters can read them per packet
+      std::atomic<std::size_t>  max_items_;
+      std::atomic<std::size_t>  max_bytes_;
+      std::atomic<BackpressurePolicy> policy_;
+      bool                      dropping_frame_ = false;
+      bool                      closed_ = false;
+
+      mutable std::mutex        mutex_;
+      std::condition_variable   not_empty_;
+      std::condition_variable   not_full_;
+
+      QueueStatistics           statistics_;
+    };
+
+  } // namespace common
+
+} // namespace quanergy
+
+#endif
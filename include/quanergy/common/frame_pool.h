@@ -0,0 +1,236 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file frame_pool.h
+ *
+ *  \brief Provide a recycling pool of point clouds sized to the frames seen
+ */
+
+#ifndef QUANERGY_COMMON_FRAME_POOL_H
+#define QUANERGY_COMMON_FRAME_POOL_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+
+#include <quanergy/common/arrival_time.h>
+
+namespace quanergy
+{
+  namespace common
+  {
+    /// default number of clouds kept by a frame pool; covers the parser and a couple downstream
+    const std::size_t DEFAULT_FRAME_POOL_CAPACITY = 4;
+    /// number of recent frames the reservation is based on
+    const std::size_t FRAME_POOL_SIZE_HISTORY = 16;
+
+    /** \brief FramePoolFootprint is a snapshot of the memory held by a FramePool */
+    struct FramePoolFootprint
+    {
+      /// clouds on the free list
+      std::size_t pooled_clouds = 0;
+      /// bytes reserved by the clouds on the free list
+      std::size_t pooled_bytes = 0;
+      /// clouds currently handed out (including transient ones)
+      std::size_t in_use = 0;
+      /// largest number of clouds handed out at the same time
+      std::size_t high_water_mark = 0;
+      /// number of clouds allocated because the free list was empty
+      std::size_t allocations = 0;
+      /// points reserved in each cloud handed out
+      std::size_t reserve_points = 0;
+    };
+
+    inline std::ostream& operator<<(std::ostream& os, const FramePoolFootprint& footprint)
+    {
+      os << "pooled clouds: " << footprint.pooled_clouds
+         << " (" << footprint.pooled_bytes / 1024 << " KiB)"
+         << "; in use: " << footprint.in_use
+         << "; high water mark: " << footprint.high_water_mark
+         << "; allocations: " << footprint.allocations
+         << "; reserve: " << footprint.reserve_points << " points";
+      return os;
+    }
+
+    /** \brief FramePool hands out clouds that return to the pool once downstream releases them
+     *  \details Clouds are boost::shared_ptr with a CloudDeleter, so they carry an arrival time
+     *           like clouds from makeCloud. Instead of reserving for the largest possible frame,
+     *           each cloud handed out is reserved for the largest of the recent frames reported
+     *           with observeFrameSize plus some headroom; recycled clouds holding much more than
+     *           that are shrunk so a transient spike doesn't pin memory. When no free cloud is
+     *           available a new one is allocated. The pool never holds more than its capacity;
+     *           clouds released beyond that are freed. Clouds may safely outlive the pool.
+     *  \note acquire, observeFrameSize and setMaxReserve must be called from a single thread, the
+     *        one producing frames. Clouds may be released, and footprint and reservePoints read,
+     *        from any thread.
+     */
+    template <class CLOUD>
+    class FramePool
+    {
+    public:
+      typedef boost::shared_ptr<CLOUD> CloudPtr;
+
+      /** \brief Constructor
+       *  \param capacity is the number of clouds kept by the pool
+       */
+      explicit FramePool(std::size_t capacity = DEFAULT_FRAME_POOL_CAPACITY)
+        : state_(std::make_shared<State>())
+      {
+        state_->capacity = capacity;
+        state_->free_list.reserve(capacity);
+      }
+
+      // noncopyable
+      FramePool(const FramePool&) = delete;
+      FramePool& operator=(const FramePool&) = delete;
+
+      /** \brief get an empty cloud reserved for the expected frame size
+       *  \details the header is reset and the cloud is unorganized and dense
+       */
+      CloudPtr acquire()
+      {
+        const std::size_t reserve_points = reserve_points_.load(std::memory_order_relaxed);
+        CLOUD* cloud = nullptr;
+
+        {
+          std::lock_guard<std::mutex> lk(state_->mutex);
+          if (!state_->free_list.empty())
+          {
+            cloud = state_->free_list.back();
+            state_->free_list.pop_back();
+          }
+        }
+
+        if (cloud)
+        {
+          // clearing keeps the capacity; drop it if far more than we expect to need
+          if (cloud->points.capacity() > 2 * reserve_points)
+            decltype(cloud->points)().swap(cloud->points);
+
+          cloud->clear();
+          cloud->header = decltype(cloud->header)();
+          cloud->is_dense = true;
+        }
+        else
+        {
+          ++state_->allocations;
+          cloud = new CLOUD();
+        }
+
+        cloud->reserve(reserve_points);
+
+        std::size_t in_use = ++state_->in_use;
+        std::size_t high_water = state_->high_water_mark;
+        while (in_use > high_water &&
+               !state_->high_water_mark.compare_exchange_weak(high_water, in_use))
+        {
+        }
+
+        CloudDeleter deleter;
+        deleter.recycler = state_;
+        return CloudPtr(cloud, deleter);
+      }
+
+      /** \brief report the size of a completed frame; sets the reservation for later clouds */
+      void observeFrameSize(std::size_t points)
+      {
+        frame_sizes_[frame_index_] = points;
+        frame_index_ = (frame_index_ + 1) % FRAME_POOL_SIZE_HISTORY;
+
+        std::size_t largest = *std::max_element(frame_sizes_, frame_sizes_ + FRAME_POOL_SIZE_HISTORY);
+        // an eighth of headroom absorbs frame to frame variation without regrowing
+        reserve_points_.store(std::min(largest + largest / 8, max_reserve_points_), std::memory_order_relaxed);
+      }
+
+      /// cap the reservation; a cloud may still grow beyond it
+      void setMaxReserve(std::size_t points)
+      {
+        max_reserve_points_ = points;
+        reserve_points_.store(std::min(reserve_points_.load(std::memory_order_relaxed), max_reserve_points_),
+                              std::memory_order_relaxed);
+      }
+
+      /// number of points reserved in each cloud handed out
+      std::size_t reservePoints() const { return reserve_points_.load(std::memory_order_relaxed); }
+
+      /// number of clouds kept by the pool
+      std::size_t capacity() const { return state_->capacity; }
+
+      /// memory currently held by the pool and its clouds
+      FramePoolFootprint footprint() const
+      {
+        FramePoolFootprint ret;
+
+        {
+          std::lock_guard<std::mutex> lk(state_->mutex);
+          ret.pooled_clouds = state_->free_list.size();
+          for (auto cloud : state_->free_list)
+            ret.pooled_bytes += cloud->points.capacity() * sizeof(typename CLOUD::PointType);
+        }
+
+        ret.in_use = state_->in_use;
+        ret.high_water_mark = state_->high_water_mark;
+        ret.allocations = state_->allocations;
+        ret.reserve_points = reserve_points_.load(std::memory_order_relaxed);
+        return ret;
+      }
+
+    private:
+      /// state shared with outstanding clouds so they can be released after the pool is gone
+      struct State : public CloudRecycler
+      {
+        ~State()
+        {
+          for (auto cloud : free_list)
+            delete cloud;
+        }
+
+        void recycle(void* released) override
+        {
+          CLOUD* cloud = static_cast<CLOUD*>(released);
+          --in_use;
+
+          {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (free_list.size() < capacity)
+            {
+              free_list.push_back(cloud);
+              cloud = nullptr;
+            }
+          }
+
+          delete cloud;
+        }
+
+        std::mutex                mutex;
+        std::vector<CLOUD*>       free_list;
+        std::size_t               capacity = 0;
+        std::atomic<std::size_t>  in_use {0};
+        std::atomic<std::size_t>  high_water_mark {0};
+        std::atomic<std::size_t>  allocations {0};
+      };
+
+      std::shared_ptr<State> state_;
+
+      /// sizes of the recent frames; producer thread only
+      std::size_t frame_sizes_[FRAME_POOL_SIZE_HISTORY] = {};
+      std::size_t frame_index_ = 0;
+
+      /// points reserved in each cloud handed out; 0 until a frame is seen, so the first clouds
+      /// grow as points are added; atomic so footprint can be read from other threads
+      std::atomic<std::size_t> reserve_points_ {0};
+      std::size_t max_reserve_points_ = static_cast<std::size_t>(-1);
+    };
+
+  } // namespace common
+
+} // namespace quanergy
+
+#endif
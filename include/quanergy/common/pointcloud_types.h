@@ -21,6 +21,8 @@
 
 #include <quanergy/common/point_xyzir.h>
 #include <quanergy/common/point_hvdir.h>
+// clouds carry the arrival time of their data
+#include <quanergy/common/arrival_time.h>
 
 namespace quanergy 
 {
@@ -0,0 +1,40 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file range_list.h
+ *
+ *  \brief Provide parsing of comma separated lists of values and ranges such as "2,4-6"
+ */
+
+#ifndef QUANERGY_COMMON_RANGE_LIST_H
+#define QUANERGY_COMMON_RANGE_LIST_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace common
+  {
+    /** \brief split a comma separated list into begin-end pairs; a single value is both
+     *  \details Items are trimmed and empty items skipped. Values must be non-negative
+     *           integers; the order of begin and end is left to the caller to check.
+     *  \param need_end requires every item to be a range
+     *  \param error is the message of the std::invalid_argument thrown for a malformed item
+     */
+    DLLEXPORT std::vector<std::pair<int, int>> rangesFromString(const std::string& list,
+                                                                bool need_end,
+                                                                const char* error);
+
+  } // namespace common
+
+} // namespace quanergy
+
+#endif
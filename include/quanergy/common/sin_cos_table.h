@@ -0,0 +1,90 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file sin_cos_table.h
+ *
+ *  \brief Provide sine and cosine from a table shared by all conversions
+ */
+
+#ifndef QUANERGY_COMMON_SIN_COS_TABLE_H
+#define QUANERGY_COMMON_SIN_COS_TABLE_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace common
+  {
+    /** \brief SinCosTable holds the sine and cosine of angles on the M-series encoder grid
+     *  \details Angles on the grid, which includes the horizontal angles of M-series firings,
+     *           are looked up directly. Angles off the grid, such as laser elevations, are
+     *           corrected from the nearest entry to second order; with the grid spacing of
+     *           2*pi/10400 the result is within 1E-11 of std::sin and std::cos. The table is
+     *           built on first use and never changes, so it is safe to share between threads.
+     */
+    class DLLEXPORT SinCosTable
+    {
+    public:
+      /// number of entries per revolution; the M-series encoder counts per revolution
+      static constexpr std::int32_t STEPS = 10400;
+
+      /// the table shared by all users
+      static const SinCosTable& instance();
+
+      /// sine and cosine of angle in radians; NaN if angle is not finite
+      void sinCos(double angle, double& sin, double& cos) const
+      {
+        if (!(angle > -LIMIT && angle < LIMIT))
+        {
+          sin = cos = std::numeric_limits<double>::quiet_NaN();
+          return;
+        }
+
+        // nearest entry, rounding half away from zero without a library call
+        double steps = angle * STEPS_PER_RADIAN;
+        std::int64_t k = static_cast<std::int64_t>(steps < 0. ? steps - 0.5 : steps + 0.5);
+        double r = angle - static_cast<double>(k) * RADIANS_PER_STEP;
+
+        std::int64_t index = k % STEPS;
+        if (index < 0)
+          index += STEPS;
+
+        const Entry& entry = table_[static_cast<std::size_t>(index)];
+
+        // sin(a + r) and cos(a + r) for |r| <= pi/STEPS
+        double scale = 1. - 0.5 * r * r;
+        sin = entry.sin * scale + entry.cos * r;
+        cos = entry.cos * scale - entry.sin * r;
+      }
+
+    private:
+      SinCosTable();
+
+      struct Entry
+      {
+        double sin;
+        double cos;
+      };
+
+      static constexpr double RADIANS_PER_STEP = 2. * M_PI / STEPS;
+      static constexpr double STEPS_PER_RADIAN = STEPS / (2. * M_PI);
+      /// magnitude beyond which angles are not reduced
+      static constexpr double LIMIT = 1E9;
+
+      std::vector<Entry> table_;
+    };
+
+  } // namespace common
+
+} // namespace quanergy
+
+#endif
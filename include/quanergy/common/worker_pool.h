@@ -0,0 +1,92 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file worker_pool.h
+ *
+ *  \brief Provide a fixed set of threads for splitting a loop across cores
+ */
+
+#ifndef QUANERGY_COMMON_WORKER_POOL_H
+#define QUANERGY_COMMON_WORKER_POOL_H
+
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <vector>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace common
+  {
+    /** \brief WorkerPool runs the iterations of a loop on its threads and the calling thread
+     *  \details The threads are started once and wait between loops, so a loop costs a wake up
+     *           rather than a thread start. Iterations are handed out one at a time in order;
+     *           which thread runs an iteration, and when, is not defined. One loop runs at a time.
+     */
+    class DLLEXPORT WorkerPool
+    {
+    public:
+      /** \brief Constructor
+       *  \param threads is the number of threads to start in addition to the calling thread
+       */
+      explicit WorkerPool(std::size_t threads);
+
+      /// stops and joins the threads
+      ~WorkerPool();
+
+      // noncopyable
+      WorkerPool(const WorkerPool&) = delete;
+      WorkerPool& operator=(const WorkerPool&) = delete;
+
+      /// number of threads started by the pool; the calling thread takes part as well
+      std::size_t size() const { return threads_.size(); }
+
+      /** \brief call task for each index in [0, count) and return once all calls have finished
+       *  \throws the first exception thrown by task, after the remaining iterations ran
+       */
+      void run(std::size_t count, const std::function<void (std::size_t)>& task);
+
+    private:
+      /// wait for loops and take part in them until stopped
+      void work();
+
+      /// run iterations of the current loop until none are left
+      void runIterations();
+
+      std::vector<std::thread> threads_;
+
+      std::mutex mutex_;
+      /// wakes the threads for a loop or to stop
+      std::condition_variable start_condition_;
+      /// wakes run once the last thread is done with the loop
+      std::condition_variable done_condition_;
+
+      /// current loop; read by the threads once woken for its generation
+      const std::function<void (std::size_t)>* task_ = nullptr;
+      std::size_t count_ = 0;
+      std::uint64_t generation_ = 0;
+      bool stop_ = false;
+
+      /// next iteration to hand out
+      std::atomic<std::size_t> next_ {0};
+      /// threads still working on the current loop
+      std::size_t busy_ = 0;
+      /// first exception thrown by the current loop
+      std::exception_ptr error_;
+    };
+
+  } // namespace common
+
+} // namespace quanergy
+
+#endif
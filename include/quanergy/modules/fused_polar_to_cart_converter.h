@@ -0,0 +1,105 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file fused_polar_to_cart_converter.h
+ *
+ *  \brief Converts point clouds from HVDIR to XYZIR while applying encoder
+ *  correction, distance filtering and ring intensity filtering in the same pass.
+ */
+
+#ifndef QUANERGY_MODULES_FUSED_POLAR_TO_CART_CONVERTER_H
+#define QUANERGY_MODULES_FUSED_POLAR_TO_CART_CONVERTER_H
+
+#include <memory>
+#include <cstdint>
+
+#include <boost/signals2.hpp>
+
+#include <pcl/point_cloud.h>
+
+#include <quanergy/common/point_hvdir.h>
+
+#include <quanergy/common/pointcloud_types.h>
+
+#include <quanergy/common/frame_pool.h>
+
+#include <quanergy/common/sin_cos_table.h>
+
+// For M_SERIES_NUM_LASERS
+#include <quanergy/client/m_series_data_packet.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /** \brief FusedPolarToCartConverter does the work of EncoderAngleCalibration (with known
+     *         parameters), DistanceFilter, RingIntensityFilter and PolarToCartConverter in one pass
+     *  \details Each input cloud is read once and written once to an XYZIR cloud from a pool,
+     *           without the intermediate HVDIR clouds of the separate modules. The input cloud is
+     *           not modified. Defaults change nothing but the conversion; the ring filter, like
+     *           RingIntensityFilter, only applies to the M-series rings.
+     */
+    struct DLLEXPORT FusedPolarToCartConverter
+    {
+      typedef std::shared_ptr<FusedPolarToCartConverter> Ptr;
+
+      typedef PointCloudXYZIRPtr ResultType;
+
+      typedef boost::signals2::signal<void (const ResultType&)> Signal;
+
+      FusedPolarToCartConverter();
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
+
+      void slot(PointCloudHVDIRConstPtr const &);
+
+      /** \brief set the encoder correction as EncoderAngleCalibration::setParams does; 0 amplitude for none
+       *  \throws std::invalid_argument if amplitude or phase is out of [-2PI, 2PI]
+       */
+      void setEncoderParams(double amplitude, double phase);
+
+      void setMaximumDistanceThreshold(float maxThreshold);
+      float getMaximumDistanceThreshold() const { return max_distance_threshold_; }
+
+      void setMinimumDistanceThreshold(float minThreshold);
+      float getMinimumDistanceThreshold() const { return min_distance_threshold_; }
+
+      /** \brief For ring filtering: Set the minimum range filter threshold for the given beam, in meters */
+      void setRingFilterMinimumRangeThreshold(const std::uint16_t laser_beam, const float min_threshold);
+
+      /** \brief For ring filtering: Set the minimum intensity filter threshold for the given beam */
+      void setRingFilterMinimumIntensityThreshold(const std::uint16_t laser_beam, const std::uint8_t min_threshold);
+
+      /// memory held by the clouds recycled for this converter
+      common::FramePoolFootprint getFramePoolFootprint() const { return frame_pool_.footprint(); }
+
+    private:
+
+      Signal signal_;
+
+      /// encoder correction; amplitude 0 for none
+      double amplitude_ = 0.;
+      double phase_ = 0.;
+
+      float max_distance_threshold_;
+      float min_distance_threshold_ = 0.f;
+
+      float ring_filter_range_[M_SERIES_NUM_LASERS];
+      std::uint8_t ring_filter_intensity_[M_SERIES_NUM_LASERS];
+
+      /// recycles output clouds once downstream releases them
+      common::FramePool<PointCloudXYZIR> frame_pool_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+
+#endif
@@ -24,6 +24,8 @@
 
 #include <quanergy/common/pointcloud_types.h>
 
+#include <quanergy/common/sin_cos_table.h>
+
 #include <quanergy/common/dll_export.h>
 
 namespace quanergy
@@ -44,7 +46,9 @@ namespace quanergy
 
     private:
 
-      static PointCloudXYZIR::PointType polarToCart(PointCloudHVDIR::PointType const & from);
+      /// trig comes from the shared table; the angles of M-series points are on or near its grid
+      static PointCloudXYZIR::PointType polarToCart(PointCloudHVDIR::PointType const & from,
+                                                    common::SinCosTable const & table);
 
       Signal signal_;
     };
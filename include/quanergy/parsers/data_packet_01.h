@@ -80,29 +80,66 @@ namespace quanergy
       object.reserved          = deserialize(network_order.reserved);
     }
 
-    inline DLLEXPORT void deserialize(const char* network_buffer, DataPacket01& object)
+    /** \brief data packet 0x01 read in place from the network buffer
+     *  \details The headers are deserialized on construction; points are deserialized when
+     *           accessed. The view does not own the buffer, which must outlive it.
+     */
+    class DLLEXPORT DataPacket01View
     {
-      deserialize(network_buffer, object.packet_header);
-      network_buffer += sizeof(PacketHeader);
-      deserialize(network_buffer, object.data_header);
-      network_buffer += sizeof(DataHeader01);
-
-      if (object.packet_header.size != sizeof(PacketHeader) +
-          sizeof(DataHeader01) +
-          object.data_header.point_count * sizeof(DataPoint01))
+    public:
+      /// \throws SizeMismatchError if the packet size doesn't match the point count
+      explicit DataPacket01View(const char* network_buffer)
+      {
+        deserialize(network_buffer, packet_header_);
+        network_buffer += sizeof(PacketHeader);
+        deserialize(network_buffer, data_header_);
+        network_buffer += sizeof(DataHeader01);
+
+        if (packet_header_.size != sizeof(PacketHeader) +
+            sizeof(DataHeader01) +
+            data_header_.point_count * sizeof(DataPoint01))
+        {
+          std::cerr << "Invalid sizes: " << data_header_.point_count
+                    << " points and " << packet_header_.size << " bytes" << std::endl;
+          throw SizeMismatchError();
+        }
+
+        points_ = network_buffer;
+      }
+
+      const PacketHeader& packetHeader() const { return packet_header_; }
+
+      const DataHeader01& dataHeader() const { return data_header_; }
+
+      /// number of points in the packet
+      std::uint32_t size() const { return data_header_.point_count; }
+
+      /// point at index, deserialized
+      DataPoint01 operator[](std::size_t index) const
       {
-        std::cerr << "Invalid sizes: " << object.data_header.point_count
-                  << " points and " << object.packet_header.size << " bytes" << std::endl;
-        throw SizeMismatchError();
+        DataPoint01 ret;
+        deserialize(points_ + index * sizeof(DataPoint01), ret);
+        return ret;
       }
 
-      object.data_points.resize(object.data_header.point_count);
-      std::for_each(object.data_points.begin(), object.data_points.end(),
-                    [&network_buffer](DataPoint01& point)
-                    {
-                      deserialize(network_buffer, point);
-                      network_buffer += sizeof(DataPoint01);
-                    });
+    private:
+      PacketHeader packet_header_;
+      DataHeader01 data_header_;
+      /// first point, in network order
+      const char* points_;
+    };
+
+    inline DLLEXPORT void deserialize(const char* network_buffer, DataPacket01& object)
+    {
+      DataPacket01View view(network_buffer);
+      object.packet_header = view.packetHeader();
+      object.data_header = view.dataHeader();
+
+      object.data_points.resize(view.size());
+      for (std::uint32_t i = 0; i < view.size(); ++i)
+      {
+        object.data_points[i] = view[i];
+      }
     }
 
   } // namespace client
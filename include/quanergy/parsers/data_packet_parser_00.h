@@ -30,9 +30,37 @@ namespace quanergy
     {
       DataPacketParser00() = default;
 
+      /// type and version of the packets this parser handles
+      static constexpr PacketKey packetKey() { return makePacketKey(0x00, 0x00, 0x01, 0x00); }
+
       virtual bool validate(const std::vector<char>& packet) override;
 
       virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result) override;
+
+      /// decode the firings of a packet for parsePrepared
+      virtual void prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared) override;
+
+    private:
+      /// parse and prepare with the return selection as RETURN, a return index or ALL_RETURNS
+      template <int RETURN>
+      bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result);
+
+      template <int RETURN>
+      void prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared);
+
+      /// fill in what the packet starts with; false if it has an error to throw, so its firings aren't decoded
+      bool decodeStart(const DataPacket00& data_packet, PacketStart& start) const;
+
+      /// decode the firings of a packet to target, a CloudTarget or a DecodedTarget
+      template <int RETURN, typename TARGET>
+      void decodeFirings(const MSeriesDataPacket& data_body, TARGET& target) const;
+
+      /// timestamp of the last firing in the packet in microseconds
+      static std::uint64_t packetStamp(const DataPacket00& data_packet);
+
+      /// decode every distinct return of a firing with hvdir.h set, skipping the ones without a range
+      void decodeAllReturns(const MSeriesFiringData& firing, double distance_scaling,
+                            PointCloudHVDIR::PointType hvdir, PointCloudHVDIR::VectorType& points) const;
     };
 
   } // namespace client
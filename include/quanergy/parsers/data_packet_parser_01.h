@@ -14,6 +14,7 @@
 #define QUANERGY_PARSERS_DATA_PACKET_PARSER_01_H
 
 #include <limits>
+#include <vector>
 
 #include <quanergy/parsers/data_packet_parser.h>
 
@@ -29,9 +30,37 @@ namespace quanergy
     {
       DataPacketParser01();
 
+      /// type and version of the packets this parser handles
+      static constexpr PacketKey packetKey() { return makePacketKey(0x01, 0x00, 0x01, 0x00); }
+
       virtual bool validate(const std::vector<char>& packet);
 
       virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result);
+
+    protected:
+      /// ring number of the points at a vertical angle within one packet
+      struct RingAngle
+      {
+        float angle;
+        int ring;
+        /// packet_count_ of the packet the ring was assigned in
+        std::uint32_t packet;
+      };
+
+      /** \brief ring of a vertical angle in the packet being parsed
+       *  \details Rings are numbered per packet in the order their vertical angles first appear;
+       *           an angle within RING_VERTICAL_ANGLE_RESOLUTION of one already seen shares its ring.
+       */
+      int ring(std::int16_t vertical_angle, int& ring_count);
+
+      /// index into ring_angles_ plus one for each vertical angle; 0 for angles not seen yet
+      std::vector<std::uint32_t> ring_angle_index_;
+      /// every vertical angle seen, kept across packets
+      std::vector<RingAngle> ring_angles_;
+      /// ring_angles_ indices seen in the current packet, sorted by angle
+      std::vector<std::uint32_t> packet_ring_angles_;
+      /// number of packets parsed, identifies the current packet
+      std::uint32_t packet_count_ = 0;
     };
 
   } // namespace client
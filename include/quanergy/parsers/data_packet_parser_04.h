@@ -31,10 +31,24 @@ namespace quanergy
       // Constructor
       DataPacketParser04() = default;
 
+      /// type and version of the packets this parser handles
+      static constexpr PacketKey packetKey() { return makePacketKey(0x04, 0x00, 0x01, 0x00); }
+
       virtual bool validate(const std::vector<char>& packet) override;
-  
+
       virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result) override;
 
+      /// decode the firings of a packet for parsePrepared
+      virtual void prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared) override;
+
+    private:
+      /// fill in what the packet starts with; false if it has an error to throw, so its firings aren't decoded
+      bool decodeStart(const DataPacket04& data_packet, PacketStart& start) const;
+
+      /// decode the firings of a packet to target, a CloudTarget or a DecodedTarget
+      template <typename TARGET>
+      void decodeFirings(const DataPacket04& data_packet, TARGET& target) const;
+
     };
 
   } // namespace client
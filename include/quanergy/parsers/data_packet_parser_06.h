@@ -14,6 +14,9 @@
 #ifndef QUANERGY_CLIENT_PARSERS_DATA_PACKET_PARSER_06_H
 #define QUANERGY_CLIENT_PARSERS_DATA_PACKET_PARSER_06_H
 
+#include <cstring>
+#include <algorithm>
+
 #include <quanergy/parsers/packet_parser.h>
 
 #include <quanergy/parsers/data_packet_06.h>
@@ -31,150 +34,379 @@ namespace quanergy
       // Constructor
       DataPacketParser06() = default;
 
+      /// type and version of the packets this parser handles
+      static constexpr PacketKey packetKey() { return makePacketKey(0x06, 0x00, 0x01, 0x00); }
+
       virtual bool validate(const std::vector<char>& packet) override;
-  
+
       virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result) override;
 
+      /// decode the firings of a packet for parsePrepared
+      virtual void prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared) override;
+
     private:
       // templated parse method for M1 (only valid for 1 or 3 returns)
-      template<std::uint8_t R>
+      template<std::uint8_t R, int RETURN>
       inline typename std::enable_if<R == 1 || R == 3, bool>::type parse(
                         const std::vector<char>& packet, PointCloudHVDIRPtr& result)
       {
-        // deserialize
-        DataPacket06<R> data_packet;
-        deserialize(packet.data(), data_packet);
+        const DataPacket06<R>& data_packet = *reinterpret_cast<const DataPacket06<R>*>(packet.data());
+
+        // throws error if status is fatal or the packet can't be parsed
+        PacketStart start;
+        decodeStart(data_packet, start);
+        startPacket(start);
+
+        float azimuth[M_SERIES_FIRING_PER_PKT];
+        std::uint32_t region[DECODE_GROUPS];
+        const int firings_in_region = firingsInRegion(data_packet, azimuth, region);
+
+        // firings outside the region of interest are not decoded
+        DecodedRanges<R, RETURN> decoded_ranges;
+        decodeRanges(data_packet, region, decoded_ranges);
+
+        // most packets fall within a cloud; their firings are written straight into it in one pass
+        const std::size_t most_points = firings_in_region * (decoded_ranges.all_returns ? R : 1);
+        if (firingsWithinCloud(azimuth, M_SERIES_FIRING_PER_PKT, most_points))
+        {
+          auto& points = current_cloud_->points;
+          const std::size_t size = points.size();
+          points.resize(size + most_points);
+
+          PointCloudHVDIR::PointType* point = points.data() + size;
+          bool firings_are_dense = true;
+          const int firings = writeFirings(data_packet, azimuth, region, firings_in_region, decoded_ranges,
+                                           point, firings_are_dense);
+
+          points.resize(point - points.data());
+          addFirings(firings, firings_are_dense, azimuth[M_SERIES_FIRING_PER_PKT - 1]);
+
+          return false;
+        }
 
-        // parse
         bool result_updated = false;
 
-        // throws error if status is fatal
-        validateStatus(static_cast<StatusType>(data_packet.data_header.status));
+        // for each firing
+        for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
+        {
+          // check whether cloud is complete; the firing goes into the cloud after that
+          bool complete = checkComplete(azimuth[firing_index], result);
+
+          // add the decoded firing straight into the cloud under construction, if it is in the region of interest
+          if (!(region[firing_index / FIRING_DECODER_LANES] & (1u << (firing_index % FIRING_DECODER_LANES))))
+          {
+            skipFiring();
+          }
+          else if (!currentCloudFull())
+          {
+            auto& points = current_cloud_->points;
+            const std::size_t first_point = points.size();
+            points.resize(first_point + (decoded_ranges.all_returns ? R : 1));
+
+            PointCloudHVDIR::PointType* point = points.data() + first_point;
+            bool firing_is_dense = firingPoints(data_packet.data.firings[firing_index], firing_index,
+                                                azimuth[firing_index], decoded_ranges, point);
+            points.resize(point - points.data());
+
+            // add firing to scan
+            addFiring(first_point, firing_is_dense);
+          }
+
+          // with height of 1, there is no need to organize
+
+          result_updated = result_updated || complete;
+
+        } // for firing index
+
+        return result_updated;
+
+      } // parse
+
+      // templated prepare method for M1 (only valid for 1 or 3 returns)
+      template<std::uint8_t R, int RETURN>
+      inline typename std::enable_if<R == 1 || R == 3>::type prepare(
+                        const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared)
+      {
+        const DataPacket06<R>& data_packet = *reinterpret_cast<const DataPacket06<R>*>(packet.data());
+        DecodedPacket& decoded = decodedPacket(prepared);
+
+        if (!decodeStart(data_packet, decoded))
+          return;
+
+        std::uint32_t region[DECODE_GROUPS];
+        const int firings_in_region = firingsInRegion(data_packet, decoded.azimuth, region);
+
+        DecodedRanges<R, RETURN> decoded_ranges;
+        decodeRanges(data_packet, region, decoded_ranges);
+
+        // the cloud a firing goes into isn't known until parsePrepared, so the points are kept here until
+        // then; written the way parse writes them and trimmed after
+        auto& points = decoded.points;
+        points.resize(firings_in_region * (decoded_ranges.all_returns ? R : 1));
+
+        PointCloudHVDIR::PointType* point = points.data();
+        bool firings_are_dense = true;
+        writeFirings(data_packet, decoded.azimuth, region, firings_in_region, decoded_ranges,
+                     point, firings_are_dense);
+        points.resize(point - points.data());
+
+        // where the points of each firing went follows from which of its returns were kept
+        for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
+        {
+          const int group = firing_index / FIRING_DECODER_LANES;
+          const std::uint32_t lane = 1u << (firing_index % FIRING_DECODER_LANES);
+
+          int firing_points = 0;
+          decoded.skipped[firing_index] = !(region[group] & lane);
+          if (decoded_ranges.all_returns)
+          {
+            for (int return_index = 0; return_index < R; ++return_index)
+              firing_points += (decoded_ranges.keep[return_index][group] & lane) != 0;
+
+            decoded.dense[firing_index] = true;
+          }
+          else
+          {
+            firing_points = decoded.skipped[firing_index] ? 0 : 1;
+            decoded.dense[firing_index] = decoded.skipped[firing_index] ||
+              (decoded_ranges.keep[decoded_ranges.single_return][group] & lane);
+          }
+
+          decoded.first_point[firing_index + 1] =
+            static_cast<std::uint16_t>(decoded.first_point[firing_index] + firing_points);
+        }
+      } // prepare
+
+      // fill in what the packet starts with; false if it has an error to throw, so its firings aren't decoded
+      template<std::uint8_t R>
+      bool decodeStart(const DataPacket06<R>& data_packet, PacketStart& start) const
+      {
+        start.status = static_cast<StatusType>(deserialize(data_packet.data_header.status));
 
         // If the return selection has been explicitly set,
         // verify that the return ID matches what has been requested
         if (R == 1 && return_selection_set_ &&
             data_packet.data_header.return_id != return_selection_)
         {
-          throw ReturnIDMismatchError();
+          start.error = std::make_exception_ptr(ReturnIDMismatchError());
+          return false;
         }
 
         // this time is used for the cloud stamp which is a 64 bit integer in units of microseconds
-        std::uint64_t current_packet_stamp_ms =
-          static_cast<std::uint64_t>(data_packet.packet_header.seconds) * 1000000ull +
-          static_cast<std::uint64_t>(data_packet.packet_header.nanoseconds) / 1000ull;
+        start.packet_stamp_ms =
+          static_cast<std::uint64_t>(deserialize(data_packet.packet_header.seconds)) * 1000000ull +
+          static_cast<std::uint64_t>(deserialize(data_packet.packet_header.nanoseconds)) / 1000ull;
+        start.start_pos = deserialize(data_packet.data.firings[0].position);
+        start.mid_pos   = deserialize(data_packet.data.firings[M_SERIES_FIRING_PER_PKT/2].position);
+        start.end_pos   = deserialize(data_packet.data.firings[M_SERIES_FIRING_PER_PKT-1].position);
+
+        return true;
+      }
+
+      /// M1 has a single laser so the decoder runs across firings, in groups of lanes
+      static const int DECODE_GROUPS = (M_SERIES_FIRING_PER_PKT + FIRING_DECODER_LANES - 1) / FIRING_DECODER_LANES;
+
+      /// ranges of the returns of all firings in a packet and which ones to keep
+      template<std::uint8_t R, int RETURN>
+      struct DecodedRanges
+      {
+        static_assert((RETURN == ALL_RETURNS) ? (R == M_SERIES_NUM_RETURNS) : (RETURN >= 0 && RETURN < R),
+                      "return to keep must be in the packet");
 
-        const auto& start = data_packet.data.firings[0].position;
-        const auto& mid   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT/2].position;
-        const auto& end   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT-1].position;
-        registerNewPacket(current_packet_stamp_ms, start, mid, end);
+        // for the all case, we won't keep NaN points and we'll compare
+        // distances to illiminate duplicates; otherwise there is one return to decode
+        static constexpr bool all_returns = (RETURN == ALL_RETURNS);
+        static constexpr int single_return = all_returns ? 0 : RETURN;
 
-        // Tens of micrometers.
-        double distance_scaling = 0.00001;
+        float ranges[R][DECODE_GROUPS * FIRING_DECODER_LANES];
+        std::uint32_t keep[R][DECODE_GROUPS];
+      };
 
-        // for each firing
+      // horizontal angle of each firing in a packet, and a lane per firing in the region of interest
+      // for each decode group; returns the number of firings in the region
+      template<std::uint8_t R>
+      int firingsInRegion(const DataPacket06<R>& data_packet, float* azimuth, std::uint32_t* region) const
+      {
+        const double* horizontal_angles = horizontal_angle_lookup_table_.data();
         for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
         {
-          M1FiringData<R> const & firing = data_packet.data.firings[firing_index];
-          firing_cloud_->clear();
-          firing_cloud_->is_dense = true;
-          PointCloudHVDIR::PointType hvdir;
+          azimuth[firing_index] = horizontal_angles[deserialize(data_packet.data.firings[firing_index].position)];
+        }
+
+        if (!hasRegionOfInterest())
+        {
+          for (int group = 0; group < DECODE_GROUPS; ++group)
+          {
+            const int lanes = std::min(FIRING_DECODER_LANES, M_SERIES_FIRING_PER_PKT - group * FIRING_DECODER_LANES);
+            region[group] = (1u << lanes) - 1;
+          }
+
+          return M_SERIES_FIRING_PER_PKT;
+        }
 
-          // populate firing cloud
-          hvdir.h = horizontal_angle_lookup_table_[firing.position];
-          hvdir.v = 0.;
-          hvdir.ring = 0;
+        std::fill(region, region + DECODE_GROUPS, 0u);
 
-          if (R == M_SERIES_NUM_RETURNS && return_selection_ == quanergy::client::ALL_RETURNS)
+        // M1 has ring 0 only; without it, no firing is in the region
+        if (!(ring_mask_ & 1u))
+          return 0;
+
+        int firings = 0;
+        for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
+        {
+          if (firingInRegion(deserialize(data_packet.data.firings[firing_index].position)))
           {
-            // for the all case, we won't keep NaN points and we'll compare
-            // distances to illiminate duplicates
-            // index 2 could equal index 0 and/or index 1
-            // index 1 could equal index 0 but only if all 3 are equal so don't need to check that as separate case
-            std::uint32_t dist2 = firing.radius[2];
-
-            std::uint32_t dist0 = firing.radius[0];
-            if (dist0 != 0 && dist0 != dist2)
-            {
-              hvdir.intensity = firing.intensity[0];
-              hvdir.d = static_cast<float>(dist0) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
+            region[firing_index / FIRING_DECODER_LANES] |= 1u << (firing_index % FIRING_DECODER_LANES);
+            ++firings;
+          }
+        }
 
-            std::uint32_t dist1 = firing.radius[1];
-            if (dist1 != 0 && dist1 != dist2)
-            {
-              hvdir.intensity = firing.intensity[1];
-              hvdir.d = static_cast<float>(dist1) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
+        return firings;
+      }
 
-            if (dist2 != 0)
-            {
-              hvdir.intensity = firing.intensity[2];
-              hvdir.d = static_cast<float>(dist2) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
+      // decode the ranges of the returns selected for the firings of a packet in the region;
+      // nothing is kept outside it and groups without firings in it are not decoded at all
+      template<std::uint8_t R, int RETURN>
+      void decodeRanges(const DataPacket06<R>& data_packet, const std::uint32_t* region,
+                        DecodedRanges<R, RETURN>& decoded) const
+      {
+        // Tens of micrometers.
+        double distance_scaling = 0.00001;
+
+        // a packet outside the region altogether has nothing to decode
+        std::uint32_t any_lanes = 0;
+        for (int group = 0; group < DECODE_GROUPS; ++group)
+          any_lanes |= region[group];
+
+        if (any_lanes == 0)
+        {
+          std::memset(decoded.keep, 0, sizeof(decoded.keep));
+          return;
+        }
 
-          } // if (R == M_SERIES_NUM_RETURNS && return_selection_ == quanergy::client::ALL_RETURNS)
-          else if(R == M_SERIES_NUM_RETURNS)
+        // stage each return contiguously
+        std::uint32_t radii[R][DECODE_GROUPS * FIRING_DECODER_LANES];
+
+        for (int return_index = 0; return_index < R; ++return_index)
+        {
+          if (!decoded.all_returns && return_index != decoded.single_return)
+            continue;
+
+          std::memset(radii[return_index], 0, sizeof(radii[return_index]));
+          for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
           {
-            // We only want 1 return, find the correct one
-            hvdir.intensity = firing.intensity[return_selection_];
+            std::memcpy(&radii[return_index][firing_index],
+                        &data_packet.data.firings[firing_index].radius[return_index], sizeof(std::uint32_t));
+          }
 
-            if (firing.radius[return_selection_] == 0)
-            {
-              hvdir.d = std::numeric_limits<float>::quiet_NaN();
-              // if the range is NaN, the cloud is not dense
-              firing_cloud_->is_dense = false;
-            }
-            else
-            {
-              hvdir.d = static_cast<float>(firing.radius[return_selection_]) * distance_scaling; // convert range to meters
-            }
+          for (int group = 0; group < DECODE_GROUPS; ++group)
+          {
+            decoded.keep[return_index][group] = (region[group] == 0) ? 0u : region[group] &
+              firing_decoder_.decode(&radii[return_index][group * FIRING_DECODER_LANES], distance_scaling,
+                                     &decoded.ranges[return_index][group * FIRING_DECODER_LANES]);
+          }
+        }
 
-            // add the point to the current firing
-            firing_cloud_->push_back(hvdir);
+        if (decoded.all_returns)
+        {
+          // index 2 could equal index 0 and/or index 1
+          // index 1 could equal index 0 but only if all 3 are equal so don't need to check that as separate case
+          // (indexed through R so the single return instantiation stays in bounds)
+          for (int group = 0; group < DECODE_GROUPS; ++group)
+          {
+            if (region[group] == 0)
+              continue;
 
-          } // else if (R == M_SERIES_NUM_RETURNS)
-          else
+            const std::size_t offset = group * FIRING_DECODER_LANES;
+            decoded.keep[0][group] &= ~firing_decoder_.equal(&radii[0][offset], &radii[R-1][offset]);
+            decoded.keep[R/2][group] &= ~firing_decoder_.equal(&radii[R/2][offset], &radii[R-1][offset]);
+          }
+        }
+      }
+
+      // write the points of the firings of a packet in the region at point, which is advanced past them;
+      // returns the number of firings as addFirings counts them, and whether they are all dense
+      template<std::uint8_t R, int RETURN>
+      static int writeFirings(const DataPacket06<R>& data_packet, const float* azimuth, const std::uint32_t* region,
+                              int firings_in_region, const DecodedRanges<R, RETURN>& decoded,
+                              PointCloudHVDIR::PointType*& point, bool& firings_are_dense)
+      {
+        if (!decoded.all_returns)
+        {
+          // a point per firing in the region; dense if every range is valid
+          const int return_index = decoded.single_return;
+          for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
           {
-            // single return case
-            hvdir.intensity = firing.intensity[0];
+            // checked only if some firing is out of the region, so the full packet loop stays tight
+            if (firings_in_region != M_SERIES_FIRING_PER_PKT &&
+                !(region[firing_index / FIRING_DECODER_LANES] & (1u << (firing_index % FIRING_DECODER_LANES))))
+              continue;
 
-            if (firing.radius[0] == 0)
-            {
-              hvdir.d = std::numeric_limits<float>::quiet_NaN();
-              // if the range is NaN, the cloud is not dense
-              firing_cloud_->is_dense = false;
-            }
-            else
-            {
-              hvdir.d = static_cast<float>(firing.radius[0]) * distance_scaling; // convert range to meters
-            }
+            writePoint(azimuth[firing_index], decoded.ranges[return_index][firing_index],
+                       data_packet.data.firings[firing_index].intensity[return_index], point);
+          }
 
-            // add the point to the current firing
-            firing_cloud_->push_back(hvdir);
+          for (int group = 0; group < DECODE_GROUPS; ++group)
+          {
+            firings_are_dense = firings_are_dense && (decoded.keep[return_index][group] & region[group]) == region[group];
+          }
 
-          } // else (R != M_SERIES_NUM_RETURNS)
+          // firings skipped count as well
+          return M_SERIES_FIRING_PER_PKT;
+        }
 
-          // check whether cloud is complete
-          bool complete = checkComplete(hvdir.h, result);
-          // add firing to scan
-          addFiring(firing_cloud_);
+        // the returns kept, which are all valid, so the firings are dense
+        int firings = 0;
+        for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
+        {
+          const PointCloudHVDIR::PointType* first_point = point;
+          firingPoints(data_packet.data.firings[firing_index], firing_index, azimuth[firing_index], decoded, point);
 
-          // with height of 1, there is no need to organize
+          // as addFiring and skipFiring count them; firings outside the region have nothing kept
+          firings += (point != first_point ||
+                      !(region[firing_index / FIRING_DECODER_LANES] & (1u << (firing_index % FIRING_DECODER_LANES))));
+        }
 
-          result_updated = result_updated || complete;
+        return firings;
+      }
 
-        } // for firing index
+      // write the points of a firing at point, which is advanced past them; returns whether the firing is dense
+      template<std::uint8_t R, int RETURN>
+      static bool firingPoints(const M1FiringData<R>& firing, int firing_index, float azimuth,
+                               const DecodedRanges<R, RETURN>& decoded, PointCloudHVDIR::PointType*& point)
+      {
+        const int group = firing_index / FIRING_DECODER_LANES;
+        const std::uint32_t lane = 1u << (firing_index % FIRING_DECODER_LANES);
 
-        return result_updated;
+        if (decoded.all_returns)
+        {
+          for (int return_index = 0; return_index < R; ++return_index)
+          {
+            if (decoded.keep[return_index][group] & lane)
+            {
+              writePoint(azimuth, decoded.ranges[return_index][firing_index], firing.intensity[return_index], point);
+            }
+          }
 
-      } // parse
+          return true;
+        }
+
+        writePoint(azimuth, decoded.ranges[decoded.single_return][firing_index],
+                   firing.intensity[decoded.single_return], point);
+
+        // if the range is NaN, the cloud is not dense
+        return (decoded.keep[decoded.single_return][group] & lane) != 0;
+      }
+
+      // write the single laser point of M1 and advance past it
+      static void writePoint(float azimuth, float range, std::uint8_t intensity, PointCloudHVDIR::PointType*& point)
+      {
+        point->h = azimuth;
+        point->v = 0.;
+        point->d = range;
+        point->intensity = intensity;
+        point->ring = 0;
+        ++point;
+      }
 
     };
 
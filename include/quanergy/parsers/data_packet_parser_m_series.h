@@ -13,10 +13,19 @@
 #ifndef QUANERGY_PARSERS_DATA_PACKET_PARSER_M_H
 #define QUANERGY_PARSERS_DATA_PACKET_PARSER_M_H
 
+#include <exception>
+#include <limits>
+
+#include <boost/signals2.hpp>
+
 #include <quanergy/parsers/data_packet_parser.h>
 
 #include <quanergy/client/m_series_data_packet.h>
 
+#include <quanergy/common/frame_pool.h>
+
+#include <quanergy/parsers/firing_decoder.h>
+
 #include <quanergy/common/dll_export.h>
 
 namespace quanergy
@@ -54,6 +63,21 @@ namespace quanergy
     /** \brief limits cloud size for memory considerations; this is much larger than needed */
     static const std::int32_t MAX_CLOUD_SIZE = 1E6;
 
+    /** \brief row stride of organized clouds before a frame size has been seen */
+    static const std::size_t MIN_ROW_STRIDE = 64;
+
+    /** \brief interval of encoder counts from begin up to, not including, end; wraps past the end of a
+     *         revolution if end is less than begin. Count c is at c*360/M_SERIES_NUM_ROT_ANGLES degrees.
+     */
+    struct AzimuthInterval
+    {
+      std::int32_t begin;
+      std::int32_t end;
+    };
+
+    /** \brief ring mask with every ring set */
+    static const std::uint8_t ALL_RINGS = 0xFF;
+
     /** \brief Not a specialization because it is intended to be used by others. */
     struct DLLEXPORT DataPacketParserMSeries : public DataPacketParser
     {
@@ -65,12 +89,214 @@ namespace quanergy
       
       double getDegreesOfSweepPerCloud() const { return angle_per_cloud_*180./M_PI; }
 
+      /** \brief set the sweep of the sectors emitted while clouds are built; 0 (the default) for none
+       *  \details Each cloud is split into sectors of this sweep counted from where the cloud
+       *           starts, and each sector is emitted on the sector signal as soon as the first
+       *           firing past it arrives, instead of waiting for the whole cloud. The cloud is still
+       *           produced as before; sectors are copied out of it, organized like it. The last
+       *           sector of a cloud may be shorter. As parse hands out a cloud once the packet that
+       *           completed it is parsed, the first sectors of the next cloud may be emitted before
+       *           that. Sectors are emitted even for a cloud that ends up dropped for its size.
+       */
+      void setDegreesOfSweepPerSector(double degrees_per_sector);
+
+      double getDegreesOfSweepPerSector() const { return angle_per_sector_*180./M_PI; }
+
+      /// sector signal type
+      typedef boost::signals2::signal<void (const PointCloudHVDIRPtr&)> SectorSignal;
+
+      /** \brief connect a slot to the signal emitted, during parse, when a sector is complete */
+      boost::signals2::connection connectSector(const SectorSignal::slot_type& subscriber)
+      {
+        return sector_signal_.connect(subscriber);
+      }
+
+      /** \brief set the region of interest; firings and lasers outside it are skipped before they are decoded
+       *  \details Firings outside all of the azimuth intervals add no points, but they still complete
+       *           clouds and sectors and count toward the timestamps as before. Lasers outside the ring
+       *           mask (bit i for ring i) are left out of unorganized clouds and are NaN in organized
+       *           ones, which keep their layout. M1 has ring 0 only. Clouds without points are dropped
+       *           like those below the minimum size. No intervals keeps every azimuth.
+       *  \throws InvalidRegionOfInterest if an interval is outside [0, M_SERIES_NUM_ROT_ANGLES]
+       */
+      void setRegionOfInterest(const std::vector<AzimuthInterval>& azimuth_intervals,
+                               std::uint8_t ring_mask = ALL_RINGS);
+
+      /// whether a region of interest smaller than everything is set
+      bool hasRegionOfInterest() const { return !azimuth_in_region_.empty() || ring_mask_ != ALL_RINGS; }
+
       /// set vertical angles to use for M8/MQ8
       void setVerticalAngles(const std::vector<double>& vertical_angles);
       /// set vertical angles to the default values for the specified sensors
       void setVerticalAngles(SensorType sensor);
 
+      /// select the kernels used to decode radii; throws std::invalid_argument if not supported here
+      void setDecodeInstructionSet(DecodeInstructionSet instruction_set);
+      DecodeInstructionSet getDecodeInstructionSet() const { return firing_decoder_.getInstructionSet(); }
+
+      /// memory held by the clouds recycled for this parser
+      common::FramePoolFootprint getFramePoolFootprint() const { return frame_pool_.footprint(); }
+
+      /// decode the firings of a packet for parsePrepared; each packet type decodes its own
+      virtual void prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared) override = 0;
+
+      /// parse a packet from the firings decoded by prepare if it was this parser that prepared it
+      virtual bool parsePrepared(const std::vector<char>& packet, PreparedPacket* prepared,
+                                 PointCloudHVDIRPtr& result) override;
+
     protected:
+      /** \brief what a packet starts with, checked and registered before its firings are added */
+      struct PacketStart
+      {
+        /// status to validate
+        StatusType status = StatusType::GOOD;
+        /// thrown after the status is validated; null if the packet decoded fine
+        std::exception_ptr error;
+
+        /// arguments to registerNewPacket
+        std::uint64_t packet_stamp_ms = 0;
+        int start_pos = 0;
+        int mid_pos = 0;
+        int end_pos = 0;
+      };
+
+      /** \brief the firings of a packet decoded by prepare, ready to be added to clouds in order */
+      struct DecodedPacket : public PreparedPacket, public PacketStart
+      {
+        /// parser that decoded the packet
+        const DataPacketParserMSeries* parser = nullptr;
+
+        /// horizontal angle of each firing
+        float azimuth[M_SERIES_FIRING_PER_PKT];
+        /// whether each firing is dense
+        bool dense[M_SERIES_FIRING_PER_PKT];
+        /// whether each firing was skipped for the region of interest; skipped firings have no points
+        bool skipped[M_SERIES_FIRING_PER_PKT];
+        /// where the points of each firing start; the last entry is the number of points
+        std::uint16_t first_point[M_SERIES_FIRING_PER_PKT + 1];
+        /// whether each firing has a point per laser in laser order, to be placed with addColumn
+        bool organized = false;
+
+        /// points of all firings in firing order
+        PointCloudHVDIR::VectorType points;
+      };
+
+      /// reuse prepared for this parser to decode a packet into; the decoded packet is reset to no firings
+      DecodedPacket& decodedPacket(std::unique_ptr<PreparedPacket>& prepared) const;
+
+      /// add the firings of a decoded packet to the clouds, in order
+      bool parseDecoded(const DecodedPacket& decoded, PointCloudHVDIRPtr& result);
+
+      /** \brief where parse decodes firings to: straight into the cloud under construction
+       *  \details A firing decode routine takes either this or a DecodedTarget, so parse and prepare
+       *           share it. Each firing starts with beginFiring, which says whether to decode it. Its
+       *           points then go to the slots column hands out, a point per laser, or are appended
+       *           to points and accounted for with endFiring.
+       */
+      class CloudTarget
+      {
+      public:
+        CloudTarget(DataPacketParserMSeries& parser, PointCloudHVDIRPtr& result)
+          : parser_(parser)
+          , result_(result)
+        {}
+
+        bool beginFiring(int /*firing_index*/, float azimuth, bool in_region)
+        {
+          // check whether cloud is complete; the firing goes into the cloud after that
+          result_updated_ = parser_.checkComplete(azimuth, result_) || result_updated_;
+
+          if (!in_region)
+          {
+            parser_.skipFiring();
+            return false;
+          }
+
+          return !parser_.currentCloudFull();
+        }
+
+        PointCloudHVDIR::VectorType& points() { return parser_.current_cloud_->points; }
+
+        void endFiring(int /*firing_index*/, std::size_t first_point, bool firing_is_dense)
+        {
+          parser_.addFiring(first_point, firing_is_dense);
+        }
+
+        PointCloudHVDIR::PointType* column(int /*firing_index*/, bool firing_is_dense, std::ptrdiff_t& stride)
+        {
+          const std::size_t column = parser_.addColumn(firing_is_dense);
+          stride = -static_cast<std::ptrdiff_t>(parser_.row_stride_);
+          return &parser_.organizedPoint(column, 0);
+        }
+
+        /// whether a cloud was completed into result
+        bool resultUpdated() const { return result_updated_; }
+
+      private:
+        DataPacketParserMSeries& parser_;
+        PointCloudHVDIRPtr& result_;
+        bool result_updated_ = false;
+      };
+
+      /** \brief where prepare decodes firings to: the points of a DecodedPacket, for parseDecoded */
+      class DecodedTarget
+      {
+      public:
+        explicit DecodedTarget(DecodedPacket& decoded)
+          : decoded_(decoded)
+        {}
+
+        bool beginFiring(int firing_index, float azimuth, bool in_region)
+        {
+          decoded_.azimuth[firing_index] = azimuth;
+          decoded_.skipped[firing_index] = !in_region;
+
+          if (!in_region)
+            endFiring(firing_index, decoded_.points.size(), true);
+
+          return in_region;
+        }
+
+        PointCloudHVDIR::VectorType& points() { return decoded_.points; }
+
+        void endFiring(int firing_index, std::size_t /*first_point*/, bool firing_is_dense)
+        {
+          decoded_.dense[firing_index] = firing_is_dense;
+          decoded_.first_point[firing_index + 1] = static_cast<std::uint16_t>(decoded_.points.size());
+        }
+
+        PointCloudHVDIR::PointType* column(int firing_index, bool firing_is_dense, std::ptrdiff_t& stride)
+        {
+          auto& points = decoded_.points;
+          const std::size_t first_point = points.size();
+          points.resize(first_point + M_SERIES_NUM_LASERS);
+          endFiring(firing_index, first_point, firing_is_dense);
+
+          stride = 1;
+          return &points[first_point];
+        }
+
+      private:
+        DecodedPacket& decoded_;
+      };
+
+      // validate the status, throw the error of the packet if it has one and register it for time and direction
+      void startPacket(const PacketStart& start);
+
+      // write the point of each laser of a firing, with hvdir.h set, to slots stride points apart
+      void writeLasers(PointCloudHVDIR::PointType hvdir, const float* ranges, const std::uint8_t* intensities,
+                       PointCloudHVDIR::PointType* slots, std::ptrdiff_t stride) const
+      {
+        for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; laser_index++)
+        {
+          hvdir.v = vertical_angle_lookup_table_[laser_index];
+          hvdir.ring = laser_index;
+          hvdir.intensity = intensities[laser_index];
+          hvdir.d = ranges[laser_index];
+          slots[laser_index * stride] = hvdir;
+        }
+      }
+
       // validate status and throw error if appropriate, print message if changed
       void validateStatus(const StatusType& status);
 
@@ -80,13 +306,72 @@ namespace quanergy
 
       // check whether the cloud is complete; if so, fill result and return true
       bool checkComplete(const float& azimuth_angle, PointCloudHVDIRPtr& result);
-      
-      // add firing of data
-      void addFiring(const PointCloudHVDIRPtr& firing_cloud);
 
-      // organize current_pc with height specified; throws if size not divisible by height
-      void organizeCloud(PointCloudHVDIRPtr& current_pc,
-        unsigned int height = M_SERIES_NUM_LASERS);
+      // whether firings at these azimuths, adding up to points points in all, would all just go into
+      // the current cloud: none completes it, starts a sector or is dropped for the cloud size
+      bool firingsWithinCloud(const float* azimuth, int count, std::size_t points) const;
+
+      // account for firings decoded straight into the current (unorganized) cloud without checkComplete,
+      // as firingsWithinCloud allows; firings counts those that added points and those skipped
+      void addFirings(int firings, bool firings_are_dense, float last_azimuth);
+
+      // start a new cloud; the pool hands it out empty and assumed dense
+      void startCloud();
+
+      // time of the current firing, interpolated from the previous packet timestamp
+      std::uint64_t currentFiringStamp() const;
+
+      // copy the points added since the last sector to a sector cloud and emit it
+      void emitSector();
+      
+      // number of points added to the current cloud
+      std::size_t currentCloudSize() const
+      {
+        return (row_stride_ != 0) ? columns_ * M_SERIES_NUM_LASERS : current_cloud_->size();
+      }
+
+      // whether the current cloud has reached the maximum size; firings are dropped until it completes
+      bool currentCloudFull() const { return currentCloudSize() >= maximum_cloud_size_; }
+
+      // whether the firing at an encoder position is in the azimuth intervals of the region of interest
+      bool firingInRegion(std::uint16_t position) const
+      {
+        return azimuth_in_region_.empty() || (position < azimuth_in_region_.size() && azimuth_in_region_[position]);
+      }
+
+      // account for a firing skipped for the region of interest; it still counts toward the timestamps
+      void skipFiring() { ++firing_number_; }
+
+      // make the ranges of the lasers outside the ring mask NaN; returns the lanes of decoded that are left
+      std::uint32_t maskRings(std::uint32_t decoded, float* ranges) const
+      {
+        if (ring_mask_ != ALL_RINGS)
+        {
+          for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; ++laser_index)
+          {
+            if (!(ring_mask_ & (1u << laser_index)))
+              ranges[laser_index] = std::numeric_limits<float>::quiet_NaN();
+          }
+        }
+
+        return decoded & ring_mask_;
+      }
+
+      // account for a firing decoded straight into the current (unorganized) cloud from first_point on
+      void addFiring(std::size_t first_point, bool firing_is_dense);
+
+      // add a firing with a point per laser to the current cloud, which makes it organized;
+      // returns the column to place the points in with organizedPoint
+      std::size_t addColumn(bool firing_is_dense);
+
+      // where the point of a laser goes in the current organized cloud; rings are ordered top down
+      PointCloudHVDIR::PointType& organizedPoint(std::size_t column, int laser)
+      {
+        return current_cloud_->points[(M_SERIES_NUM_LASERS - 1 - laser) * row_stride_ + column];
+      }
+
+      // close the row gaps left by the predicted row stride so the organized cloud is dense in memory
+      void compactRows();
 
       /// global cloud counter
       std::uint32_t cloud_counter_ = 0;
@@ -98,12 +383,34 @@ namespace quanergy
       std::uint64_t current_packet_stamp_ms_ = 0;
       std::uint64_t previous_packet_stamp_ms_ = 0;
 
-      /// cloud used for each firing defined here to reduce construct/resize costs
-      PointCloudHVDIRPtr firing_cloud_;
+      /// decodes radii with the best kernels this CPU supports
+      FiringDecoder firing_decoder_;
+
+      /// recycles finished clouds once downstream releases them
+      common::FramePool<PointCloudHVDIR> frame_pool_;
+
       /// cloud that gets built up over time
       PointCloudHVDIRPtr current_cloud_;
-      /// temp cloud for organization used to reduce construct and resize costs
-      PointCloudHVDIRPtr worker_cloud_;
+
+      /// distance between the rows of the current cloud while organized points are placed; 0 if unorganized
+      std::size_t row_stride_ = 0;
+      /// number of columns placed in the current organized cloud
+      std::size_t columns_ = 0;
+
+      /// sector signal; sectors are recycled through their own pool
+      SectorSignal sector_signal_;
+      common::FramePool<PointCloudHVDIR> sector_pool_;
+
+      /// sector sweep; 0 for no sectors
+      double angle_per_sector_ = 0.;
+      /// global sector counter
+      std::uint32_t sector_counter_ = 0;
+      /// sector of the current cloud that firings go to, counting from its start azimuth
+      std::size_t sector_index_ = 0;
+      /// first point, or column if organized, of the current sector
+      std::size_t sector_begin_ = 0;
+      /// whether all firings of the current sector are dense
+      bool sector_is_dense_ = true;
 
       /// lookup table for horizontal angle
       std::vector<double> horizontal_angle_lookup_table_;
@@ -111,6 +418,11 @@ namespace quanergy
       /// lookup table for vertical angle
       std::vector<double> vertical_angle_lookup_table_;
 
+      /// whether each encoder position is in the azimuth intervals of the region of interest; empty for all
+      std::vector<std::uint8_t> azimuth_in_region_;
+      /// rings in the region of interest, a bit each
+      std::uint32_t ring_mask_ = ALL_RINGS;
+
       /// return selection; default to return 0
       int return_selection_ = 0;
       /// whether return selection was explicitly set
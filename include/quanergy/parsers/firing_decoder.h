@@ -0,0 +1,93 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file firing_decoder.h
+ *
+ *  \brief Provide vectorized decoding of the radii in M-series firings
+ */
+
+#ifndef QUANERGY_PARSERS_FIRING_DECODER_H
+#define QUANERGY_PARSERS_FIRING_DECODER_H
+
+#include <cstdint>
+#include <ostream>
+
+#include <quanergy/client/m_series_data_packet.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /// number of radii handled by each decoder call; the lasers of one M-series return
+    const int FIRING_DECODER_LANES = M_SERIES_NUM_LASERS;
+    /// decoder bitmask with every lane set
+    const std::uint32_t FIRING_DECODER_ALL_LANES = (1u << FIRING_DECODER_LANES) - 1;
+
+    /** \brief DecodeInstructionSet selects the kernels a FiringDecoder uses */
+    enum struct DecodeInstructionSet
+    {
+      SCALAR, ///< plain C++; always available
+      SSE4,   ///< SSE4.1 on x86
+      AVX2    ///< AVX2 on x86
+    };
+
+    DLLEXPORT std::ostream& operator<<(std::ostream& os, DecodeInstructionSet instruction_set);
+
+    /** \brief FiringDecoder converts big endian radii from packets to ranges in meters
+     *  \details Each call handles FIRING_DECODER_LANES radii stored back to back, which is one
+     *           return of an M8 firing. A radius of 0 means no return and decodes to NaN. Ranges
+     *           are rounded exactly as the scalar expression static_cast<float>(radius) * scaling
+     *           with a double scaling, so all instruction sets give bit identical results. The
+     *           SIMD kernels are selected at runtime so the library needs no special build flags.
+     */
+    class DLLEXPORT FiringDecoder
+    {
+    public:
+      /// best instruction set supported by both this build and this CPU
+      static DecodeInstructionSet detectInstructionSet();
+
+      /// whether an instruction set can be used with this build and CPU
+      static bool isSupported(DecodeInstructionSet instruction_set);
+
+      /** \brief Constructor
+       *  \throws std::invalid_argument if the instruction set is not supported
+       */
+      explicit FiringDecoder(DecodeInstructionSet instruction_set = detectInstructionSet());
+
+      DecodeInstructionSet getInstructionSet() const { return instruction_set_; }
+
+      /** \brief decode FIRING_DECODER_LANES big endian radii to ranges
+       *  \param radii points at the radii in the packet; no alignment needed
+       *  \param scaling converts radius units to meters
+       *  \return bitmask of the lanes with a return (radius not 0)
+       */
+      std::uint32_t decode(const void* radii, double scaling, float* ranges) const
+      {
+        return decode_(radii, scaling, ranges);
+      }
+
+      /** \brief compare FIRING_DECODER_LANES radii as stored in the packet
+       *  \return bitmask of the lanes where a and b are equal
+       */
+      std::uint32_t equal(const void* a, const void* b) const
+      {
+        return equal_(a, b);
+      }
+
+    private:
+      DecodeInstructionSet instruction_set_;
+      std::uint32_t (*decode_)(const void* radii, double scaling, float* ranges);
+      std::uint32_t (*equal_)(const void* a, const void* b);
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
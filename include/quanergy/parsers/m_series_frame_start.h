@@ -0,0 +1,82 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/**  \file m_series_frame_start.h
+ *
+ *   \brief Provide frame start detection on raw M-series packets for the client queue.
+ */
+
+#ifndef QUANERGY_PARSERS_M_SERIES_FRAME_START_H
+#define QUANERGY_PARSERS_M_SERIES_FRAME_START_H
+
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+#include <quanergy/parsers/data_packet_04.h>
+#include <quanergy/parsers/data_packet_06.h>
+#include <quanergy/parsers/data_packet_parser_m_series.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /** \brief MSeriesFrameStartDetector marks the packet in which a new revolution starts
+     *  \details Compares the encoder position of the first firing in each packet with the previous
+     *           packet, so it works for either spin direction without parsing the packet. Packets
+     *           of other types hold a whole frame each and always start one. Intended for
+     *           TCPClient::setFrameStartDetector with the DROP_WHOLE_FRAME policy; it marks full
+     *           revolutions regardless of the parser's frame size.
+     */
+    struct MSeriesFrameStartDetector
+    {
+      bool operator()(const std::vector<char>& packet)
+      {
+        if (packet.size() < sizeof(PacketHeader))
+          return true;
+
+        const PacketHeader* header = reinterpret_cast<const PacketHeader*>(packet.data());
+
+        // offset of the first firing, whose position comes first
+        std::size_t offset = sizeof(PacketHeader);
+        switch (deserialize(header->packet_type))
+        {
+          case 0x00:
+            break;
+          case 0x04:
+            offset += sizeof(MSeriesDataPacket04Header);
+            break;
+          case 0x06:
+            offset += sizeof(M1DataHeader);
+            break;
+          default:
+            return true;
+        }
+
+        if (packet.size() < offset + sizeof(std::uint16_t))
+          return true;
+
+        std::uint16_t net_position;
+        std::memcpy(&net_position, packet.data() + offset, sizeof(net_position));
+        std::int32_t position = deserialize(net_position);
+
+        // consecutive packets are a small fraction of a revolution apart unless the encoder wrapped
+        bool start = (last_position_ < 0 ||
+                      std::abs(position - last_position_) > M_SERIES_NUM_ROT_ANGLES / 2);
+        last_position_ = position;
+        return start;
+      }
+
+    private:
+      std::int32_t last_position_ = -1;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
@@ -15,15 +15,27 @@
 #define QUANERGY_CLIENT_PACKET_PARSER_H
 
 #include <memory>
+#include <vector>
+#include <cstdint>
 
 #include <boost/signals2.hpp>
 
 #include <quanergy/client/exceptions.h>
+// arrival time of pooled packets
+#include <quanergy/client/packet_buffer_pool.h>
+// decoding batches in parallel
+#include <quanergy/common/worker_pool.h>
 
 namespace quanergy
 {
   namespace client
   {
+    /** \brief work done on a packet ahead of parsing it; see PacketParserBase::prepare */
+    struct PreparedPacket
+    {
+      virtual ~PreparedPacket() {}
+    };
+
     template <class PARSER>
     struct PacketParserModule : public PARSER
     {
@@ -37,21 +49,75 @@ namespace quanergy
         return signal_.connect(subscriber);
       }
 
+      /** \brief set the number of threads decoding the packets of a batch
+       *  \details With more than 1, batchSlot first prepares all packets of a batch on a worker pool
+       *           and then parses them in order on the calling thread, which stitches them into
+       *           results exactly as parsing them one by one would. 1 (the default) parses on the
+       *           calling thread only. slot always parses on the calling thread.
+       */
+      void setDecodeThreads(std::size_t threads)
+      {
+        worker_pool_.reset(threads > 1 ? new common::WorkerPool(threads - 1) : nullptr);
+      }
+
+      std::size_t getDecodeThreads() const { return worker_pool_ ? worker_pool_->size() + 1 : 1; }
+
       void slot(const std::shared_ptr<std::vector<char>>& packet)
       {
         // don't do the work unless someone is listening
         if (signal_.num_slots() == 0)
           return;
 
+        PARSER::setPacketArrivalTime(PacketBufferPool::arrivalTime(packet));
         if (PARSER::validateParse(*packet, result))
           signal_(result);
       }
 
+      /// same as slot for each packet in order, checking for listeners once
+      void batchSlot(const std::vector<std::shared_ptr<std::vector<char>>>& packets)
+      {
+        if (signal_.num_slots() == 0)
+          return;
+
+        if (!worker_pool_ || packets.size() < 2)
+        {
+          for (const auto& packet : packets)
+          {
+            PARSER::setPacketArrivalTime(PacketBufferPool::arrivalTime(packet));
+            if (PARSER::validateParse(*packet, result))
+              signal_(result);
+          }
+
+          return;
+        }
+
+        // decoding doesn't depend on the packets before; only the stitching into results does
+        if (prepared_.size() < packets.size())
+          prepared_.resize(packets.size());
+
+        worker_pool_->run(packets.size(), [this, &packets](std::size_t i)
+        {
+          PARSER::validatePrepare(*packets[i], prepared_[i]);
+        });
+
+        for (std::size_t i = 0; i < packets.size(); ++i)
+        {
+          PARSER::setPacketArrivalTime(PacketBufferPool::arrivalTime(packets[i]));
+          if (PARSER::validateParsePrepared(*packets[i], prepared_[i].get(), result))
+            signal_(result);
+        }
+      }
+
       protected:
         /// Signal that gets fired whenever a result is ready.
         Signal signal_;
         /// result to pass to parse function
         typename PARSER::ResultType result;
+
+        /// threads preparing batches along with the calling thread; null to parse serially
+        std::unique_ptr<common::WorkerPool> worker_pool_;
+        /// work done on the packets of a batch; kept to reuse the memory
+        std::vector<std::unique_ptr<PreparedPacket>> prepared_;
     };
 
     /** \brief base class for packet parsers */
@@ -81,6 +147,57 @@ namespace quanergy
        *          (some parsers may require multiple packets before updating result)
        */
       virtual bool parse(const std::vector<char>& packet, RESULT& result) = 0;
+
+      /** \brief check packet validity and prepare if a match; invalid packets are left for
+       *         validateParsePrepared to reject
+       */
+      inline virtual void validatePrepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared)
+      {
+        if (validate(packet))
+          prepare(packet, prepared);
+      }
+
+      /** \brief do the work on a packet that doesn't depend on the packets before it
+       *  \details This lets a batch of packets be decoded concurrently before they are parsed
+       *           in order with parsePrepared. Calls for different packets may run at the same
+       *           time, so it must not change the parser; it never runs at the same time as
+       *           parse or a setter. The work goes in prepared, which is reused from one packet
+       *           to the next. Errors are not thrown here but when the packet is parsed.
+       *           Parsers that don't split their work leave prepared alone.
+       */
+      virtual void prepare(const std::vector<char>& /*packet*/, std::unique_ptr<PreparedPacket>& /*prepared*/)
+      {
+      }
+
+      /** \brief check packet validity and parse it with the work done by prepare if a match
+       *  \return true if result updated; false otherwise
+       *  \throws InvalidPacketError if not a valid packet
+       */
+      inline virtual bool validateParsePrepared(const std::vector<char>& packet, PreparedPacket* prepared, RESULT& result)
+      {
+        if (validate(packet))
+          return parsePrepared(packet, prepared, result);
+        else
+          throw InvalidPacketError();
+      }
+
+      /** \brief parse packet with the work done by prepare; the same as parse otherwise
+       *  \details prepared may be null or come from another parser, in which case it is ignored
+       */
+      virtual bool parsePrepared(const std::vector<char>& packet, PreparedPacket* /*prepared*/, RESULT& result)
+      {
+        return parse(packet, result);
+      }
+
+      /** \brief set the arrival time of the packets parsed next
+       *  \details Nanoseconds since the epoch on common::arrivalClockNanoseconds; 0 if unknown.
+       *           Parsers pass it on to the results they complete.
+       */
+      virtual void setPacketArrivalTime(std::uint64_t arrival_ns) { packet_arrival_ns_ = arrival_ns; }
+      std::uint64_t getPacketArrivalTime() const { return packet_arrival_ns_; }
+
+    protected:
+      std::uint64_t packet_arrival_ns_ = 0;
     };
 
   } // namespace client
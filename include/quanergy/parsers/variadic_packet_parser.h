@@ -16,13 +16,35 @@
 
 #pragma once
 
+#include <array>
+#include <tuple>
+#include <type_traits>
+
+#include <quanergy/client/packet_header.h>
 #include <quanergy/parsers/packet_parser.h>
 
-/** \brief VariadicPacketParer takes a list of parsers and iterates through them. */
+/** \brief VariadicPacketParer takes a list of parsers and dispatches each packet to the one matching it. */
 namespace quanergy
 {
   namespace client
   {
+    /** \brief ParserPacketKey finds the packet key of a parser with a static packetKey() function
+     *  \details Such parsers are matched on the key alone; others are asked to validate each packet.
+     */
+    template <class PARSER, class = void>
+    struct ParserPacketKey
+    {
+      static constexpr bool keyed = false;
+      static constexpr PacketKey key = 0;
+    };
+
+    template <class PARSER>
+    struct ParserPacketKey<PARSER, decltype(void(PARSER::packetKey()))>
+    {
+      static constexpr bool keyed = true;
+      static constexpr PacketKey key = PARSER::packetKey();
+    };
+
     template <class RESULT, class... PARSERS>
     struct VariadicPacketParser : public PacketParserBase<RESULT>
     {
@@ -37,18 +59,49 @@ namespace quanergy
         return std::get<I>(parsers);
       }
 
-      /** \brief iterate through parsers to find first match and parse */
+      /** \brief find the parser matching the packet and parse */
       inline virtual bool validateParse(const std::vector<char>& packet, RESULT& result)
       {
-        //Start iteration from end of tuple to start (required for VS2013 compatibility)
-        return parse<sizeof...(PARSERS)-1>(packet, result);
+        const std::size_t index = find(packet);
+        if (index == sizeof...(PARSERS))
+          throw InvalidPacketError();
+
+        return dispatch<0>(index, Parse{packet, result});
       }
 
-      /** \brief iterate through parsers to see if there is a match */
+      /** \brief check whether one of the parsers matches the packet */
       inline virtual bool validate(const std::vector<char> &packet)
       {
-        //Start iteration from end of tuple to start (required for VS2013 compatibility)
-        return validate<sizeof...(PARSERS)-1>(packet);
+        return find(packet) != sizeof...(PARSERS);
+      }
+
+      /** \brief find the parser matching the packet and prepare
+       *  \details This runs concurrently for the packets of a batch, so it uses the last match
+       *           without updating it.
+       */
+      inline virtual void validatePrepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared)
+      {
+        bool keyed;
+        const std::size_t index = lookup(packet, keyed);
+        if (index != sizeof...(PARSERS))
+          dispatch<0>(index, Prepare{packet, prepared});
+      }
+
+      /** \brief find the parser matching the packet and parse with the work done by prepare */
+      inline virtual bool validateParsePrepared(const std::vector<char>& packet, PreparedPacket* prepared, RESULT& result)
+      {
+        const std::size_t index = find(packet);
+        if (index == sizeof...(PARSERS))
+          throw InvalidPacketError();
+
+        return dispatch<0>(index, ParsePrepared{packet, prepared, result});
+      }
+
+      /** \brief pass the arrival time on to all parsers */
+      inline virtual void setPacketArrivalTime(std::uint64_t arrival_ns)
+      {
+        PacketParserBase<RESULT>::setPacketArrivalTime(arrival_ns);
+        setPacketArrivalTime<0>(arrival_ns);
       }
 
       /** \brief parse using validateParse but catch throw */
@@ -58,54 +111,155 @@ namespace quanergy
         {
           return validateParse(packet, result);
         }
-        catch (InvalidPacketError())
+        catch (const InvalidPacketError&)
+        {
+          return false;
+        }
+      }
+
+      /** \brief parse using validateParsePrepared but catch throw */
+      inline virtual bool parsePrepared(const std::vector<char>& packet, PreparedPacket* prepared, RESULT& result)
+      {
+        try
+        {
+          return validateParsePrepared(packet, prepared, result);
+        }
+        catch (const InvalidPacketError&)
         {
           return false;
         }
       }
 
     private:
-      /// last attempt to find matching parser at I==0, if it fails throw an excp
-      template<std::size_t I = 0>
-      inline typename std::enable_if<I == 0, bool>::type parse(const std::vector<char>& packet, RESULT& result)
+      /// calls on a parser for dispatch, one for each virtual call forwarded
+      struct Validate
       {
-        if (std::get<I>(parsers).validate(packet))
-          return std::get<I>(parsers).parse(packet, result);
-        else
-          throw InvalidPacketError();
+        typedef bool result_type;
+        const std::vector<char>& packet;
+        template <class PARSER> bool operator()(PARSER& parser) const { return parser.validate(packet); }
+      };
+
+      struct Parse
+      {
+        typedef bool result_type;
+        const std::vector<char>& packet;
+        RESULT& result;
+        template <class PARSER> bool operator()(PARSER& parser) const { return parser.parse(packet, result); }
+      };
+
+      struct Prepare
+      {
+        typedef void result_type;
+        const std::vector<char>& packet;
+        std::unique_ptr<PreparedPacket>& prepared;
+        template <class PARSER> void operator()(PARSER& parser) const { parser.prepare(packet, prepared); }
+      };
+
+      struct ParsePrepared
+      {
+        typedef bool result_type;
+        const std::vector<char>& packet;
+        PreparedPacket* prepared;
+        RESULT& result;
+        template <class PARSER> bool operator()(PARSER& parser) const
+        {
+          return parser.parsePrepared(packet, prepared, result);
+        }
+      };
+
+      /// past the last parser; not reached for an index from lookup
+      template <std::size_t I, class CALL>
+      inline typename std::enable_if<I == sizeof...(PARSERS), typename CALL::result_type>::type
+      dispatch(std::size_t, const CALL&)
+      {
+        return typename CALL::result_type();
       }
 
-      /// find parser and recurse if I != 0
-      template<std::size_t I = 0>
-      inline typename std::enable_if < I != 0, bool>::type parse(const std::vector<char>& packet, RESULT& result)
+      /** \brief make call on parser index, straight to the parser type
+       *  \details Unrolled at compile time into a chain of compares, which the compiler may turn into a
+       *           jump table; with a handful of parsers that beats an indirect call through a table.
+       */
+      template <std::size_t I, class CALL>
+      inline typename std::enable_if<(I < sizeof...(PARSERS)), typename CALL::result_type>::type
+      dispatch(std::size_t index, const CALL& call)
       {
-        if (std::get<I>(parsers).validate(packet))
-          return std::get<I>(parsers).parse(packet, result);
-        else
-          return parse<I - 1>(packet, result);
+        return (index == I) ? call(std::get<I>(parsers)) : dispatch<I + 1>(index, call);
       }
 
-      /// last attempt to find a match at I==0 if it fails return false
-      template<std::size_t I = 0>
-      inline typename std::enable_if<I == 0, bool>::type validate(const std::vector<char>& packet)
+      /// index of the parser matching the packet; sizeof...(PARSERS) if none. Remembers matches made by key.
+      std::size_t find(const std::vector<char>& packet)
       {
-        if (std::get<I>(parsers).validate(packet))
-          return true;
-        else
-          return false;
+        bool keyed;
+        const std::size_t index = lookup(packet, keyed);
+
+        if (keyed)
+        {
+          last_match_valid_ = true;
+          last_match_key_ = makePacketKey(*reinterpret_cast<const PacketHeader*>(packet.data()));
+          last_match_index_ = index;
+        }
+
+        return index;
       }
 
-      /// find parser and recurse if I !=0
-      template<std::size_t I = 0>
-      inline typename std::enable_if < I != 0, bool>::type validate(const std::vector<char>& packet)
+      /** \brief index of the parser matching the packet without remembering the match
+       *  \param keyed is set if the match was made on the packet key alone, so it holds for any packet with the key
+       */
+      std::size_t lookup(const std::vector<char>& packet, bool& keyed)
+      {
+        keyed = false;
+        if (packet.size() < sizeof(PacketHeader))
+          return sizeof...(PARSERS);
+
+        const PacketKey key = makePacketKey(*reinterpret_cast<const PacketHeader*>(packet.data()));
+
+        // a sensor sends the same kind of packet over and over
+        if (last_match_valid_ && key == last_match_key_)
+          return last_match_index_;
+
+        // first match from the end of the tuple, as parsers were always tried in that order; a linear
+        // scan on purpose, as there are only a handful of parsers and the last match catches most packets
+        keyed = true;
+        for (std::size_t i = sizeof...(PARSERS); i-- > 0;)
+        {
+          keyed = keyed && keyed_[i];
+          if (keyed_[i] ? keys_[i] == key : dispatch<0>(i, Validate{packet}))
+            return i;
+        }
+
+        return sizeof...(PARSERS);
+      }
+
+      /// done setting arrival times
+      template<std::size_t I>
+      inline typename std::enable_if<I == sizeof...(PARSERS)>::type setPacketArrivalTime(std::uint64_t)
       {
-        if (std::get<I>(parsers).validate(packet))
-          return true;
-        else
-          return validate<I - 1>(packet);
+      }
+
+      /// set the arrival time on parser I and recurse
+      template<std::size_t I>
+      inline typename std::enable_if<(I < sizeof...(PARSERS))>::type setPacketArrivalTime(std::uint64_t arrival_ns)
+      {
+        std::get<I>(parsers).setPacketArrivalTime(arrival_ns);
+        setPacketArrivalTime<I + 1>(arrival_ns);
       }
 
       std::tuple<PARSERS...> parsers;
+
+      /// whether each parser is matched on its packet key alone, and the key, in tuple order
+      static constexpr std::array<bool, sizeof...(PARSERS)> keyed_ {{ParserPacketKey<PARSERS>::keyed...}};
+      static constexpr std::array<PacketKey, sizeof...(PARSERS)> keys_ {{ParserPacketKey<PARSERS>::key...}};
+
+      /// last match made on the packet key alone
+      bool last_match_valid_ = false;
+      PacketKey last_match_key_ = 0;
+      std::size_t last_match_index_ = 0;
     };
+
+    template <class RESULT, class... PARSERS>
+    constexpr std::array<bool, sizeof...(PARSERS)> VariadicPacketParser<RESULT, PARSERS...>::keyed_;
+
+    template <class RESULT, class... PARSERS>
+    constexpr std::array<PacketKey, sizeof...(PARSERS)> VariadicPacketParser<RESULT, PARSERS...>::keys_;
   };
 }
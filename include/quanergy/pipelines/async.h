@@ -16,17 +16,17 @@
 #include <boost/signals2.hpp>
 
 #include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
-#include <iostream>
+
+// queue with selectable backpressure
+#include <quanergy/common/bounded_queue.h>
 
 namespace quanergy
 {
   namespace pipeline
   {
     /** \brief AsyncModule makes it easy to move downstream processing on another thread
+     *  \details Inputs that do not fit in the queue are handled according to the backpressure
+     *           policy and counted in queueStatistics(). Each input counts as a whole frame.
       */
     template <class Type>
     struct AsyncModule
@@ -41,7 +41,7 @@ namespace quanergy
        *         the situation, a bigger value may be needed.
        */
       AsyncModule(std::size_t max_queue_size = 2)
-        : max_queue_size_(max_queue_size)
+        : input_queue_(max_queue_size)
       {
         // spin up new thread to handle inputs
         signal_thread_.reset(new std::thread([this]
@@ -59,11 +59,8 @@ namespace quanergy
 
       ~AsyncModule()
       {
-        {
-          std::lock_guard<std::mutex> lk(input_queue_mutex_);
-          kill_ = true;
-        }
-        input_queue_conditional_.notify_one();
+        // wakes the signal thread and a producer blocked on a full queue
+        input_queue_.close();
         if (signal_thread_ && signal_thread_->joinable())
         {
           signal_thread_->join();
@@ -75,57 +72,61 @@ namespace quanergy
         return signal_.connect(subscriber);
       }
 
+      /** \brief select what happens to an input that does not fit in the queue; defaults to DROP_OLDEST */
+      void setBackpressurePolicy(common::BackpressurePolicy policy) { input_queue_.setPolicy(policy); }
+      common::BackpressurePolicy getBackpressurePolicy() const { return input_queue_.getPolicy(); }
+
+      /** \brief limit the queue by bytes as well as count; 0 (the default) disables the byte limit
+       *  \details the size of a point cloud input is its number of points times the point size;
+       *           other inputs count as 0 bytes
+       */
+      void setMaxQueueBytes(std::size_t max_bytes) { input_queue_.setMaxBytes(max_bytes); }
+
+      /** \brief counters for dropped inputs and producer waits */
+      const common::QueueStatistics& queueStatistics() const { return input_queue_.statistics(); }
+
       void slot(const Type& input)
       {
         // if an exception was caught, send it up the chain
         if (exception_)
           std::rethrow_exception(exception_);
 
-        std::unique_lock<std::mutex> lk(input_queue_mutex_);
-
-        input_queue_.push(input);
-
-        // while shouldn't be necessary but doesn't hurt just to be sure
-        while (input_queue_.size() > max_queue_size_)
-        {
-          std::cerr << "Warning: AsyncModule dropped input due to full buffer" << std::endl;
-          input_queue_.pop();
-        }
-
-        lk.unlock();
-        input_queue_conditional_.notify_one();
+        input_queue_.push(input, inputBytes(input, 0));
       }
 
       void processInputs()
       {
         for (;;)
         {
-          std::unique_lock<std::mutex> lk(input_queue_mutex_);
-          // wait for something in the queue
-          if (input_queue_.empty())
-            input_queue_conditional_.wait(lk, [this]{return (!input_queue_.empty() || kill_);});
-
-          if (kill_)
+          Type item;
+          // wait for something in the queue; fails once we are being destroyed
+          if (!input_queue_.pop(item))
             return;
 
-          Type item = input_queue_.front();
-          input_queue_.pop();
-          lk.unlock();
-
           signal_(item);
         }
       }
 
     private:
+      /// size of a point cloud, found through its points member
+      template <class Pointer>
+      static auto inputBytes(const Pointer& input, int) -> decltype(input->points.size() * sizeof(input->points[0]))
+      {
+        return input ? input->points.size() * sizeof(input->points[0]) : 0;
+      }
+
+      /// size of anything else is unknown
+      template <class Input>
+      static std::size_t inputBytes(const Input&, long)
+      {
+        return 0;
+      }
+
       /// new thread for signal
       std::unique_ptr<std::thread> signal_thread_;
       std::exception_ptr exception_;
 
-      std::queue<Type>            input_queue_;
-      std::size_t                 max_queue_size_;
-      std::mutex                  input_queue_mutex_;
-      std::condition_variable     input_queue_conditional_;
-      std::atomic_bool            kill_ {false};
+      common::BoundedQueue<Type>  input_queue_;
 
       Signal signal_;
     };
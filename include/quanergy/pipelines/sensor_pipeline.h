@@ -24,6 +24,9 @@
 // conversion module from polar to Cartesian
 #include <quanergy/modules/polar_to_cart_converter.h>
 
+// single pass correction, filtering and conversion
+#include <quanergy/modules/fused_polar_to_cart_converter.h>
+
 // module to apply encoder correction
 #include <quanergy/modules/encoder_angle_calibration.h>
 
@@ -74,6 +77,9 @@ namespace quanergy
       quanergy::client::RingIntensityFilter ring_intensity_filter;
       // polar to cart converter; converts from the polar PCL cloud to a Cartesian one
       quanergy::client::PolarToCartConverter cartesian_converter;
+      // fused converter; replaces the encoder corrector (unless calibrating), filters and converter above
+      // if SensorPipelineSettings::fused_conversion is set, saving the intermediate clouds
+      quanergy::client::FusedPolarToCartConverter fused_converter;
       // async module to put the processing of the output cloud on a separate thread
       using AsyncType = quanergy::pipeline::AsyncModule<boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>>;
       AsyncType async;
@@ -98,6 +104,14 @@ namespace quanergy
         parser.slot(packet);
       }
 
+      /** \brief batchSlot simply calls the parser batch slot
+       *  \param the raw packets in the order received
+       */
+      void batchSlot(const std::vector<std::shared_ptr<std::vector<char>>>& packets)
+      {
+        parser.batchSlot(packets);
+      }
+
       /** \brief connect is just a convenience calling the polar to cart converters connect method
        *  \param subscriber is the slot to call; it is a function consuming
        *         const boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>&
@@ -108,6 +122,21 @@ namespace quanergy
       {
         return async.connect(subscriber);
       }
+
+      /** \brief connectSector connects to the sector signal of the M-series parsers
+       *  \details Sectors are emitted on the thread parsing packets, straight from the parser, so
+       *           they skip the encoder correction, filters, and conversion applied to full clouds.
+       *           Only emitted if SensorPipelineSettings::degrees_per_sector is set.
+       *  \param subscriber is the slot to call; it is a function consuming const PointCloudHVDIRPtr&
+       *  \returns connections created, one per parser
+       */
+      std::vector<boost::signals2::connection> connectSector(
+          const quanergy::client::DataPacketParserMSeries::SectorSignal::slot_type& subscriber)
+      {
+        return {parser.get<PARSER_00_INDEX>().connectSector(subscriber),
+                parser.get<PARSER_04_INDEX>().connectSector(subscriber),
+                parser.get<PARSER_06_INDEX>().connectSector(subscriber)};
+      }
     };
   }
 }
@@ -10,6 +10,9 @@
 
 #include <quanergy/parsers/data_packet_parser_m_series.h>
 
+// socket and thread tuning for the client
+#include <quanergy/client/tcp_client_options.h>
+
 // for setting file
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -58,12 +61,37 @@ namespace quanergy
       std::int32_t min_cloud_size = 0;
       std::int32_t max_cloud_size = quanergy::client::MAX_CLOUD_SIZE;
 
+      // threads decoding batches of packets; more than 1 decodes the packets of
+      // a batch in parallel and stitches them into clouds in order
+      // output is the same as decoding on a single thread
+      std::size_t decode_threads = 1;
+
+      // sweep of the sectors the M-series parsers emit ahead of the full cloud
+      // 0 emits no sectors; see SensorPipeline::connectSector
+      double degrees_per_sector = 0.;
+
+      // convert clouds to XYZIR in a single pass that also applies encoder correction, the distance
+      // filter and the ring filter, instead of through the separate modules; output is equivalent
+      // see SensorPipeline::fused_converter
+      bool fused_conversion = false;
+
+      // region of interest of the M-series parsers; firings and rings outside it are skipped before decoding
+      // azimuth intervals in encoder counts; none keeps every azimuth
+      // see DataPacketParserMSeries::setRegionOfInterest
+      std::vector<quanergy::client::AzimuthInterval> roi_azimuth;
+      // rings to keep, a bit per ring
+      std::uint8_t roi_ring_mask = quanergy::client::ALL_RINGS;
+
       // Ring filter; generally this is not needed
       // Only can be configured in settings file
       // only relevant for M-series
       float ring_range[quanergy::client::M_SERIES_NUM_LASERS] = {0.f};
       std::uint16_t ring_intensity[quanergy::client::M_SERIES_NUM_LASERS] = {0};
 
+      // socket and thread tuning for the TCP client; defaults change nothing
+      // Only can be configured in settings file
+      quanergy::client::TCPClientOptions client_options;
+
       /** \brief load settings from SettingsFileLoader
        *  \param settings SettingsFileLoader to load from
        */
@@ -73,6 +101,11 @@ namespace quanergy
       static int returnFromString(const std::string& r);
       static std::string stringFromReturn(int r);
 
+      /// \brief convert a comma separated list of begin-end encoder count intervals, e.g. "8667-1733,5000-5100"
+      static std::vector<quanergy::client::AzimuthInterval> azimuthIntervalsFromString(const std::string& intervals);
+      /// \brief convert a comma separated list of rings and ranges of rings, e.g. "0-3,6", to a ring mask
+      static std::uint8_t ringMaskFromString(const std::string& rings);
+
     };
 
     class DLLEXPORT SettingsFileLoader : public boost::property_tree::ptree
@@ -0,0 +1,143 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/client/sensor_fleet.h>
+
+#include <algorithm>
+
+namespace quanergy
+{
+  namespace client
+  {
+    SensorFleet::SensorFleet(std::size_t io_threads,
+                             std::size_t dispatch_threads)
+      : io_thread_count_(std::max<std::size_t>(io_threads, 1))
+    {
+      for (std::size_t i = 0; i < std::max<std::size_t>(dispatch_threads, 1); ++i)
+      {
+        dispatchers_.emplace_back(new boost::asio::io_service());
+      }
+    }
+
+    SensorFleet::~SensorFleet()
+    {
+      stop();
+    }
+
+    SensorClient& SensorFleet::addSensor(std::string const & host,
+                                         std::string const & port,
+                                         std::size_t max_queue_size)
+    {
+      sensors_.emplace_back(new SensorClient(io_service_, host, port, max_queue_size));
+      return *sensors_.back();
+    }
+
+    void SensorFleet::run()
+    {
+      {
+        std::lock_guard<std::mutex> lk(state_mutex_);
+        if (running_)
+          return;
+
+        running_ = true;
+        stopping_ = false;
+        failed_count_ = 0;
+      }
+
+      failed_.assign(sensors_.size(), 0);
+
+      // keep the threads running while there is nothing to do
+      io_service_.reset();
+      std::unique_ptr<boost::asio::io_service::work> io_work(new boost::asio::io_service::work(io_service_));
+
+      std::vector<std::unique_ptr<boost::asio::io_service::work>> dispatch_work;
+      for (auto& dispatcher : dispatchers_)
+      {
+        dispatcher->reset();
+        dispatch_work.emplace_back(new boost::asio::io_service::work(*dispatcher));
+      }
+
+      std::vector<std::thread> threads;
+      for (std::size_t i = 0; i < io_thread_count_; ++i)
+      {
+        threads.emplace_back([this]{ io_service_.run(); });
+      }
+
+      for (auto& dispatcher : dispatchers_)
+      {
+        boost::asio::io_service* service = dispatcher.get();
+        threads.emplace_back([service]{ service->run(); });
+      }
+
+      // each sensor drains on the same dispatcher every time to keep its packets in order
+      for (std::size_t i = 0; i < sensors_.size(); ++i)
+      {
+        boost::asio::io_service* dispatcher = dispatchers_[i % dispatchers_.size()].get();
+        sensors_[i]->start([this, dispatcher, i]
+                           {
+                             dispatcher->post([this, i]{ drain(i); });
+                           });
+      }
+
+      {
+        std::unique_lock<std::mutex> lk(state_mutex_);
+        state_condition_.wait(lk, [this]{return (stopping_ || failed_count_ == sensors_.size());});
+      }
+
+      // closing the sockets lets the io threads run out of work
+      for (auto& sensor : sensors_)
+      {
+        sensor->stop();
+      }
+
+      io_work.reset();
+      dispatch_work.clear();
+      for (auto& thread : threads)
+      {
+        thread.join();
+      }
+
+      std::exception_ptr eptr;
+      {
+        std::lock_guard<std::mutex> lk(state_mutex_);
+        running_ = false;
+        if (!stopping_ && !sensors_.empty())
+          eptr = sensors_.front()->error();
+      }
+
+      if (eptr) std::rethrow_exception(eptr);
+    }
+
+    void SensorFleet::stop()
+    {
+      {
+        std::lock_guard<std::mutex> lk(state_mutex_);
+        stopping_ = true;
+      }
+      state_condition_.notify_all();
+    }
+
+    void SensorFleet::drain(std::size_t index)
+    {
+      SensorClient& sensor = *sensors_[index];
+      sensor.drainPackets();
+
+      if (!failed_[index] && sensor.error())
+      {
+        failed_[index] = 1;
+
+        {
+          std::lock_guard<std::mutex> lk(state_mutex_);
+          ++failed_count_;
+        }
+        state_condition_.notify_all();
+      }
+    }
+
+  } // namespace client
+
+} // namespace quanergy
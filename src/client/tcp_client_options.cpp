@@ -0,0 +1,310 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/client/tcp_client_options.h>
+#include <quanergy/common/range_list.h>
+
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/socket.h>
+  #include <linux/net_tstamp.h>
+#endif
+
+using namespace quanergy::client;
+
+std::vector<int> TCPClientOptions::cpusFromString(const std::string& cpus)
+{
+  std::vector<int> ret;
+
+  for (const auto& range : quanergy::common::rangesFromString(cpus, false, "Invalid CPU list"))
+  {
+    if (range.second < range.first)
+    {
+      throw std::invalid_argument("Invalid CPU list");
+    }
+
+    for (int cpu = range.first; cpu <= range.second; ++cpu)
+    {
+      ret.push_back(cpu);
+    }
+  }
+
+  return ret;
+}
+
+SchedulingPolicy TCPClientOptions::policyFromString(const std::string& policy)
+{
+  if (policy.empty() || policy == "default")
+  {
+    return SchedulingPolicy::DEFAULT;
+  }
+  else if (policy == "fifo")
+  {
+    return SchedulingPolicy::FIFO;
+  }
+  else if (policy == "rr")
+  {
+    return SchedulingPolicy::ROUND_ROBIN;
+  }
+
+  throw std::invalid_argument("Invalid scheduling policy");
+}
+
+std::ostream& quanergy::client::operator<<(std::ostream& os, const AppliedTCPClientOptions& applied)
+{
+  os << "receive buffer size: " << applied.receive_buffer_size
+     << "; TCP no delay: " << (applied.tcp_no_delay ? "on" : "off")
+     << "; busy poll: " << applied.busy_poll << " us"
+     << "; kernel timestamps: " << (applied.kernel_timestamps ? "on" : "off")
+     << "; io thread affinity/scheduling: " << applied.io_thread.affinity << "/" << applied.io_thread.scheduling
+     << "; signal thread affinity/scheduling: " << applied.signal_thread.affinity << "/" << applied.signal_thread.scheduling;
+
+  for (const auto& error : applied.errors)
+  {
+    os << std::endl << "  not applied: " << error;
+  }
+
+  return os;
+}
+
+void quanergy::client::applySocketOptions(boost::asio::ip::tcp::socket& socket,
+                                          const TCPClientOptions& options,
+                                          AppliedTCPClientOptions& applied)
+{
+  boost::system::error_code error;
+
+  if (options.receive_buffer_size > 0)
+  {
+    socket.set_option(boost::asio::socket_base::receive_buffer_size(options.receive_buffer_size), error);
+    if (error)
+      applied.errors.push_back("receive buffer size: " + error.message());
+  }
+
+  boost::asio::socket_base::receive_buffer_size receive_buffer_size;
+  socket.get_option(receive_buffer_size, error);
+  if (!error)
+    applied.receive_buffer_size = receive_buffer_size.value();
+
+  if (options.tcp_no_delay)
+  {
+    socket.set_option(boost::asio::ip::tcp::no_delay(true), error);
+    if (error)
+      applied.errors.push_back("TCP no delay: " + error.message());
+  }
+
+  boost::asio::ip::tcp::no_delay no_delay;
+  socket.get_option(no_delay, error);
+  if (!error)
+    applied.tcp_no_delay = no_delay.value();
+
+  if (options.busy_poll > 0)
+  {
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+    int busy_poll = options.busy_poll;
+    if (setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) != 0)
+    {
+      applied.errors.push_back(std::string("busy poll: ") + std::strerror(errno));
+    }
+
+    socklen_t length = sizeof(busy_poll);
+    if (getsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &busy_poll, &length) == 0)
+    {
+      applied.busy_poll = busy_poll;
+    }
+#else
+    applied.errors.push_back("busy poll: not supported on this platform");
+#endif
+  }
+
+  if (options.kernel_timestamps)
+  {
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    // software receive stamps need no driver support
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+    {
+      // we read the socket ourselves when stamping so it mustn't block
+      socket.native_non_blocking(true, error);
+      if (error)
+        applied.errors.push_back("kernel timestamps: " + error.message());
+      else
+        applied.kernel_timestamps = true;
+    }
+    else
+    {
+      applied.errors.push_back(std::string("kernel timestamps: ") + std::strerror(errno));
+    }
+#else
+    applied.errors.push_back("kernel timestamps: not supported on this platform");
+#endif
+  }
+}
+
+std::size_t quanergy::client::receiveWithTimestamp(boost::asio::ip::tcp::socket& socket,
+                                                   const std::vector<boost::asio::mutable_buffer>& buffers,
+                                                   std::uint64_t& arrival_ns,
+                                                   boost::system::error_code& error)
+{
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+  std::vector<iovec> iov(buffers.size());
+  for (std::size_t i = 0; i < buffers.size(); ++i)
+  {
+    iov[i].iov_base = boost::asio::buffer_cast<void*>(buffers[i]);
+    iov[i].iov_len = boost::asio::buffer_size(buffers[i]);
+  }
+
+  // SCM_TIMESTAMPING carries three stamps; the software one comes first
+  union
+  {
+    cmsghdr align;
+    char    buffer[CMSG_SPACE(3 * sizeof(timespec))];
+  } control;
+
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = iov.size();
+  msg.msg_control = control.buffer;
+  msg.msg_controllen = sizeof(control.buffer);
+
+  ssize_t received = ::recvmsg(socket.native_handle(), &msg, 0);
+  if (received < 0)
+  {
+    error = boost::system::error_code(errno, boost::asio::error::get_system_category());
+    return 0;
+  }
+  else if (received == 0)
+  {
+    error = boost::asio::error::eof;
+    return 0;
+  }
+
+  for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+    {
+      timespec stamp;
+      std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+      if (stamp.tv_sec != 0 || stamp.tv_nsec != 0)
+        arrival_ns = std::uint64_t(stamp.tv_sec) * 1000000000ull + std::uint64_t(stamp.tv_nsec);
+    }
+  }
+
+  error = boost::system::error_code();
+  return static_cast<std::size_t>(received);
+#else
+  // kernel timestamps are never applied here
+  (void)arrival_ns;
+  return socket.read_some(buffers, error);
+#endif
+}
+
+void quanergy::client::applyThreadOptions(const ThreadOptions& options,
+                                          const std::string& name,
+                                          AppliedThreadOptions& applied,
+                                          std::vector<std::string>& errors,
+                                          SavedThreadOptions* saved)
+{
+  if (!options.cpus.empty())
+  {
+#ifdef __linux__
+    cpu_set_t previous;
+    bool have_previous = (pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) == 0);
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : options.cpus)
+    {
+      if (cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &cpu_set);
+    }
+
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (result == 0)
+    {
+      applied.affinity = true;
+
+      if (saved && have_previous)
+      {
+        saved->affinity = true;
+        saved->cpus.clear();
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+          if (CPU_ISSET(cpu, &previous))
+            saved->cpus.push_back(cpu);
+        }
+      }
+    }
+    else
+      errors.push_back(name + " affinity: " + std::strerror(result));
+#else
+    errors.push_back(name + " affinity: not supported on this platform");
+#endif
+  }
+
+  if (options.policy != SchedulingPolicy::DEFAULT)
+  {
+#ifdef __linux__
+    int previous_policy = 0;
+    sched_param previous;
+    bool have_previous = (pthread_getschedparam(pthread_self(), &previous_policy, &previous) == 0);
+
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = options.priority;
+
+    int policy = (options.policy == SchedulingPolicy::FIFO) ? SCHED_FIFO : SCHED_RR;
+    int result = pthread_setschedparam(pthread_self(), policy, &param);
+    if (result == 0)
+    {
+      applied.scheduling = true;
+
+      if (saved && have_previous)
+      {
+        saved->scheduling = true;
+        saved->policy = previous_policy;
+        saved->priority = previous.sched_priority;
+      }
+    }
+    else
+      errors.push_back(name + " scheduling: " + std::strerror(result));
+#else
+    errors.push_back(name + " scheduling: not supported on this platform");
+#endif
+  }
+}
+
+void quanergy::client::restoreThreadOptions(const SavedThreadOptions& saved)
+{
+#ifdef __linux__
+  // scheduling first; dropping real-time priority can't fail for lack of privileges
+  if (saved.scheduling)
+  {
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = saved.priority;
+    pthread_setschedparam(pthread_self(), saved.policy, &param);
+  }
+
+  if (saved.affinity)
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : saved.cpus)
+      CPU_SET(cpu, &cpu_set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  }
+#else
+  (void)saved;
+#endif
+}
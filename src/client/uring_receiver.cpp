@@ -0,0 +1,401 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/client/uring_receiver.h>
+
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+
+#if defined(__linux__) && defined(__has_include)
+  #if __has_include(<linux/io_uring.h>)
+    #include <linux/io_uring.h>
+    // multishot receive came after the buffer rings it depends on
+    #ifdef IORING_RECV_MULTISHOT
+      #define QUANERGY_HAS_IO_URING
+    #endif
+  #endif
+#endif
+
+#ifdef QUANERGY_HAS_IO_URING
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <sys/eventfd.h>
+  #include <unistd.h>
+  #include <stdlib.h>
+#endif
+
+using namespace quanergy::client;
+
+#ifdef QUANERGY_HAS_IO_URING
+
+namespace
+{
+  /// user_data of the receive and of the request cancelling it
+  const std::uint64_t RECV_TAG = 1;
+  const std::uint64_t CANCEL_TAG = 2;
+  /// the only buffer group we register
+  const std::uint16_t BUFFER_GROUP = 0;
+
+  boost::system::system_error systemError(int error, const char* what)
+  {
+    return boost::system::system_error(boost::system::error_code(error, boost::system::system_category()), what);
+  }
+}
+
+struct UringReceiver::Impl
+{
+  Impl(boost::asio::io_service& io_service, int socket)
+    : socket_fd(socket)
+    , event(io_service)
+    , counter(std::make_shared<std::uint64_t>(0))
+  {
+  }
+
+  ~Impl()
+  {
+    boost::system::error_code ignored;
+    event.close(ignored);
+
+    if (sq_ptr != MAP_FAILED)
+      munmap(sq_ptr, sq_size);
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+      munmap(cq_ptr, cq_size);
+    if (sqes != MAP_FAILED)
+      munmap(sqes, sqes_size);
+
+    // closing the ring unregisters the buffer ring and eventfd
+    if (ring_fd >= 0)
+      close(ring_fd);
+
+    free(buffer_ring);
+  }
+
+  void setup(std::size_t buffer_count, std::size_t buffer_size)
+  {
+    // the kernel posts one completion per filled buffer; leave room for all of them
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = static_cast<unsigned>(2 * buffer_count);
+
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+    if (ring_fd < 0)
+      throw systemError(errno, "io_uring setup");
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+      sq_size = cq_size = std::max(sq_size, cq_size);
+
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED)
+      throw systemError(errno, "io_uring map");
+
+    cq_ptr = single_mmap ? sq_ptr
+                         : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED)
+      throw systemError(errno, "io_uring map");
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                           ring_fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED)
+      throw systemError(errno, "io_uring map");
+
+    char* sq = static_cast<char*>(sq_ptr);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    char* cq = static_cast<char*>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // register the receive buffers; the ring size must be a power of two
+    std::size_t entries = 1;
+    while (entries < buffer_count)
+      entries <<= 1;
+    buffer_mask = static_cast<std::uint16_t>(entries - 1);
+    this->buffer_size = buffer_size;
+    buffers.reset(new char[buffer_count * buffer_size]);
+
+    if (posix_memalign(reinterpret_cast<void**>(&buffer_ring), sysconf(_SC_PAGESIZE), entries * sizeof(io_uring_buf)) != 0)
+      throw systemError(ENOMEM, "io_uring buffer ring");
+    std::memset(buffer_ring, 0, entries * sizeof(io_uring_buf));
+
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<std::uint64_t>(buffer_ring);
+    reg.ring_entries = static_cast<std::uint32_t>(entries);
+    reg.bgid = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+      throw systemError(errno, "io_uring buffer registration");
+
+    for (std::size_t i = 0; i < buffer_count; ++i)
+      recycle(static_cast<std::uint16_t>(i));
+    publishBuffers();
+
+    // wake the io_service through an eventfd; asio owns and closes it
+    int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (event_fd < 0)
+      throw systemError(errno, "io_uring eventfd");
+    event.assign(event_fd);
+
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) != 0)
+      throw systemError(errno, "io_uring eventfd registration");
+
+    arm();
+  }
+
+  void submit(const io_uring_sqe& sqe)
+  {
+    // we submit one entry at a time, so the slot at the tail is always free
+    unsigned tail = *sq_tail;
+    unsigned index = tail & sq_mask;
+    sqes[index] = sqe;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0) < 0)
+      throw systemError(errno, "io_uring submit");
+  }
+
+  void arm()
+  {
+    io_uring_sqe sqe;
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = socket_fd;
+    sqe.ioprio = multishot ? IORING_RECV_MULTISHOT : 0;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = BUFFER_GROUP;
+    sqe.user_data = RECV_TAG;
+    submit(sqe);
+    armed = true;
+  }
+
+  void cancel()
+  {
+    io_uring_sqe sqe;
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = -1;
+    sqe.addr = RECV_TAG;
+    sqe.user_data = CANCEL_TAG;
+    submit(sqe);
+  }
+
+  /// give a buffer back to the kernel; takes effect on publishBuffers
+  void recycle(std::uint16_t bid)
+  {
+    io_uring_buf& buf = buffer_ring[buffer_tail & buffer_mask];
+    buf.addr = reinterpret_cast<std::uint64_t>(buffers.get() + bid * buffer_size);
+    buf.len = static_cast<std::uint32_t>(buffer_size);
+    buf.bid = bid;
+    ++buffer_tail;
+  }
+
+  void publishBuffers()
+  {
+    // the ring tail overlays the reserved field of the first entry
+    __atomic_store_n(&buffer_ring[0].resv, buffer_tail, __ATOMIC_RELEASE);
+  }
+
+  /// process completions; data is only handed out when handler is set
+  void drain(const DataHandler* handler, boost::system::error_code& error)
+  {
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head)
+    {
+      io_uring_cqe cqe = cqes[head & cq_mask];
+      // release the entry before handling it so a throwing handler leaves the ring consistent
+      __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+
+      if (cqe.user_data != RECV_TAG)
+        continue;
+
+      if (!(cqe.flags & IORING_CQE_F_MORE))
+        armed = false;
+
+      bool has_buffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+      std::uint16_t bid = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+      if (cqe.res > 0)
+      {
+        received_any = true;
+        if (handler && !error)
+        {
+          try
+          {
+            (*handler)(buffers.get() + bid * buffer_size, static_cast<std::size_t>(cqe.res));
+          }
+          catch (...)
+          {
+            recycle(bid);
+            publishBuffers();
+            throw;
+          }
+        }
+      }
+      else if (cqe.res == 0)
+      {
+        error = boost::asio::error::eof;
+      }
+      else if (cqe.res == -ENOBUFS)
+      {
+        // we fell behind; the receive is armed again once buffers are back
+        ++exhausted;
+      }
+      else if (cqe.res == -EINVAL && multishot && !received_any)
+      {
+        // kernel without multishot receive; arm one receive at a time
+        multishot = false;
+      }
+      else if (cqe.res != -ECANCELED)
+      {
+        error = boost::system::error_code(-cqe.res, boost::system::system_category());
+      }
+
+      if (has_buffer)
+        recycle(bid);
+    }
+
+    publishBuffers();
+  }
+
+  int                                       socket_fd;
+  int                                       ring_fd = -1;
+  boost::asio::posix::stream_descriptor     event;
+  std::shared_ptr<std::uint64_t>            counter;
+
+  void*                                     sq_ptr = MAP_FAILED;
+  std::size_t                               sq_size = 0;
+  void*                                     cq_ptr = MAP_FAILED;
+  std::size_t                               cq_size = 0;
+  io_uring_sqe*                             sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  std::size_t                               sqes_size = 0;
+  unsigned*                                 sq_tail = nullptr;
+  unsigned                                  sq_mask = 0;
+  unsigned*                                 sq_array = nullptr;
+  unsigned*                                 cq_head = nullptr;
+  unsigned*                                 cq_tail = nullptr;
+  unsigned                                  cq_mask = 0;
+  io_uring_cqe*                             cqes = nullptr;
+
+  std::unique_ptr<char[]>                   buffers;
+  std::size_t                               buffer_size = 0;
+  io_uring_buf*                             buffer_ring = nullptr;
+  std::uint16_t                             buffer_mask = 0;
+  std::uint16_t                             buffer_tail = 0;
+
+  bool                                      armed = false;
+  bool                                      multishot = true;
+  bool                                      received_any = false;
+  std::size_t                               exhausted = 0;
+};
+
+UringReceiver::UringReceiver(boost::asio::io_service& io_service,
+                             boost::asio::ip::tcp::socket& socket,
+                             std::size_t buffer_count,
+                             std::size_t buffer_size)
+  : impl_(new Impl(io_service, socket.native_handle()))
+{
+  impl_->setup(std::max<std::size_t>(buffer_count, 1), std::max<std::size_t>(buffer_size, 1));
+}
+
+UringReceiver::~UringReceiver()
+{
+  if (!impl_->armed)
+    return;
+
+  try
+  {
+    // the kernel may write into the buffers until the receive has completed for good
+    impl_->cancel();
+
+    boost::system::error_code ignored;
+    while (impl_->armed)
+    {
+      if (syscall(__NR_io_uring_enter, impl_->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+          errno != EINTR)
+      {
+        break;
+      }
+
+      impl_->drain(nullptr, ignored);
+    }
+  }
+  catch (...)
+  {
+    // nothing sensible left to do; closing the ring cancels everything regardless
+  }
+}
+
+void UringReceiver::asyncWait(WaitHandler handler)
+{
+  std::shared_ptr<std::uint64_t> counter = impl_->counter;
+  impl_->event.async_read_some(boost::asio::buffer(counter.get(), sizeof(std::uint64_t)),
+                               [handler, counter](const boost::system::error_code& error, std::size_t)
+                               {
+                                 handler(error);
+                               });
+}
+
+void UringReceiver::reap(const DataHandler& handler, boost::system::error_code& error)
+{
+  error = boost::system::error_code();
+  impl_->drain(&handler, error);
+
+  // a single receive, or a multishot one stopped by running out of buffers, needs arming again
+  if (!impl_->armed && !error)
+    impl_->arm();
+}
+
+std::size_t UringReceiver::bufferExhaustedCount() const
+{
+  return impl_->exhausted;
+}
+
+#else
+
+struct UringReceiver::Impl
+{
+};
+
+UringReceiver::UringReceiver(boost::asio::io_service& /*io_service*/,
+                             boost::asio::ip::tcp::socket& /*socket*/,
+                             std::size_t /*buffer_count*/,
+                             std::size_t /*buffer_size*/)
+{
+  throw boost::system::system_error(boost::asio::error::operation_not_supported, "io_uring");
+}
+
+UringReceiver::~UringReceiver()
+{
+}
+
+void UringReceiver::asyncWait(WaitHandler /*handler*/)
+{
+}
+
+void UringReceiver::reap(const DataHandler& /*handler*/, boost::system::error_code& error)
+{
+  error = boost::asio::error::operation_not_supported;
+}
+
+std::size_t UringReceiver::bufferExhaustedCount() const
+{
+  return 0;
+}
+
+#endif
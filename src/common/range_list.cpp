@@ -0,0 +1,57 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/range_list.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace quanergy
+{
+  namespace common
+  {
+    std::vector<std::pair<int, int>> rangesFromString(const std::string& list, bool need_end, const char* error)
+    {
+      std::vector<std::pair<int, int>> ret;
+      std::stringstream ss(list);
+      std::string token;
+
+      while (std::getline(ss, token, ','))
+      {
+        // trim whitespace
+        token.erase(0, token.find_first_not_of(" \t\n"));
+        token.erase(token.find_last_not_of(" \t\n") + 1);
+        if (token.empty())
+          continue;
+
+        std::size_t dash = token.find('-');
+        if (need_end && dash == std::string::npos)
+        {
+          throw std::invalid_argument(error);
+        }
+
+        std::string first = token.substr(0, dash);
+        std::string last = (dash == std::string::npos) ? first : token.substr(dash + 1);
+
+        if (first.empty() || last.empty() ||
+            !std::all_of(first.begin(), first.end(), ::isdigit) ||
+            !std::all_of(last.begin(), last.end(), ::isdigit))
+        {
+          throw std::invalid_argument(error);
+        }
+
+        ret.emplace_back(std::atoi(first.c_str()), std::atoi(last.c_str()));
+      }
+
+      return ret;
+    }
+
+  } // namespace common
+
+} // namespace quanergy
@@ -0,0 +1,36 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/sin_cos_table.h>
+
+#include <cmath>
+
+namespace quanergy
+{
+  namespace common
+  {
+    const SinCosTable& SinCosTable::instance()
+    {
+      // built once, thread safe since C++11
+      static const SinCosTable table;
+      return table;
+    }
+
+    SinCosTable::SinCosTable()
+      : table_(STEPS)
+    {
+      for (std::int32_t i = 0; i < STEPS; ++i)
+      {
+        double angle = static_cast<double>(i) * RADIANS_PER_STEP;
+        table_[i].sin = std::sin(angle);
+        table_[i].cos = std::cos(angle);
+      }
+    }
+
+  } // namespace common
+
+} // namespace quanergy
@@ -0,0 +1,108 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/worker_pool.h>
+
+using namespace quanergy::common;
+
+WorkerPool::WorkerPool(std::size_t threads)
+{
+  threads_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i)
+  {
+    threads_.emplace_back([this]{ work(); });
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    stop_ = true;
+  }
+  start_condition_.notify_all();
+
+  for (auto& thread : threads_)
+  {
+    thread.join();
+  }
+}
+
+void WorkerPool::run(std::size_t count, const std::function<void (std::size_t)>& task)
+{
+  if (count == 0)
+    return;
+
+  // a single iteration isn't worth waking anyone for
+  const bool wake = (count > 1 && !threads_.empty());
+
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    task_ = &task;
+    count_ = count;
+    next_ = 0;
+    error_ = nullptr;
+    busy_ = wake ? threads_.size() : 0;
+    if (wake)
+      ++generation_;
+  }
+
+  if (wake)
+    start_condition_.notify_all();
+
+  runIterations();
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  done_condition_.wait(lk, [this]{ return busy_ == 0; });
+  task_ = nullptr;
+
+  if (error_)
+  {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void WorkerPool::work()
+{
+  std::uint64_t generation = 0;
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true)
+  {
+    start_condition_.wait(lk, [this, generation]{ return stop_ || generation_ != generation; });
+    if (stop_)
+      return;
+
+    generation = generation_;
+
+    lk.unlock();
+    runIterations();
+    lk.lock();
+
+    if (--busy_ == 0)
+      done_condition_.notify_one();
+  }
+}
+
+void WorkerPool::runIterations()
+{
+  for (std::size_t i = next_++; i < count_; i = next_++)
+  {
+    try
+    {
+      (*task_)(i);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      if (!error_)
+        error_ = std::current_exception();
+    }
+  }
+}
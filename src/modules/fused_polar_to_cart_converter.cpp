@@ -0,0 +1,173 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/modules/fused_polar_to_cart_converter.h>
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace quanergy
+{
+  namespace client
+  {
+
+    FusedPolarToCartConverter::FusedPolarToCartConverter()
+      : max_distance_threshold_(std::numeric_limits<float>::max())
+    {
+      // same defaults as RingIntensityFilter, which filter nothing
+      for (std::uint16_t i = 0; i < M_SERIES_NUM_LASERS; ++i)
+      {
+        ring_filter_range_[i] = 1.0f;
+        ring_filter_intensity_[i] = 0;
+      }
+    }
+
+    boost::signals2::connection FusedPolarToCartConverter::connect(const typename Signal::slot_type& subscriber)
+    {
+      return signal_.connect(subscriber);
+    }
+
+    void FusedPolarToCartConverter::slot(PointCloudHVDIRConstPtr const & cloudPtr)
+    {
+      if (!cloudPtr) return;
+
+      // Don't do the work unless someone is listening.
+      if (signal_.num_slots() == 0) return;
+
+      PointCloudHVDIR const & cloud = *cloudPtr;
+
+      PointCloudXYZIRPtr resultPtr = frame_pool_.acquire();
+
+      PointCloudXYZIR & result = *resultPtr;
+
+      result.header.stamp = cloud.header.stamp;
+      result.header.seq = cloud.header.seq;
+      result.header.frame_id = cloud.header.frame_id;
+      common::copyArrivalTime(cloudPtr, resultPtr);
+
+      result.reserve(cloud.size());
+
+      bool is_dense = cloud.is_dense;
+
+      const common::SinCosTable& table = common::SinCosTable::instance();
+      const float nan = std::numeric_limits<float>::quiet_NaN();
+
+      for (const auto& from : cloud.points)
+      {
+        // distance and ring intensity filters, as DistanceFilter and RingIntensityFilter apply them
+        bool filtered = (from.d < min_distance_threshold_) || (from.d > max_distance_threshold_)
+                        || ((from.ring < M_SERIES_NUM_LASERS)
+                            && (from.d < ring_filter_range_[from.ring])
+                            && (from.intensity < ring_filter_intensity_[from.ring]));
+
+        if (filtered || std::isnan(from.d))
+        {
+          // use points.push_back instead of cloud.push_back wrapper
+          // cloud.push_back wrapper resets width and height
+          result.points.push_back(PointCloudXYZIR::PointType(nan, nan, nan, from.intensity, from.ring));
+          is_dense = false;
+          continue;
+        }
+
+        // encoder correction, as EncoderAngleCalibration applies it
+        float h = from.h;
+        if (amplitude_ != 0.)
+        {
+          double sin_correction, cos_correction;
+          table.sinCos(h + phase_, sin_correction, cos_correction);
+          h = h - (amplitude_ * sin_correction);
+          if (h < -M_PI)
+          {
+            h += 2 * M_PI;
+          }
+          else if (h > M_PI)
+          {
+            h -= 2 * M_PI;
+          }
+        }
+
+        // conversion, as PolarToCartConverter does it
+        double sin_horizontal_angle, cos_horizontal_angle;
+        table.sinCos(h, sin_horizontal_angle, cos_horizontal_angle);
+
+        double sin_vertical_angle, cos_vertical_angle;
+        table.sinCos(from.v, sin_vertical_angle, cos_vertical_angle);
+
+        // get the distance to the XY plane
+        double xy_distance = from.d * cos_vertical_angle;
+
+        result.points.push_back(PointCloudXYZIR::PointType(static_cast<float>(xy_distance * cos_horizontal_angle),
+                                                           static_cast<float>(xy_distance * sin_horizontal_angle),
+                                                           static_cast<float>(from.d * sin_vertical_angle),
+                                                           from.intensity, from.ring));
+      }
+
+      result.width = cloud.width;
+      result.height = cloud.height;
+      result.is_dense = is_dense;
+
+      frame_pool_.observeFrameSize(result.size());
+
+      signal_(resultPtr);
+    }
+
+    void FusedPolarToCartConverter::setEncoderParams(double amplitude, double phase)
+    {
+      // same limits as EncoderAngleCalibration::setParams
+      if (amplitude < -2 * M_PI || amplitude > 2 * M_PI
+          || phase < -2 * M_PI || phase > 2 * M_PI)
+      {
+        throw std::invalid_argument("FusedPolarToCartConverter amplitude or phase out of range [-2PI, 2PI]");
+      }
+
+      amplitude_ = amplitude;
+      phase_ = phase;
+    }
+
+    void FusedPolarToCartConverter::setMaximumDistanceThreshold(float maxThreshold)
+    {
+      max_distance_threshold_ = maxThreshold;
+    }
+
+    void FusedPolarToCartConverter::setMinimumDistanceThreshold(float minThreshold)
+    {
+      min_distance_threshold_ = minThreshold;
+    }
+
+    void FusedPolarToCartConverter::setRingFilterMinimumRangeThreshold(const std::uint16_t laser_beam,
+                                                                       const float threshold)
+    {
+      if (laser_beam >= M_SERIES_NUM_LASERS)
+      {
+        std::cerr << "Index out of bound! Beam index should be between 0 and "
+                  << M_SERIES_NUM_LASERS << std::endl;
+      }
+      else
+      {
+        ring_filter_range_[laser_beam] = threshold;
+      }
+    }
+
+    void FusedPolarToCartConverter::setRingFilterMinimumIntensityThreshold(const std::uint16_t laser_beam,
+                                                                           const std::uint8_t threshold)
+    {
+      if (laser_beam >= M_SERIES_NUM_LASERS)
+      {
+        std::cerr << "Index out of bound! Beam index should be between 0 and "
+                  << M_SERIES_NUM_LASERS << std::endl;
+      }
+      else
+      {
+        ring_filter_intensity_[laser_beam] = threshold;
+      }
+    }
+
+  } // namespace client
+
+} // namespace quanergy
@@ -26,23 +26,26 @@ namespace quanergy
 
       PointCloudHVDIR const & cloud = *cloudPtr;
 
-      PointCloudXYZIRPtr resultPtr = PointCloudXYZIRPtr(new PointCloudXYZIR());
+      PointCloudXYZIRPtr resultPtr = common::makeCloud<PointCloudXYZIR>();
       
       PointCloudXYZIR & result = *resultPtr;
 
       result.header.stamp = cloud.header.stamp;
       result.header.seq = cloud.header.seq;
       result.header.frame_id = cloud.header.frame_id;
+      common::copyArrivalTime(cloudPtr, resultPtr);
 
       result.reserve(cloud.size());
 
       bool is_dense = cloud.is_dense;
 
+      const common::SinCosTable& table = common::SinCosTable::instance();
+
       for (PointCloudHVDIR::const_iterator i = cloud.points.begin();
            i != cloud.points.end();
            ++i)
       {
-        PointCloudXYZIR::PointType pt = polarToCart(*i);
+        PointCloudXYZIR::PointType pt = polarToCart(*i, table);
 
         // use points.push_back instead of cloud.push_back wrapper
         // cloud.push_back wrapper resets width and height
@@ -62,7 +65,8 @@ namespace quanergy
       signal_(resultPtr);
     }
 
-    PointCloudXYZIR::PointType PolarToCartConverter::polarToCart(PointCloudHVDIR::PointType const & from)
+    PointCloudXYZIR::PointType PolarToCartConverter::polarToCart(PointCloudHVDIR::PointType const & from,
+                                                                 common::SinCosTable const & table)
     {
       PointCloudXYZIR::PointType to;
 
@@ -75,11 +79,11 @@ namespace quanergy
         return to;
       }
 
-      double const cos_horizontal_angle = std::cos(from.h);
-      double const sin_horizontal_angle = std::sin(from.h);
+      double sin_horizontal_angle, cos_horizontal_angle;
+      table.sinCos(from.h, sin_horizontal_angle, cos_horizontal_angle);
 
-      double const cos_vertical_angle = std::cos(from.v);
-      double const sin_vertical_angle = std::sin(from.v);
+      double sin_vertical_angle, cos_vertical_angle;
+      table.sinCos(from.v, sin_vertical_angle, cos_vertical_angle);
 
       // get the distance to the XY plane
       double xy_distance = from.d * cos_vertical_angle;
@@ -36,13 +36,14 @@ namespace quanergy
 
       PointCloudHVDIR const & cloud = *cloudPtr;
 
-      PointCloudHVDIRPtr resultPtr = PointCloudHVDIRPtr(new PointCloudHVDIR());
+      PointCloudHVDIRPtr resultPtr = common::makeCloud<PointCloudHVDIR>();
       
       PointCloudHVDIR & result = *resultPtr;
 
       result.header.stamp = cloud.header.stamp;
       result.header.seq = cloud.header.seq;
       result.header.frame_id = cloud.header.frame_id;
+      common::copyArrivalTime(cloudPtr, resultPtr);
 
       result.reserve(cloud.size());
 
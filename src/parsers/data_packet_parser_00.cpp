@@ -16,149 +16,210 @@ namespace quanergy
     {
       const PacketHeader* h = reinterpret_cast<const PacketHeader*>(packet.data());
 
-      return (deserialize(h->packet_type) == 0x00
-              && deserialize(h->version_major) == 0x00
-              && deserialize(h->version_minor) == 0x01
-              && deserialize(h->version_patch) == 0x00);
+      return makePacketKey(*h) == packetKey();
     }
 
     bool DataPacketParser00::parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result)
     {
-      // deserialize
-      DataPacket00 data_packet;
-      deserialize(packet.data(), data_packet);
+      // the return selection picks the instantiation, so the firing loops don't check it
+      switch (return_selection_)
+      {
+        case 0:
+          return parse<0>(packet, result);
+        case 1:
+          return parse<1>(packet, result);
+        case 2:
+          return parse<2>(packet, result);
+        default:
+          return parse<ALL_RETURNS>(packet, result);
+      }
+    }
+
+    void DataPacketParser00::prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared)
+    {
+      switch (return_selection_)
+      {
+        case 0:
+          prepare<0>(packet, prepared);
+          break;
+        case 1:
+          prepare<1>(packet, prepared);
+          break;
+        case 2:
+          prepare<2>(packet, prepared);
+          break;
+        default:
+          prepare<ALL_RETURNS>(packet, prepared);
+          break;
+      }
+    }
+
+    template <int RETURN>
+    bool DataPacketParser00::parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result)
+    {
+      // fields are deserialized as they are used, straight from the network buffer
+      const DataPacket00& data_packet = *reinterpret_cast<const DataPacket00*>(packet.data());
+
+      // throws error if status is fatal or the packet can't be parsed
+      PacketStart start;
+      decodeStart(data_packet, start);
+      startPacket(start);
+
+      // each firing is decoded straight into its final slot in the cloud under construction
+      CloudTarget target(*this, result);
+      decodeFirings<RETURN>(data_packet.data_body, target);
+
+      return target.resultUpdated();
+    }
 
-      // parse
-      bool result_updated = false;
+    template <int RETURN>
+    void DataPacketParser00::prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared)
+    {
+      const DataPacket00& data_packet = *reinterpret_cast<const DataPacket00*>(packet.data());
+      DecodedPacket& decoded = decodedPacket(prepared);
+
+      if (!decodeStart(data_packet, decoded))
+        return;
+
+      // the cloud a firing goes into isn't known until parsePrepared, so its points are kept here until then
+      decoded.organized = (RETURN != ALL_RETURNS);
+      DecodedTarget target(decoded);
+      decodeFirings<RETURN>(data_packet.data_body, target);
+    }
 
-      // throws error if status is fatal
-      validateStatus(static_cast<StatusType>(data_packet.data_body.status));
+    bool DataPacketParser00::decodeStart(const DataPacket00& data_packet, PacketStart& start) const
+    {
+      const MSeriesDataPacket& data_body = data_packet.data_body;
+
+      start.status = static_cast<StatusType>(deserialize(data_body.status));
 
       // check that vertical angles have been defined
       if (vertical_angle_lookup_table_.empty())
       {
-        throw InvalidVerticalAngles("In parse, the vertical angle lookup table is empty; need to call setVerticalAngles.");
+        start.error = std::make_exception_ptr(InvalidVerticalAngles(
+          "In parse, the vertical angle lookup table is empty; need to call setVerticalAngles."));
+        return false;
       }
 
-      // get the timestamp of the last point in the packet as 64 bit integer in units of microseconds
-      std::uint64_t current_packet_stamp_ms;
-      if (data_packet.data_body.version <= 3 && data_packet.data_body.version != 0)
-      {
-        // some versions of API put 10 ns increments in this field
-        current_packet_stamp_ms = static_cast<std::uint64_t>(data_packet.packet_header.seconds) * 1000000ull
-                               + static_cast<std::uint64_t>(data_packet.packet_header.nanoseconds) / 100ull;
-      }
-      else
-      {
-        current_packet_stamp_ms = static_cast<std::uint64_t>(data_packet.packet_header.seconds) * 1000000ull
-                               + static_cast<std::uint64_t>(data_packet.packet_header.nanoseconds) / 1000ull;
-      }
+      start.packet_stamp_ms = packetStamp(data_packet);
+      start.start_pos = deserialize(data_body.data[0].position);
+      start.mid_pos   = deserialize(data_body.data[M_SERIES_FIRING_PER_PKT/2].position);
+      start.end_pos   = deserialize(data_body.data[M_SERIES_FIRING_PER_PKT-1].position);
 
-      const auto& start = data_packet.data_body.data[0].position;
-      const auto& mid   = data_packet.data_body.data[M_SERIES_FIRING_PER_PKT/2].position;
-      const auto& end   = data_packet.data_body.data[M_SERIES_FIRING_PER_PKT-1].position;
-      registerNewPacket(current_packet_stamp_ms, start, mid, end);
+      return true;
+    }
 
-      double distance_scaling = 0.01;
-      if (data_packet.data_body.version >= 5)
-      {
-        distance_scaling = 0.00001;
-      }
+    template <int RETURN, typename TARGET>
+    void DataPacketParser00::decodeFirings(const MSeriesDataPacket& data_body, TARGET& target) const
+    {
+      static_assert(RETURN == ALL_RETURNS || (RETURN >= 0 && RETURN < M_SERIES_NUM_RETURNS),
+                    "return must be in the packet");
+
+      // the return decoded when not all are; in bounds for the all returns instantiation too
+      const int return_index = (RETURN == ALL_RETURNS) ? 0 : RETURN;
+
+      const double distance_scaling = (deserialize(data_body.version) >= 5) ? 0.00001 : 0.01;
 
       // for each firing
       for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
       {
-        const MSeriesFiringData &firing = data_packet.data_body.data[firing_index];
-        firing_cloud_->clear();
-        firing_cloud_->is_dense = true;
+        const MSeriesFiringData &firing = data_body.data[firing_index];
         PointCloudHVDIR::PointType hvdir;
 
-        // populate firing cloud
-        hvdir.h = horizontal_angle_lookup_table_[firing.position];
+        const std::uint16_t position = deserialize(firing.position);
+        hvdir.h = horizontal_angle_lookup_table_[position];
+
+        // firings outside the region of interest, or past a full cloud, are not decoded
+        if (!target.beginFiring(firing_index, hvdir.h, firingInRegion(position)))
+          continue;
 
-        // for each laser
-        for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; laser_index++)
+        if (RETURN == ALL_RETURNS)
         {
-          hvdir.v = vertical_angle_lookup_table_[laser_index];
-          hvdir.ring = laser_index;
+          auto& points = target.points();
+          const std::size_t first_point = points.size();
+          decodeAllReturns(firing, distance_scaling, hvdir, points);
 
-          if (return_selection_ == quanergy::client::ALL_RETURNS)
-          {
-            // for the all case, we won't keep NaN points and we'll compare
-            // distances to illiminate duplicates
-            // index 2 could equal index 0 and/or index 1
-            // index 1 could equal index 0 but only if all 3 are equal so don't need to check that as separate case
-            std::uint32_t dist2 = firing.returns_distances[2][laser_index];
-
-            std::uint32_t dist0 = firing.returns_distances[0][laser_index];
-            if (dist0 != 0 && dist0 != dist2)
-            {
-              hvdir.intensity = firing.returns_intensities[0][laser_index];
-              hvdir.d = static_cast<float>(dist0) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
-
-            std::uint32_t dist1 = firing.returns_distances[1][laser_index];
-            if (dist1 != 0 && dist1 != dist2)
-            {
-              hvdir.intensity = firing.returns_intensities[1][laser_index];
-              hvdir.d = static_cast<float>(dist1) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
-
-            if (dist2 != 0)
-            {
-              hvdir.intensity = firing.returns_intensities[2][laser_index];
-              hvdir.d = static_cast<float>(dist2) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
-
-          } // if (return_selection_ == quanergy::client::ALL_RETURNS)
-          else
-          {
-            // just want a single return case
-            hvdir.intensity = firing.returns_intensities[return_selection_][laser_index];
+          // add firing to scan; NaN points aren't kept
+          target.endFiring(firing_index, first_point, true);
+        }
+        else
+        {
+          // just want a single return case; missing returns and lasers outside the region are NaN
+          // if any range is NaN, the cloud is not dense
+          float ranges[M_SERIES_NUM_LASERS];
+          const bool firing_is_dense = maskRings(firing_decoder_.decode(firing.returns_distances[return_index],
+                                                                        distance_scaling, ranges),
+                                                 ranges) == FIRING_DECODER_ALL_LANES;
+
+          // add firing to scan, with each point going to its organized position
+          std::ptrdiff_t stride;
+          PointCloudHVDIR::PointType* slots = target.column(firing_index, firing_is_dense, stride);
+          writeLasers(hvdir, ranges, firing.returns_intensities[return_index], slots, stride);
+        }
+      }
+    }
 
-            if (firing.returns_distances[return_selection_][laser_index] == 0)
-            {
-              hvdir.d = std::numeric_limits<float>::quiet_NaN();
-              // if the range is NaN, the cloud is not dense
-              firing_cloud_->is_dense = false;
-            }
-            else
-            {
-              hvdir.d = static_cast<float>(firing.returns_distances[return_selection_][laser_index]) * distance_scaling; // convert range to meters
-            }
+    std::uint64_t DataPacketParser00::packetStamp(const DataPacket00& data_packet)
+    {
+      const std::uint16_t version = deserialize(data_packet.data_body.version);
+      const std::uint32_t seconds = deserialize(data_packet.packet_header.seconds);
+      const std::uint32_t nanoseconds = deserialize(data_packet.packet_header.nanoseconds);
 
-            // add the point to the current firing
-            firing_cloud_->push_back(hvdir);
+      // get the timestamp of the last point in the packet as 64 bit integer in units of microseconds
+      if (version <= 3 && version != 0)
+      {
+        // some versions of API put 10 ns increments in this field
+        return static_cast<std::uint64_t>(seconds) * 1000000ull
+               + static_cast<std::uint64_t>(nanoseconds) / 100ull;
+      }
 
-          } // else (return_selection_ != quanergy::client::ALL_RETURNS)
+      return static_cast<std::uint64_t>(seconds) * 1000000ull
+             + static_cast<std::uint64_t>(nanoseconds) / 1000ull;
+    }
 
-        } // for laser index
+    void DataPacketParser00::decodeAllReturns(const MSeriesFiringData& firing, double distance_scaling,
+                                              PointCloudHVDIR::PointType hvdir,
+                                              PointCloudHVDIR::VectorType& points) const
+    {
+      // ranges of the lasers for each return decoded; missing returns are NaN
+      float ranges[M_SERIES_NUM_RETURNS][M_SERIES_NUM_LASERS];
+
+      // for the all case, we won't keep NaN points and we'll compare
+      // distances to illiminate duplicates
+      // index 2 could equal index 0 and/or index 1
+      // index 1 could equal index 0 but only if all 3 are equal so don't need to check that as separate case
+      std::uint32_t keep[M_SERIES_NUM_RETURNS];
+      for (int return_index = 0; return_index < M_SERIES_NUM_RETURNS; ++return_index)
+      {
+        keep[return_index] = firing_decoder_.decode(firing.returns_distances[return_index],
+                                                    distance_scaling, ranges[return_index]);
+      }
+      keep[0] &= ~firing_decoder_.equal(firing.returns_distances[0], firing.returns_distances[2]);
+      keep[1] &= ~firing_decoder_.equal(firing.returns_distances[1], firing.returns_distances[2]);
 
-        // check whether cloud is complete
-        bool complete = checkComplete(hvdir.h, result);
+      // lasers outside the region of interest are left out
+      for (int return_index = 0; return_index < M_SERIES_NUM_RETURNS; ++return_index)
+      {
+        keep[return_index] &= ring_mask_;
+      }
 
-        // add firing to scan
-        addFiring(firing_cloud_);
+      // for each laser
+      for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; laser_index++)
+      {
+        hvdir.v = vertical_angle_lookup_table_[laser_index];
+        hvdir.ring = laser_index;
 
-        // organize if appropriate
-        if (complete && return_selection_ != quanergy::client::ALL_RETURNS)
+        for (int return_index = 0; return_index < M_SERIES_NUM_RETURNS; ++return_index)
         {
-          organizeCloud(result, M_SERIES_NUM_LASERS);
+          if (keep[return_index] & (1u << laser_index))
+          {
+            hvdir.intensity = firing.returns_intensities[return_index][laser_index];
+            hvdir.d = ranges[return_index][laser_index];
+            points.push_back(hvdir);
+          }
         }
-
-        result_updated = result_updated || complete;
-
-      } // for firing index
-
-      return result_updated;
-
-    } // parse
+      }
+    }
 
   } // namespace client
 
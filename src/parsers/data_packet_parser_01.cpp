@@ -7,8 +7,48 @@
 
 #include <quanergy/parsers/data_packet_parser_01.h>
 
+#include <algorithm>
+#include <cmath>
+
 #define RING_VERTICAL_ANGLE_RESOLUTION 0.1 * 3.14 / 180 //anything point closer in vertical angle that this are considered to still be the same ring
 
+namespace
+{
+  struct SinCos
+  {
+    double sin;
+    double cos;
+  };
+
+  /** sin and cos of every angle magnitude a DataPoint01 can carry, in 1/10,000 radians;
+   *  built once and shared by all parsers
+   */
+  const std::vector<SinCos>& angleTable()
+  {
+    static const std::vector<SinCos> table = []
+    {
+      std::vector<SinCos> ret(-static_cast<int>(std::numeric_limits<std::int16_t>::min()) + 1);
+      for (std::size_t i = 0; i < ret.size(); ++i)
+      {
+        const double angle = static_cast<double>(i) * 1E-4;
+        ret[i].sin = std::sin(angle);
+        ret[i].cos = std::cos(angle);
+      }
+      return ret;
+    }();
+
+    return table;
+  }
+
+  /// sin is odd and cos even, so the table only holds the magnitudes
+  inline void sinCos(const std::vector<SinCos>& table, std::int16_t angle, double& sin, double& cos)
+  {
+    const SinCos& entry = table[angle < 0 ? -static_cast<int>(angle) : angle];
+    sin = angle < 0 ? -entry.sin : entry.sin;
+    cos = entry.cos;
+  }
+}
+
 namespace quanergy
 {
   namespace client
@@ -22,76 +62,107 @@ namespace quanergy
     {
       const PacketHeader* h = reinterpret_cast<const PacketHeader*>(packet.data());
 
-      return (deserialize(h->packet_type) == 0x01
-              && deserialize(h->version_major) == 0x00
-              && deserialize(h->version_minor) == 0x01
-              && deserialize(h->version_patch) == 0x00);
+      return makePacketKey(*h) == packetKey();
     }
 
     bool DataPacketParser01::parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result)
     {
-      DataPacket01 data_packet;
-      deserialize(packet.data(), data_packet);
+      // points are read straight from the packet
+      DataPacket01View data_packet(packet.data());
 
-      result.reset(new PointCloudHVDIR());
+      result = common::makeCloud<PointCloudHVDIR>();
+      common::setArrivalTime(result, packet_arrival_ns_);
 
       // pcl pointcloud uses microseconds
       result->header.stamp =
-          std::uint64_t(data_packet.packet_header.seconds) * 1E6 +
-          std::uint64_t(data_packet.packet_header.nanoseconds) * 1E-3;
+          std::uint64_t(data_packet.packetHeader().seconds) * 1E6 +
+          std::uint64_t(data_packet.packetHeader().nanoseconds) * 1E-3;
 
-      result->header.seq = data_packet.data_header.sequence;
+      result->header.seq = data_packet.dataHeader().sequence;
       result->header.frame_id = frame_id_;
 
-      result->resize(data_packet.data_header.point_count);
+      result->resize(data_packet.size());
+
+      if (++packet_count_ == 0)
+      {
+        // the count wrapped; forget which packet the rings were assigned in
+        for (auto& ring_angle : ring_angles_)
+          ring_angle.packet = 0;
+        packet_count_ = 1;
+      }
+      packet_ring_angles_.clear();
 
-      int ring_num = 0;
-      std::map<float,int> ring_angles;
+      int ring_count = 0;
+      const std::vector<SinCos>& angle_table = angleTable();
 
       // intermediate angles and value
-      double H = 0;
-      double V = 0;
+      double sinH = 0;
       double cosH = 0;
+      double sinV = 0;
+      double cosV = 0;
 
-      for (unsigned int i = 0; i < data_packet.data_header.point_count; ++i)
+      for (unsigned int i = 0; i < data_packet.size(); ++i)
       {
-        DataPoint01 const & point = data_packet.data_points[i];
+        const DataPoint01 point = data_packet[i];
         PointCloudHVDIR::PointType& pc_point = result->points[i];
 
-        H = static_cast<double>(point.horizontal_angle) * 1E-4;
-        V = static_cast<double>(point.vertical_angle) * 1E-4;
+        sinCos(angle_table, point.horizontal_angle, sinH, cosH);
+        sinCos(angle_table, point.vertical_angle, sinV, cosV);
         pc_point.d = static_cast<double>(point.range) * 1E-6;
 
         // convert to standard HVDIR
-        cosH = std::cos(H);
-        pc_point.h = std::atan2(std::sin(H), cosH * std::cos(V));
-        pc_point.v = std::asin(cosH * std::sin(V));
+        pc_point.h = std::atan2(sinH, cosH * cosV);
+        pc_point.v = std::asin(cosH * sinV);
 
         pc_point.intensity = point.intensity;
+        pc_point.ring = ring(point.vertical_angle, ring_count);
+      }
 
-        if (ring_angles.count(V) == 0) //The V angles are the relatively constant ones for rings
-        {
-          //Check if there are any points on a ring with a very close vertical angle.  If so, give it the same ring number
-          bool ring_found = false;
-          for (auto ring_angle : ring_angles)
-          {
-            if (fabs(V - ring_angle.first) < RING_VERTICAL_ANGLE_RESOLUTION)
-            {
-              ring_angles[V] = ring_angle.second;
-              ring_found = true;
-              break;
-            }
-          }
-          if (!ring_found)
-          {
-            ring_angles[V] = ring_num++;
-          }
+      return true;
+    }
+
+    int DataPacketParser01::ring(std::int16_t vertical_angle, int& ring_count)
+    {
+      if (ring_angle_index_.empty())
+        ring_angle_index_.resize(std::numeric_limits<std::uint16_t>::max() + 1, 0);
+
+      std::uint32_t& index = ring_angle_index_[static_cast<std::uint16_t>(vertical_angle)];
+      if (index == 0)
+      {
+        ring_angles_.push_back({static_cast<float>(static_cast<double>(vertical_angle) * 1E-4), 0, 0});
+        index = ring_angles_.size();
+      }
+
+      RingAngle& ring_angle = ring_angles_[index - 1];
+      if (ring_angle.packet == packet_count_)
+        return ring_angle.ring;
 
+      // first point at this angle in the packet; the V angles are the relatively constant ones for rings
+      const double V = static_cast<double>(vertical_angle) * 1E-4;
+
+      //Check if there are any points on a ring with a very close vertical angle.  If so, give it the same ring number
+      bool ring_found = false;
+      for (std::uint32_t seen : packet_ring_angles_)
+      {
+        if (std::fabs(V - ring_angles_[seen].angle) < RING_VERTICAL_ANGLE_RESOLUTION)
+        {
+          ring_angle.ring = ring_angles_[seen].ring;
+          ring_found = true;
+          break;
         }
-        pc_point.ring = ring_angles[V];
       }
+      if (!ring_found)
+      {
+        ring_angle.ring = ring_count++;
+      }
+      ring_angle.packet = packet_count_;
 
-      return true;
+      auto position = std::upper_bound(packet_ring_angles_.begin(), packet_ring_angles_.end(), ring_angle.angle,
+                                       [this](float angle, std::uint32_t seen)
+                                       { return angle < ring_angles_[seen].angle; });
+      packet_ring_angles_.insert(position, index - 1);
+
+      return ring_angle.ring;
     }
   } // namespace client
 
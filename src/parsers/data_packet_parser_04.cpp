@@ -16,28 +16,50 @@ namespace quanergy
     {
       const PacketHeader* h = reinterpret_cast<const PacketHeader*>(packet.data());
 
-      return (deserialize(h->packet_type) == 0x04
-              && deserialize(h->version_major) == 0x00
-              && deserialize(h->version_minor) == 0x01
-              && deserialize(h->version_patch) == 0x00);
+      return makePacketKey(*h) == packetKey();
     }
 
-    bool DataPacketParser04::parse(const std::vector<char>& packet, PointCloudHVDIRPtr & result)
+    bool DataPacketParser04::parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result)
     {
-      // deserialize
-      DataPacket04 data_packet;
-      deserialize(packet.data(), data_packet);
+      // fields are deserialized as they are used, straight from the network buffer
+      const DataPacket04& data_packet = *reinterpret_cast<const DataPacket04*>(packet.data());
 
-      // parse
-      bool result_updated = false;
+      // throws error if status is fatal or the packet can't be parsed
+      PacketStart start;
+      decodeStart(data_packet, start);
+      startPacket(start);
 
-      // check status
-      validateStatus(static_cast<StatusType>(data_packet.data.data_header.status));
+      // each firing is decoded straight into its final slot in the cloud under construction
+      CloudTarget target(*this, result);
+      decodeFirings(data_packet, target);
+
+      return target.resultUpdated();
+    }
+
+    void DataPacketParser04::prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared)
+    {
+      const DataPacket04& data_packet = *reinterpret_cast<const DataPacket04*>(packet.data());
+      DecodedPacket& decoded = decodedPacket(prepared);
+
+      if (!decodeStart(data_packet, decoded))
+        return;
+
+      // the cloud a firing goes into isn't known until parsePrepared, so its points are kept here until then
+      decoded.organized = true;
+      DecodedTarget target(decoded);
+      decodeFirings(data_packet, target);
+    }
+
+    bool DataPacketParser04::decodeStart(const DataPacket04& data_packet, PacketStart& start) const
+    {
+      start.status = static_cast<StatusType>(deserialize(data_packet.data.data_header.status));
 
       // check that vertical angles have been defined
       if (vertical_angle_lookup_table_.empty())
       {
-        throw InvalidVerticalAngles("In parse, the vertical angle lookup table is empty; need to call setVerticalAngles.");
+        start.error = std::make_exception_ptr(InvalidVerticalAngles(
+          "In parse, the vertical angle lookup table is empty; need to call setVerticalAngles."));
+        return false;
       }
 
       // If the return selection has been explicitly set,
@@ -46,74 +68,51 @@ namespace quanergy
           return_selection_ != quanergy::client::ALL_RETURNS &&
           data_packet.data.data_header.return_id != return_selection_)
       {
-        throw ReturnIDMismatchError();
+        start.error = std::make_exception_ptr(ReturnIDMismatchError());
+        return false;
       }
 
       // this time is used for the cloud stamp which is a 64 bit integer in units of microseconds
-      std::uint64_t current_packet_stamp =
-        static_cast<std::uint64_t>(data_packet.packet_header.seconds) * 1000000ull +
-        static_cast<std::uint64_t>(data_packet.packet_header.nanoseconds) / 1000ull;
-
-      const auto& start = data_packet.data.firings[0].position;
-      const auto& mid   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT/2].position;
-      const auto& end   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT-1].position;
-      registerNewPacket(current_packet_stamp, start, mid, end);
+      start.packet_stamp_ms =
+        static_cast<std::uint64_t>(deserialize(data_packet.packet_header.seconds)) * 1000000ull +
+        static_cast<std::uint64_t>(deserialize(data_packet.packet_header.nanoseconds)) / 1000ull;
+      start.start_pos = deserialize(data_packet.data.firings[0].position);
+      start.mid_pos   = deserialize(data_packet.data.firings[M_SERIES_FIRING_PER_PKT/2].position);
+      start.end_pos   = deserialize(data_packet.data.firings[M_SERIES_FIRING_PER_PKT-1].position);
+
+      return true;
+    }
 
+    template <typename TARGET>
+    void DataPacketParser04::decodeFirings(const DataPacket04& data_packet, TARGET& target) const
+    {
       // Tens of micrometers.
-      double distance_scaling = 0.00001;
+      const double distance_scaling = 0.00001;
 
-      // for each firing
+      // a point per laser; missing returns and lasers outside the region are NaN
       for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
       {
         MSeriesFiringData04 const & firing = data_packet.data.firings[firing_index];
-        firing_cloud_->clear();
-        firing_cloud_->is_dense = true;
         PointCloudHVDIR::PointType hvdir;
 
-        // populate firing cloud
-        hvdir.h = horizontal_angle_lookup_table_[firing.position];
-
-        // for each laser
-        for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; laser_index++)
-        {
-          hvdir.v = vertical_angle_lookup_table_[laser_index];
-          hvdir.ring = laser_index;
-          hvdir.intensity = firing.intensity[laser_index];
-
-          if (firing.radius[laser_index] == 0)
-          {
-            hvdir.d = std::numeric_limits<float>::quiet_NaN();
-            // if the range is NaN, the cloud is not dense
-            firing_cloud_->is_dense = false;
-          }
-          else
-          {
-            hvdir.d = static_cast<float>(firing.radius[laser_index]) * distance_scaling; // convert range to meters
-          }
-
-          // add the point to the current firing
-          firing_cloud_->push_back(hvdir);
-
-        } // for laser index
+        const std::uint16_t position = deserialize(firing.position);
+        hvdir.h = horizontal_angle_lookup_table_[position];
 
-        // check whether cloud is complete
-        bool complete = checkComplete(hvdir.h, result);
-        // add firing to scan
-        addFiring(firing_cloud_);
+        // firings outside the region of interest, or past a full cloud, are not decoded
+        if (!target.beginFiring(firing_index, hvdir.h, firingInRegion(position)))
+          continue;
 
-        // organize if appropriate
-        if (complete)
-        {
-          organizeCloud(result, M_SERIES_NUM_LASERS);
-        }
+        // if any range is NaN, the cloud is not dense
+        float ranges[M_SERIES_NUM_LASERS];
+        const bool firing_is_dense =
+          maskRings(firing_decoder_.decode(firing.radius, distance_scaling, ranges), ranges) == FIRING_DECODER_ALL_LANES;
 
-        result_updated = result_updated || complete;
-
-      } // for firing index
-
-      return result_updated;
-
-    } // parse
+        // add firing to scan, with each point going to its organized position
+        std::ptrdiff_t stride;
+        PointCloudHVDIR::PointType* slots = target.column(firing_index, firing_is_dense, stride);
+        writeLasers(hvdir, ranges, firing.intensity, slots, stride);
+      }
+    }
 
   } // namespace client
 
@@ -16,10 +16,7 @@ namespace quanergy
     {
       const PacketHeader* h = reinterpret_cast<const PacketHeader*>(packet.data());
 
-      return (deserialize(h->packet_type) == 0x06
-              && deserialize(h->version_major) == 0x00
-              && deserialize(h->version_minor) == 0x01
-              && deserialize(h->version_patch) == 0x00);
+      return makePacketKey(*h) == packetKey();
 
     }
 
@@ -29,18 +26,63 @@ namespace quanergy
 
       const M1DataHeader* h = reinterpret_cast<const M1DataHeader*>(packet.data()+sizeof(PacketHeader));
 
+      // the return selection picks the instantiation, so the firing loops don't check it
       if (deserialize(h->return_id) == 3)
       {
-        retval = parse<3>(packet, result); 
+        switch (return_selection_)
+        {
+          case 0:
+            retval = parse<3, 0>(packet, result);
+            break;
+          case 1:
+            retval = parse<3, 1>(packet, result);
+            break;
+          case 2:
+            retval = parse<3, 2>(packet, result);
+            break;
+          default:
+            retval = parse<3, ALL_RETURNS>(packet, result);
+            break;
+        }
       }
       else
       {
-        retval = parse<1>(packet, result);
+        // the packet holds the selected return only
+        retval = parse<1, 0>(packet, result);
       }
 
       return retval;
     }
 
+    void DataPacketParser06::prepare(const std::vector<char>& packet, std::unique_ptr<PreparedPacket>& prepared)
+    {
+      const M1DataHeader* h = reinterpret_cast<const M1DataHeader*>(packet.data()+sizeof(PacketHeader));
+
+      if (deserialize(h->return_id) == 3)
+      {
+        switch (return_selection_)
+        {
+          case 0:
+            prepare<3, 0>(packet, prepared);
+            break;
+          case 1:
+            prepare<3, 1>(packet, prepared);
+            break;
+          case 2:
+            prepare<3, 2>(packet, prepared);
+            break;
+          default:
+            prepare<3, ALL_RETURNS>(packet, prepared);
+            break;
+        }
+      }
+      else
+      {
+        // the packet holds the selected return only
+        prepare<1, 0>(packet, prepared);
+      }
+    }
+
   } // namespace client
 
 } // namespace quanergy
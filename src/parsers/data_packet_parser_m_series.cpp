@@ -7,20 +7,19 @@
 
 #include <quanergy/parsers/data_packet_parser_m_series.h>
 
+#include <algorithm>
+
 namespace quanergy
 {
   namespace client
   {
 
     DataPacketParserMSeries::DataPacketParserMSeries()
-      : firing_cloud_(new PointCloudHVDIR())
-      , current_cloud_(new PointCloudHVDIR())
-      , worker_cloud_(new PointCloudHVDIR())
+      : current_cloud_(frame_pool_.acquire())
       , horizontal_angle_lookup_table_(M_SERIES_NUM_ROT_ANGLES+1)
     {
-      // Reserve space ahead of time for incoming data
-      current_cloud_->reserve(maximum_cloud_size_);
-      worker_cloud_->reserve(maximum_cloud_size_);
+      // space for incoming data is reserved by the pool once it has seen a frame
+      frame_pool_.setMaxReserve(maximum_cloud_size_);
 
       for (std::uint32_t i = 0; i <= M_SERIES_NUM_ROT_ANGLES; i++)
       {
@@ -44,6 +43,12 @@ namespace quanergy
         throw InvalidReturnSelection();
       }
 
+      // the layout of the cloud under construction depends on the selection; start over if it changes
+      if (return_selection != return_selection_ && currentCloudSize() > 0)
+      {
+        startCloud();
+      }
+
       return_selection_ = return_selection;
       return_selection_set_ = true;
     }
@@ -60,8 +65,15 @@ namespace quanergy
         minimum_cloud_size_ = std::max(1,szmin);
       if(szmax > 0)
         maximum_cloud_size_ = std::max(minimum_cloud_size_,szmax);
+
+      frame_pool_.setMaxReserve(maximum_cloud_size_);
     }
     
+    void DataPacketParserMSeries::setDecodeInstructionSet(DecodeInstructionSet instruction_set)
+    {
+      firing_decoder_ = FiringDecoder(instruction_set);
+    }
+
     void DataPacketParserMSeries::setDegreesOfSweepPerCloud(double degrees_per_cloud)
     {
       if ( degrees_per_cloud < 0 || degrees_per_cloud > 360.0 ) 
@@ -71,6 +83,15 @@ namespace quanergy
       angle_per_cloud_ = degrees_per_cloud*M_PI/180.;
     }
 
+    void DataPacketParserMSeries::setDegreesOfSweepPerSector(double degrees_per_sector)
+    {
+      if ( degrees_per_sector < 0 || degrees_per_sector > 360.0 )
+      {
+        throw InvalidDegreesPerCloud();
+      }
+      angle_per_sector_ = degrees_per_sector*M_PI/180.;
+    }
+
     void DataPacketParserMSeries::setVerticalAngles(const std::vector<double> &vertical_angles)
     {
       // this is only intended for M8/MQ8
@@ -102,6 +123,45 @@ namespace quanergy
       }
     }
 
+    void DataPacketParserMSeries::setRegionOfInterest(const std::vector<AzimuthInterval>& azimuth_intervals,
+                                                      std::uint8_t ring_mask)
+    {
+      std::vector<std::uint8_t> azimuth_in_region;
+
+      if (!azimuth_intervals.empty())
+      {
+        azimuth_in_region.assign(M_SERIES_NUM_ROT_ANGLES + 1, 0);
+
+        for (const auto& interval : azimuth_intervals)
+        {
+          if (interval.begin < 0 || interval.begin > M_SERIES_NUM_ROT_ANGLES ||
+              interval.end < 0 || interval.end > M_SERIES_NUM_ROT_ANGLES)
+          {
+            throw InvalidRegionOfInterest(std::string("Azimuth intervals must be within [0, ")
+                                          + std::to_string(M_SERIES_NUM_ROT_ANGLES)
+                                          + "]; got: " + std::to_string(interval.begin)
+                                          + "-" + std::to_string(interval.end));
+          }
+
+          // wrapping past the end of a revolution if need be
+          std::int32_t length = interval.end - interval.begin;
+          if (length < 0)
+            length += M_SERIES_NUM_ROT_ANGLES;
+
+          for (std::int32_t i = 0; i < length; ++i)
+          {
+            azimuth_in_region[(interval.begin + i) % M_SERIES_NUM_ROT_ANGLES] = 1;
+          }
+        }
+
+        // the position one revolution on is at the same angle
+        azimuth_in_region[M_SERIES_NUM_ROT_ANGLES] = azimuth_in_region[0];
+      }
+
+      azimuth_in_region_.swap(azimuth_in_region);
+      ring_mask_ = ring_mask;
+    }
+
     void DataPacketParserMSeries::validateStatus(const StatusType& status)
     {
       if (status != StatusType::GOOD)
@@ -163,7 +223,7 @@ namespace quanergy
     {
       bool result_updated = false;
 
-      bool cloudfull = (current_cloud_->size() >= maximum_cloud_size_);
+      bool cloudfull = currentCloudFull();
 
       // get swept angle
       double delta_angle = 0;
@@ -185,7 +245,11 @@ namespace quanergy
       if (delta_angle >= angle_per_cloud_ || (angle_per_cloud_==2*M_PI && (direction_*azimuth_angle < direction_*last_azimuth_)))
       {
         start_azimuth_ = azimuth_angle;
-        if (current_cloud_->size () > minimum_cloud_size_)
+
+        // the last sector ends with the cloud
+        emitSector();
+
+        if (currentCloudSize() > minimum_cloud_size_)
         {
           // we have a successful packet
 
@@ -195,107 +259,335 @@ namespace quanergy
                 << maximum_cloud_size_ << ") exceeded" << std::endl;
           }
 
-          // interpolate the timestamp from the previous packet timestamp to the timestamp of this firing
-          const double time_since_previous_packet_ms =
-              static_cast<double>((current_packet_stamp_ms_ - previous_packet_stamp_ms_) * firing_number_) 
-              / static_cast<double>(M_SERIES_FIRING_PER_PKT);
-          const std::uint64_t current_firing_stamp = previous_packet_stamp_ms_
-              + static_cast<std::uint64_t>(std::round(time_since_previous_packet_ms));
-
-          current_cloud_->header.stamp = current_firing_stamp;
+          current_cloud_->header.stamp = currentFiringStamp();
           current_cloud_->header.seq = cloud_counter_;
           current_cloud_->header.frame_id = frame_id_;
 
           ++cloud_counter_;
 
+          // the packet being parsed completed the cloud
+          common::setArrivalTime(current_cloud_, packet_arrival_ns_);
+
           // fire the signal that we have a new cloud
           result = current_cloud_;
-          // set the size which until organized is 1 x num_points
-          result->height = 1;
-          result->width = result->size();
+          if (row_stride_ != 0)
+          {
+            // organized as the points came in
+            compactRows();
+            result->height = M_SERIES_NUM_LASERS;
+            result->width = columns_;
+          }
+          else
+          {
+            result->height = 1;
+            result->width = result->size();
+          }
           result_updated = true;
+
+          // size the clouds to come after the ones we see
+          frame_pool_.observeFrameSize(result->size());
         }
-        else if(current_cloud_->size() > 0)
+        else if(currentCloudSize() > 0)
         {
           std::cout << "Warning: Minimum cloud size limit of (" << minimum_cloud_size_
-              << ") not reached (" << current_cloud_->size() << ")" << std::endl;
+              << ") not reached (" << currentCloudSize() << ")" << std::endl;
         }
 
-        // start a new cloud
-        current_cloud_.reset(new PointCloudHVDIR());
-        // at first we assume it is dense
-        current_cloud_->is_dense = true;
-        current_cloud_->reserve(maximum_cloud_size_);
+        startCloud();
         cloudfull = false;
       }
+      else if (angle_per_sector_ > 0.)
+      {
+        // sectors are counted from the start of the cloud
+        const std::size_t sector_index = static_cast<std::size_t>(delta_angle / angle_per_sector_);
+        if (sector_index > sector_index_)
+        {
+          emitSector();
+          sector_index_ = sector_index;
+        }
+      }
 
       last_azimuth_ = azimuth_angle;
 
       return result_updated;
     }
 
-    void DataPacketParserMSeries::addFiring(const PointCloudHVDIRPtr& firing_cloud)
+    bool DataPacketParserMSeries::firingsWithinCloud(const float* azimuth, int count, std::size_t points) const
     {
-      if (firing_cloud_->empty())
-        return;
+      // the first firing sets where the first cloud starts
+      if (cloud_counter_ == 0 && start_azimuth_ == 0)
+        return false;
 
-      bool cloudfull = (current_cloud_->size() >= maximum_cloud_size_);
+      if (currentCloudSize() + points > static_cast<std::size_t>(maximum_cloud_size_))
+        return false;
 
-      // if the cloud isn't full, add the firing
-      if (!cloudfull)
+      // firings turning the way the sensor spins, from the last one on, keep the 2*pi cloud going
+      // and sweep a growing angle, so the last firing sweeps furthest; else let checkComplete sort it out
+      bool turning = (angle_per_cloud_ != 2*M_PI || !(direction_*azimuth[0] < direction_*last_azimuth_));
+      for (int i = 1; i < count; ++i)
       {
-        ++firing_number_;
+        turning &= !(direction_*azimuth[i] < direction_*azimuth[i - 1]);
+      }
 
-        current_cloud_->points.insert(current_cloud_->points.end(),
-          firing_cloud->points.begin(), firing_cloud->points.end());
+      // the sweep of the first firing must not wrap for that
+      const double first_delta_angle = direction_ * (azimuth[0] - start_azimuth_);
+      if (!turning || first_delta_angle < 0.0)
+        return false;
 
-        current_cloud_->is_dense = current_cloud_->is_dense && firing_cloud->is_dense;
-      }
+      // the tests of checkComplete for the last firing
+      const double delta_angle = direction_ * (azimuth[count - 1] - start_azimuth_);
+
+      if (delta_angle >= angle_per_cloud_)
+        return false;
+
+      if (angle_per_sector_ > 0. && static_cast<std::size_t>(delta_angle / angle_per_sector_) > sector_index_)
+        return false;
+
+      return true;
     }
 
-    void DataPacketParserMSeries::organizeCloud(PointCloudHVDIRPtr& current_pc, 
-                                                unsigned int height)
+    void DataPacketParserMSeries::addFirings(int firings, bool firings_are_dense, float last_azimuth)
     {
-      if (height == 0 || current_pc->size() % height != 0)
+      firing_number_ += firings;
+
+      current_cloud_->is_dense = current_cloud_->is_dense && firings_are_dense;
+      sector_is_dense_ = sector_is_dense_ && firings_are_dense;
+
+      last_azimuth_ = last_azimuth;
+    }
+
+    void DataPacketParserMSeries::startCloud()
+    {
+      current_cloud_ = frame_pool_.acquire();
+      row_stride_ = 0;
+      columns_ = 0;
+
+      sector_index_ = 0;
+      sector_begin_ = 0;
+      sector_is_dense_ = true;
+    }
+
+    std::uint64_t DataPacketParserMSeries::currentFiringStamp() const
+    {
+      // interpolate the timestamp from the previous packet timestamp to the timestamp of this firing
+      const double time_since_previous_packet_ms =
+          static_cast<double>((current_packet_stamp_ms_ - previous_packet_stamp_ms_) * firing_number_)
+          / static_cast<double>(M_SERIES_FIRING_PER_PKT);
+
+      return previous_packet_stamp_ms_ + static_cast<std::uint64_t>(std::round(time_since_previous_packet_ms));
+    }
+
+    void DataPacketParserMSeries::emitSector()
+    {
+      // points for unorganized clouds, columns for organized ones
+      const std::size_t sector_end = (row_stride_ != 0) ? columns_ : current_cloud_->size();
+
+      if (sector_end > sector_begin_ && sector_signal_.num_slots() > 0)
       {
-        throw std::runtime_error("Can't organize cloud when size is not divisible by height");
+        PointCloudHVDIRPtr sector = sector_pool_.acquire();
+        const auto& points = current_cloud_->points;
+        const std::size_t width = sector_end - sector_begin_;
+
+        if (row_stride_ != 0)
+        {
+          sector->points.resize(width * M_SERIES_NUM_LASERS);
+          for (std::size_t row = 0; row < M_SERIES_NUM_LASERS; ++row)
+          {
+            auto begin = points.begin() + row * row_stride_ + sector_begin_;
+            std::copy(begin, begin + width, sector->points.begin() + row * width);
+          }
+
+          sector->height = M_SERIES_NUM_LASERS;
+          sector->width = width;
+        }
+        else
+        {
+          sector->points.assign(points.begin() + sector_begin_, points.begin() + sector_end);
+          sector->height = 1;
+          sector->width = width;
+        }
+
+        sector->is_dense = sector_is_dense_;
+        sector->header.stamp = currentFiringStamp();
+        sector->header.seq = sector_counter_;
+        sector->header.frame_id = frame_id_;
+
+        ++sector_counter_;
+
+        common::setArrivalTime(sector, packet_arrival_ns_);
+        sector_pool_.observeFrameSize(sector->size());
+
+        sector_signal_(sector);
       }
 
-      unsigned int width = current_pc->size() / height;
-      
-      // if height is 1, there is no need to transpose the cloud
-      if (height != 1)
+      sector_begin_ = sector_end;
+      sector_is_dense_ = true;
+    }
+
+    bool DataPacketParserMSeries::parsePrepared(const std::vector<char>& packet, PreparedPacket* prepared,
+                                                PointCloudHVDIRPtr& result)
+    {
+      const DecodedPacket* decoded = dynamic_cast<const DecodedPacket*>(prepared);
+      if (decoded && decoded->parser == this)
+        return parseDecoded(*decoded, result);
+
+      return parse(packet, result);
+    }
+
+    DataPacketParserMSeries::DecodedPacket& DataPacketParserMSeries::decodedPacket(
+      std::unique_ptr<PreparedPacket>& prepared) const
+    {
+      DecodedPacket* decoded = dynamic_cast<DecodedPacket*>(prepared.get());
+      if (!decoded)
       {
-        // transpose the cloud
-        worker_cloud_->clear();
+        decoded = new DecodedPacket();
+        prepared.reset(decoded);
+      }
 
-        worker_cloud_->header.stamp = current_pc->header.stamp;
-        worker_cloud_->header.seq = current_pc->header.seq;
-        worker_cloud_->header.frame_id = current_pc->header.frame_id;
+      decoded->parser = this;
+      decoded->error = nullptr;
+      decoded->organized = false;
+      decoded->points.clear();
+      decoded->first_point[0] = 0;
 
-        // reserve space
-        worker_cloud_->reserve(current_pc->size());
+      return *decoded;
+    }
 
-        unsigned int temp_index;
+    bool DataPacketParserMSeries::parseDecoded(const DecodedPacket& decoded, PointCloudHVDIRPtr& result)
+    {
+      startPacket(decoded);
 
-        // iterate through each ring from top down
-        for (int i = height - 1; i >= 0; --i)
+      // most packets fall within a cloud; their points go into it in one insert
+      if (!decoded.organized &&
+          firingsWithinCloud(decoded.azimuth, M_SERIES_FIRING_PER_PKT, decoded.points.size()))
+      {
+        int firings = 0;
+        bool firings_are_dense = true;
+        for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
         {
-          // iterate through width in collect order
-          for (unsigned int j = 0; j < width; ++j)
+          // as addFiring and skipFiring count them
+          if (decoded.first_point[firing_index + 1] != decoded.first_point[firing_index])
           {
-            // original data is in collect order and laser order
-            temp_index = j * height + i;
+            ++firings;
+            firings_are_dense = firings_are_dense && decoded.dense[firing_index];
+          }
+          else if (decoded.skipped[firing_index])
+          {
+            ++firings;
+          }
+        }
 
-            worker_cloud_->push_back(current_pc->points[temp_index]);
+        auto& points = current_cloud_->points;
+        points.insert(points.end(), decoded.points.begin(), decoded.points.end());
+        addFirings(firings, firings_are_dense, decoded.azimuth[M_SERIES_FIRING_PER_PKT - 1]);
+
+        return false;
+      }
+
+      bool result_updated = false;
+
+      for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
+      {
+        // check whether cloud is complete; the firing goes into the cloud after that
+        bool complete = checkComplete(decoded.azimuth[firing_index], result);
+
+        if (decoded.skipped[firing_index])
+        {
+          skipFiring();
+        }
+        else if (!currentCloudFull())
+        {
+          auto first = decoded.points.begin() + decoded.first_point[firing_index];
+
+          if (decoded.organized)
+          {
+            const std::size_t column = addColumn(decoded.dense[firing_index]);
+            for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; ++laser_index)
+            {
+              organizedPoint(column, laser_index) = first[laser_index];
+            }
+          }
+          else
+          {
+            auto& points = current_cloud_->points;
+            const std::size_t first_point = points.size();
+            points.insert(points.end(), first, decoded.points.begin() + decoded.first_point[firing_index + 1]);
+            addFiring(first_point, decoded.dense[firing_index]);
           }
         }
 
-        current_pc.swap(worker_cloud_);
+        result_updated = result_updated || complete;
+      }
+
+      return result_updated;
+    }
+
+    void DataPacketParserMSeries::startPacket(const PacketStart& start)
+    {
+      // throws error if status is fatal, then anything else wrong with the packet
+      validateStatus(start.status);
+      if (start.error)
+      {
+        std::rethrow_exception(start.error);
+      }
+
+      registerNewPacket(start.packet_stamp_ms, start.start_pos, start.mid_pos, start.end_pos);
+    }
+
+    void DataPacketParserMSeries::addFiring(std::size_t first_point, bool firing_is_dense)
+    {
+      if (current_cloud_->size() == first_point)
+        return;
+
+      ++firing_number_;
+
+      current_cloud_->is_dense = current_cloud_->is_dense && firing_is_dense;
+      sector_is_dense_ = sector_is_dense_ && firing_is_dense;
+    }
+
+    std::size_t DataPacketParserMSeries::addColumn(bool firing_is_dense)
+    {
+      auto& points = current_cloud_->points;
+
+      if (columns_ == row_stride_)
+      {
+        // first firing or more than predicted; the rows go further apart, last row first
+        std::size_t row_stride = std::max(row_stride_ * 2,
+          std::max(frame_pool_.reservePoints() / M_SERIES_NUM_LASERS, MIN_ROW_STRIDE));
+        points.resize(row_stride * M_SERIES_NUM_LASERS);
+
+        for (std::size_t row = M_SERIES_NUM_LASERS - 1; row > 0 && columns_ > 0; --row)
+        {
+          auto begin = points.begin() + row * row_stride_;
+          std::copy_backward(begin, begin + columns_, points.begin() + row * row_stride + columns_);
+        }
+
+        row_stride_ = row_stride;
+      }
+
+      ++firing_number_;
+
+      current_cloud_->is_dense = current_cloud_->is_dense && firing_is_dense;
+      sector_is_dense_ = sector_is_dense_ && firing_is_dense;
+
+      return columns_++;
+    }
+
+    void DataPacketParserMSeries::compactRows()
+    {
+      auto& points = current_cloud_->points;
+
+      // nothing moves when the prediction was right
+      if (columns_ != row_stride_)
+      {
+        for (std::size_t row = 1; row < M_SERIES_NUM_LASERS; ++row)
+        {
+          auto begin = points.begin() + row * row_stride_;
+          std::copy(begin, begin + columns_, points.begin() + row * columns_);
+        }
       }
 
-      current_pc->height = height;
-      current_pc->width  = width;
+      points.resize(columns_ * M_SERIES_NUM_LASERS);
     }
 
   } // namespace client
@@ -0,0 +1,232 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/parsers/firing_decoder.h>
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <quanergy/client/packet_header.h>
+
+// the SIMD kernels use per function target attributes and are picked at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define QUANERGY_HAS_X86_DECODE
+  #include <immintrin.h>
+#endif
+
+using namespace quanergy::client;
+
+namespace
+{
+  static_assert(FIRING_DECODER_LANES == 8, "the AVX2 kernels handle one register of lanes");
+
+  std::uint32_t decodeScalar(const void* radii, double scaling, float* ranges)
+  {
+    const char* bytes = static_cast<const char*>(radii);
+    std::uint32_t valid = 0;
+
+    for (int i = 0; i < FIRING_DECODER_LANES; ++i)
+    {
+      std::uint32_t radius;
+      std::memcpy(&radius, bytes + i * sizeof(radius), sizeof(radius));
+      radius = deserialize(radius);
+
+      if (radius == 0)
+      {
+        ranges[i] = std::numeric_limits<float>::quiet_NaN();
+      }
+      else
+      {
+        ranges[i] = static_cast<float>(radius) * scaling;
+        valid |= 1u << i;
+      }
+    }
+
+    return valid;
+  }
+
+  std::uint32_t equalScalar(const void* a, const void* b)
+  {
+    const char* a_bytes = static_cast<const char*>(a);
+    const char* b_bytes = static_cast<const char*>(b);
+    std::uint32_t ret = 0;
+
+    for (int i = 0; i < FIRING_DECODER_LANES; ++i)
+    {
+      if (std::memcmp(a_bytes + i * sizeof(std::uint32_t), b_bytes + i * sizeof(std::uint32_t),
+                      sizeof(std::uint32_t)) == 0)
+      {
+        ret |= 1u << i;
+      }
+    }
+
+    return ret;
+  }
+
+#ifdef QUANERGY_HAS_X86_DECODE
+  /** the float conversion of the unsigned radii must round like the scalar one; the halves
+   *  convert exactly and their sum is rounded once, which is what the scalar conversion does
+   */
+  __attribute__((target("sse4.1")))
+  __m128 toFloatSSE4(__m128i radii)
+  {
+    __m128 high = _mm_cvtepi32_ps(_mm_srli_epi32(radii, 16));
+    __m128 low = _mm_cvtepi32_ps(_mm_and_si128(radii, _mm_set1_epi32(0xFFFF)));
+    return _mm_add_ps(_mm_mul_ps(high, _mm_set1_ps(65536.f)), low);
+  }
+
+  __attribute__((target("sse4.1")))
+  std::uint32_t decodeSSE4(const void* radii, double scaling, float* ranges)
+  {
+    const __m128i swap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m128d scale = _mm_set1_pd(scaling);
+    const __m128 nan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+    const char* bytes = static_cast<const char*>(radii);
+    std::uint32_t none = 0;
+
+    for (int i = 0; i < FIRING_DECODER_LANES; i += 4)
+    {
+      __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i * sizeof(std::uint32_t)));
+      __m128 value = toFloatSSE4(_mm_shuffle_epi8(raw, swap));
+
+      // scale in double like the scalar expression, then round back to float
+      __m128 low = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(value), scale));
+      __m128 high = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(value, value)), scale));
+      __m128 range = _mm_movelh_ps(low, high);
+
+      __m128 zero = _mm_castsi128_ps(_mm_cmpeq_epi32(raw, _mm_setzero_si128()));
+      _mm_storeu_ps(ranges + i, _mm_blendv_ps(range, nan, zero));
+      none |= static_cast<std::uint32_t>(_mm_movemask_ps(zero)) << i;
+    }
+
+    return ~none & FIRING_DECODER_ALL_LANES;
+  }
+
+  __attribute__((target("sse4.1")))
+  std::uint32_t equalSSE4(const void* a, const void* b)
+  {
+    const char* a_bytes = static_cast<const char*>(a);
+    const char* b_bytes = static_cast<const char*>(b);
+    std::uint32_t ret = 0;
+
+    for (int i = 0; i < FIRING_DECODER_LANES; i += 4)
+    {
+      __m128i a_raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_bytes + i * sizeof(std::uint32_t)));
+      __m128i b_raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b_bytes + i * sizeof(std::uint32_t)));
+      ret |= static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a_raw, b_raw)))) << i;
+    }
+
+    return ret;
+  }
+
+  __attribute__((target("avx2")))
+  std::uint32_t decodeAVX2(const void* radii, double scaling, float* ranges)
+  {
+    const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256d scale = _mm256_set1_pd(scaling);
+
+    __m256i raw = _mm256_loadu_si256(static_cast<const __m256i*>(radii));
+    __m256i host = _mm256_shuffle_epi8(raw, swap);
+
+    // exact halves, rounded once when added (see toFloatSSE4)
+    __m256 high = _mm256_cvtepi32_ps(_mm256_srli_epi32(host, 16));
+    __m256 low = _mm256_cvtepi32_ps(_mm256_and_si256(host, _mm256_set1_epi32(0xFFFF)));
+    __m256 value = _mm256_add_ps(_mm256_mul_ps(high, _mm256_set1_ps(65536.f)), low);
+
+    // scale in double like the scalar expression, then round back to float
+    __m128 range_low = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(value)), scale));
+    __m128 range_high = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)), scale));
+    __m256 range = _mm256_insertf128_ps(_mm256_castps128_ps256(range_low), range_high, 1);
+
+    __m256 zero = _mm256_castsi256_ps(_mm256_cmpeq_epi32(raw, _mm256_setzero_si256()));
+    _mm256_storeu_ps(ranges, _mm256_blendv_ps(range, _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()), zero));
+
+    return ~static_cast<std::uint32_t>(_mm256_movemask_ps(zero)) & FIRING_DECODER_ALL_LANES;
+  }
+
+  __attribute__((target("avx2")))
+  std::uint32_t equalAVX2(const void* a, const void* b)
+  {
+    __m256i a_raw = _mm256_loadu_si256(static_cast<const __m256i*>(a));
+    __m256i b_raw = _mm256_loadu_si256(static_cast<const __m256i*>(b));
+    return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a_raw, b_raw))));
+  }
+#endif
+}
+
+std::ostream& quanergy::client::operator<<(std::ostream& os, DecodeInstructionSet instruction_set)
+{
+  switch (instruction_set)
+  {
+    case DecodeInstructionSet::SCALAR:
+      os << "scalar";
+      break;
+    case DecodeInstructionSet::SSE4:
+      os << "SSE4";
+      break;
+    case DecodeInstructionSet::AVX2:
+      os << "AVX2";
+      break;
+  }
+
+  return os;
+}
+
+bool FiringDecoder::isSupported(DecodeInstructionSet instruction_set)
+{
+  switch (instruction_set)
+  {
+    case DecodeInstructionSet::SCALAR:
+      return true;
+#ifdef QUANERGY_HAS_X86_DECODE
+    case DecodeInstructionSet::SSE4:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse4.1");
+    case DecodeInstructionSet::AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+DecodeInstructionSet FiringDecoder::detectInstructionSet()
+{
+  if (isSupported(DecodeInstructionSet::AVX2))
+    return DecodeInstructionSet::AVX2;
+  if (isSupported(DecodeInstructionSet::SSE4))
+    return DecodeInstructionSet::SSE4;
+
+  return DecodeInstructionSet::SCALAR;
+}
+
+FiringDecoder::FiringDecoder(DecodeInstructionSet instruction_set)
+  : instruction_set_(instruction_set)
+  , decode_(&decodeScalar)
+  , equal_(&equalScalar)
+{
+  if (!isSupported(instruction_set))
+  {
+    throw std::invalid_argument("FiringDecoder: instruction set not supported");
+  }
+
+#ifdef QUANERGY_HAS_X86_DECODE
+  if (instruction_set == DecodeInstructionSet::SSE4)
+  {
+    decode_ = &decodeSSE4;
+    equal_ = &equalSSE4;
+  }
+  else if (instruction_set == DecodeInstructionSet::AVX2)
+  {
+    decode_ = &decodeAVX2;
+    equal_ = &equalAVX2;
+  }
+#endif
+}
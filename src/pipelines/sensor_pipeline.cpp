@@ -41,11 +41,13 @@ namespace quanergy
         {
           std::cout << "Encoder calibration parameters provided will be applied" << std::endl;
           encoder_corrector.setParams(settings.amplitude, settings.phase);
+          fused_converter.setEncoderParams(settings.amplitude, settings.phase);
         }
         else if (device_info.amplitude() && device_info.phase())
         {
           std::cout << "Encoder calibration parameters from the sensor will be applied" << std::endl;
           encoder_corrector.setParams(*device_info.amplitude(), *device_info.phase());
+          fused_converter.setEncoderParams(*device_info.amplitude(), *device_info.phase());
         }
         else
         {
@@ -94,6 +96,8 @@ namespace quanergy
         settings.min_cloud_size,
         settings.max_cloud_size
       );
+      parser00.setDegreesOfSweepPerSector(settings.degrees_per_sector);
+      parser00.setRegionOfInterest(settings.roi_azimuth, settings.roi_ring_mask);
 
       // Parser 01
       parser01.setFrameId(settings.frame);
@@ -108,6 +112,8 @@ namespace quanergy
         settings.min_cloud_size,
         settings.max_cloud_size
       );
+      parser04.setDegreesOfSweepPerSector(settings.degrees_per_sector);
+      parser04.setRegionOfInterest(settings.roi_azimuth, settings.roi_ring_mask);
 
       // Parser 06
       parser06.setFrameId(settings.frame);
@@ -119,6 +125,11 @@ namespace quanergy
         settings.min_cloud_size,
         settings.max_cloud_size
       );
+      parser06.setDegreesOfSweepPerSector(settings.degrees_per_sector);
+      parser06.setRegionOfInterest(settings.roi_azimuth, settings.roi_ring_mask);
+
+      // decode batches of packets on multiple threads if requested
+      parser.setDecodeThreads(settings.decode_threads);
 
       // Filters
       // Distance Filter
@@ -136,7 +147,59 @@ namespace quanergy
         );
       }
 
+      // Fused converter; same filters, the ring filter only for m_series as in the separate modules
+      fused_converter.setMaximumDistanceThreshold(settings.max_distance);
+      fused_converter.setMinimumDistanceThreshold(settings.min_distance);
+
       if (m_series)
+      {
+        for (int i = 0; i < quanergy::client::M_SERIES_NUM_LASERS; ++i)
+        {
+          fused_converter.setRingFilterMinimumRangeThreshold(
+            i, settings.ring_range[i]
+          );
+          fused_converter.setRingFilterMinimumIntensityThreshold(
+            i, settings.ring_intensity[i]
+          );
+        }
+      }
+
+      if (settings.fused_conversion)
+      {
+        if (m_series && settings.calibrate)
+        {
+          // the corrector calculates the parameters from the parsed clouds and then corrects them in place
+          connections.push_back(
+            parser.connect(
+              [this](const ParserModule::ResultType& pc)
+              { encoder_corrector.slot(pc); }
+            )
+          );
+
+          connections.push_back(
+            encoder_corrector.connect(
+              [this](const quanergy::calibration::EncoderAngleCalibration::ResultType& pc)
+              { fused_converter.slot(pc); }
+            )
+          );
+        }
+        else
+        {
+          // Parser to Fused Converter
+          connections.push_back(
+            parser.connect(
+              [this](const ParserModule::ResultType& pc)
+              { fused_converter.slot(pc); }
+            )
+          );
+        }
+
+        // connect to an async module so downstream work happens on a separate thread
+        connections.push_back(fused_converter.connect(
+            [this](const quanergy::client::FusedPolarToCartConverter::ResultType& pc){ async.slot(pc); }
+        ));
+      }
+      else if (m_series)
       {
         // Connect modules for m_series
         // Parser to Encoder Corrector
@@ -190,10 +253,13 @@ namespace quanergy
         );
       }
 
-      // connect to an async module so downstream work happens on a separate thread
-      connections.push_back(cartesian_converter.connect(
-          [this](const quanergy::client::PolarToCartConverter::ResultType& pc){ async.slot(pc); }
-      ));
+      if (!settings.fused_conversion)
+      {
+        // connect to an async module so downstream work happens on a separate thread
+        connections.push_back(cartesian_converter.connect(
+            [this](const quanergy::client::PolarToCartConverter::ResultType& pc){ async.slot(pc); }
+        ));
+      }
     }
 
     SensorPipeline::~SensorPipeline()
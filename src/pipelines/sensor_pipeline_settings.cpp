@@ -6,6 +6,9 @@
  ****************************************************************/
 
 #include <quanergy/pipelines/sensor_pipeline_settings.h>
+#include <quanergy/common/range_list.h>
+
+#include <algorithm>
 
 #include <boost/lexical_cast.hpp>
 
@@ -56,6 +59,49 @@ std::string SensorPipelineSettings::stringFromReturn(int r)
   return ret;
 }
 
+std::vector<quanergy::client::AzimuthInterval> SensorPipelineSettings::azimuthIntervalsFromString(const std::string& intervals)
+{
+  std::vector<quanergy::client::AzimuthInterval> ret;
+
+  for (const auto& range : quanergy::common::rangesFromString(intervals, true, "Invalid azimuth intervals"))
+  {
+    if (range.first > quanergy::client::M_SERIES_NUM_ROT_ANGLES ||
+        range.second > quanergy::client::M_SERIES_NUM_ROT_ANGLES)
+    {
+      throw std::invalid_argument("Invalid azimuth intervals");
+    }
+
+    ret.push_back({range.first, range.second});
+  }
+
+  return ret;
+}
+
+std::uint8_t SensorPipelineSettings::ringMaskFromString(const std::string& rings)
+{
+  auto ranges = quanergy::common::rangesFromString(rings, false, "Invalid ring list");
+  if (ranges.empty())
+  {
+    return quanergy::client::ALL_RINGS;
+  }
+
+  std::uint8_t ret = 0;
+  for (const auto& range : ranges)
+  {
+    if (range.second < range.first || range.second >= quanergy::client::M_SERIES_NUM_LASERS)
+    {
+      throw std::invalid_argument("Invalid ring list");
+    }
+
+    for (int ring = range.first; ring <= range.second; ++ring)
+    {
+      ret |= static_cast<std::uint8_t>(1u << ring);
+    }
+  }
+
+  return ret;
+}
+
 void SensorPipelineSettings::load(const SettingsFileLoader& settings)
 {
   host = settings.get("Settings.host", host);
@@ -81,6 +127,21 @@ void SensorPipelineSettings::load(const SettingsFileLoader& settings)
   min_cloud_size = settings.get("Settings.minCloudSize", min_cloud_size);
   max_cloud_size = settings.get("Settings.maxCloudSize", max_cloud_size);
 
+  decode_threads = settings.get("Settings.decodeThreads", decode_threads);
+
+  degrees_per_sector = settings.get("Settings.degreesPerSector", degrees_per_sector);
+
+  fused_conversion = settings.get("Settings.fusedConversion", fused_conversion);
+
+  /// region of interest only relevant for M-series
+  auto azimuth = settings.get_optional<std::string>("Settings.RegionOfInterest.azimuth");
+  if (azimuth)
+    roi_azimuth = azimuthIntervalsFromString(*azimuth);
+
+  auto rings = settings.get_optional<std::string>("Settings.RegionOfInterest.rings");
+  if (rings)
+    roi_ring_mask = ringMaskFromString(*rings);
+
   /// ring filter settings only relevant for M-series
   for (int i = 0; i < quanergy::client::M_SERIES_NUM_LASERS; i++)
   {
@@ -93,4 +154,27 @@ void SensorPipelineSettings::load(const SettingsFileLoader& settings)
     ring_intensity[i] = settings.get(intensity_param, ring_intensity[i]);
   }
 
+  client_options.receive_buffer_size = settings.get("Settings.Client.receiveBufferSize", client_options.receive_buffer_size);
+  client_options.tcp_no_delay = settings.get("Settings.Client.tcpNoDelay", client_options.tcp_no_delay);
+  client_options.busy_poll = settings.get("Settings.Client.busyPoll", client_options.busy_poll);
+  client_options.kernel_timestamps = settings.get("Settings.Client.kernelTimestamps", client_options.kernel_timestamps);
+
+  /// thread settings for the thread calling run and the signal thread
+  const std::pair<const char*, quanergy::client::ThreadOptions*> threads[] = {
+    {"Settings.Client.IOThread.", &client_options.io_thread},
+    {"Settings.Client.SignalThread.", &client_options.signal_thread}};
+
+  for (const auto& thread : threads)
+  {
+    auto cpus = settings.get_optional<std::string>(std::string(thread.first).append("cpus"));
+    if (cpus)
+      thread.second->cpus = quanergy::client::TCPClientOptions::cpusFromString(*cpus);
+
+    auto policy = settings.get_optional<std::string>(std::string(thread.first).append("policy"));
+    if (policy)
+      thread.second->policy = quanergy::client::TCPClientOptions::policyFromString(*policy);
+
+    thread.second->priority = settings.get(std::string(thread.first).append("priority"), thread.second->priority);
+  }
+
 }
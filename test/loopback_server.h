@@ -0,0 +1,180 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file loopback_server.h
+ *
+ *  \brief Serves scripted bytes on a loopback port and collects what a client signals, for tests
+ */
+
+#ifndef QUANERGY_TEST_LOOPBACK_SERVER_H
+#define QUANERGY_TEST_LOOPBACK_SERVER_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+
+#include <boost/asio.hpp>
+
+#include <quanergy/client/packet_header.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /// build a packet with a valid header and a body recognizable by its sequence number
+    inline std::vector<char> makePacket(std::uint32_t size, std::uint32_t sequence, std::uint8_t packet_type = 0x00)
+    {
+      std::vector<char> packet(size, 0);
+
+      client::PacketHeader header;
+      header.signature     = htonl(client::SIGNATURE);
+      header.size          = htonl(size);
+      header.seconds       = htonl(sequence);
+      header.nanoseconds   = 0;
+      header.version_major = 0;
+      header.version_minor = 1;
+      header.version_patch = 0;
+      header.packet_type   = packet_type;
+      std::memcpy(packet.data(), &header, sizeof(header));
+
+      for (std::size_t i = sizeof(header); i < size; ++i)
+        packet[i] = static_cast<char>(sequence * 7 + i);
+
+      return packet;
+    }
+
+    /** \brief LoopbackServer accepts connections and writes scripted chunks to each
+     *  \details Chunks are written with a pause in between so each tends to arrive in a read of
+     *           its own. After the last chunk the connection is held open until the client closes
+     *           it, so the client decides when the stream ends.
+     */
+    class LoopbackServer
+    {
+    public:
+      typedef std::vector<std::vector<char>> Chunks;
+
+      LoopbackServer()
+        : acceptor_(io_service_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+      {
+      }
+
+      ~LoopbackServer()
+      {
+        join();
+      }
+
+      std::string port() const
+      {
+        return std::to_string(acceptor_.local_endpoint().port());
+      }
+
+      /// serve one connection on a separate thread
+      void serve(const Chunks& chunks, std::chrono::milliseconds pause = std::chrono::milliseconds(5))
+      {
+        serve(std::vector<Chunks>(1, chunks), pause);
+      }
+
+      /// serve a connection per entry, one after the other; an empty entry closes on accept
+      void serve(const std::vector<Chunks>& connections, std::chrono::milliseconds pause = std::chrono::milliseconds(5))
+      {
+        thread_ = std::thread([this, connections, pause]
+        {
+          for (const auto& chunks : connections)
+          {
+            boost::asio::ip::tcp::socket socket(io_service_);
+            boost::system::error_code error;
+            acceptor_.accept(socket, error);
+            if (error)
+              return;
+
+            {
+              std::lock_guard<std::mutex> lk(mutex_);
+              ++accepted_;
+            }
+
+            if (chunks.empty())
+              continue;
+
+            socket.set_option(boost::asio::ip::tcp::no_delay(true), error);
+            for (const auto& chunk : chunks)
+            {
+              boost::asio::write(socket, boost::asio::buffer(chunk), error);
+              if (error)
+                break;
+
+              std::this_thread::sleep_for(pause);
+            }
+
+            // wait for the client to hang up
+            char byte;
+            while (!error)
+              socket.read_some(boost::asio::buffer(&byte, 1), error);
+          }
+        });
+      }
+
+      /// number of connections accepted so far
+      std::size_t accepted() const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return accepted_;
+      }
+
+      void join()
+      {
+        if (thread_.joinable())
+          thread_.join();
+      }
+
+    private:
+      boost::asio::io_service         io_service_;
+      boost::asio::ip::tcp::acceptor  acceptor_;
+      std::thread                     thread_;
+      mutable std::mutex              mutex_;
+      std::size_t                     accepted_ = 0;
+    };
+
+    /** \brief PacketCollector keeps copies of the packets a client signals */
+    class PacketCollector
+    {
+    public:
+      void operator()(const std::shared_ptr<std::vector<char>>& packet)
+      {
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          packets_.push_back(*packet);
+        }
+        cond_.notify_all();
+      }
+
+      /// wait until at least count packets arrived; false on timeout
+      bool waitFor(std::size_t count, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+      {
+        std::unique_lock<std::mutex> lk(mutex_);
+        return cond_.wait_for(lk, timeout, [this, count]{return (packets_.size() >= count);});
+      }
+
+      std::vector<std::vector<char>> packets() const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return packets_;
+      }
+
+    private:
+      mutable std::mutex              mutex_;
+      std::condition_variable         cond_;
+      std::vector<std::vector<char>>  packets_;
+    };
+
+  }/** end test namespace */
+}/** end quanergy namespace */
+
+#endif
@@ -0,0 +1,252 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/common/bounded_queue.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks the BoundedQueue limits, each backpressure policy and the drop statistics. */
+    class TestBoundedQueue : public ::testing::Test
+    {
+    public:
+      typedef common::BoundedQueue<int> QueueType;
+
+      TestBoundedQueue()
+      {
+      }
+
+      virtual ~TestBoundedQueue()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      /// take everything queued, in order
+      std::vector<int> drain(QueueType& queue)
+      {
+        std::vector<int> items;
+        std::deque<QueueType::Entry> entries;
+        if (queue.tryPopAll(entries))
+        {
+          for (const auto& entry : entries)
+            items.push_back(entry.item);
+        }
+
+        return items;
+      }
+
+      /// wait until the queue reports a producer waiting, or give up after a second
+      void waitForBlock(QueueType& queue, std::uint64_t count)
+      {
+        for (int i = 0; i < 1000 && queue.statistics().blocked_count < count; ++i)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    };
+
+    TEST_F(TestBoundedQueue, Test_dropOldest)
+    {
+      QueueType queue(3);
+
+      for (int i = 0; i < 5; ++i)
+        EXPECT_TRUE(queue.push(i, 10));
+
+      EXPECT_EQ(3u, queue.size());
+      EXPECT_EQ(std::vector<int>({2, 3, 4}), drain(queue));
+      EXPECT_EQ(2u, queue.statistics().dropped_items);
+      EXPECT_EQ(20u, queue.statistics().dropped_bytes);
+      EXPECT_EQ(0u, queue.statistics().dropped_frames);
+      EXPECT_EQ(0u, queue.statistics().blocked_count);
+    }
+
+    TEST_F(TestBoundedQueue, Test_dropNewest)
+    {
+      QueueType queue(2, 0, common::BackpressurePolicy::DROP_NEWEST);
+
+      EXPECT_TRUE(queue.push(0, 10));
+      EXPECT_TRUE(queue.push(1, 10));
+      EXPECT_FALSE(queue.push(2, 7));
+
+      EXPECT_EQ(std::vector<int>({0, 1}), drain(queue));
+      EXPECT_EQ(1u, queue.statistics().dropped_items);
+      EXPECT_EQ(7u, queue.statistics().dropped_bytes);
+
+      // room again once the consumer has taken the items
+      EXPECT_TRUE(queue.push(3, 10));
+      EXPECT_EQ(std::vector<int>({3}), drain(queue));
+    }
+
+    TEST_F(TestBoundedQueue, Test_blockProducer)
+    {
+      QueueType queue(1, 0, common::BackpressurePolicy::BLOCK_PRODUCER);
+      ASSERT_TRUE(queue.push(0));
+
+      bool pushed = false;
+      std::thread producer([&]{ pushed = queue.push(1); });
+      waitForBlock(queue, 1);
+      EXPECT_EQ(1u, queue.size());
+
+      int item = -1;
+      EXPECT_TRUE(queue.pop(item));
+      EXPECT_EQ(0, item);
+      producer.join();
+
+      EXPECT_TRUE(pushed);
+      EXPECT_TRUE(queue.pop(item));
+      EXPECT_EQ(1, item);
+      EXPECT_EQ(1u, queue.statistics().blocked_count);
+      EXPECT_EQ(0u, queue.statistics().dropped_items);
+    }
+
+    TEST_F(TestBoundedQueue, Test_raisingLimitReleasesProducer)
+    {
+      QueueType queue(1, 0, common::BackpressurePolicy::BLOCK_PRODUCER);
+      ASSERT_TRUE(queue.push(0));
+
+      bool pushed = false;
+      std::thread producer([&]{ pushed = queue.push(1); });
+      waitForBlock(queue, 1);
+
+      queue.setMaxItems(2);
+      producer.join();
+
+      EXPECT_TRUE(pushed);
+      EXPECT_EQ(2u, queue.getMaxItems());
+      EXPECT_EQ(std::vector<int>({0, 1}), drain(queue));
+    }
+
+    TEST_F(TestBoundedQueue, Test_byteLimit)
+    {
+      QueueType queue(10, 100, common::BackpressurePolicy::DROP_NEWEST);
+
+      EXPECT_TRUE(queue.push(0, 60));
+      EXPECT_FALSE(queue.push(1, 50));
+      EXPECT_TRUE(queue.push(2, 40));
+      EXPECT_EQ(std::vector<int>({0, 2}), drain(queue));
+      EXPECT_EQ(1u, queue.statistics().dropped_items);
+      EXPECT_EQ(50u, queue.statistics().dropped_bytes);
+
+      // an empty queue takes an item larger than the limit
+      EXPECT_TRUE(queue.push(3, 150));
+      EXPECT_FALSE(queue.push(4, 1));
+      EXPECT_EQ(std::vector<int>({3}), drain(queue));
+
+      // under DROP_OLDEST the byte limit trims the front
+      queue.setPolicy(common::BackpressurePolicy::DROP_OLDEST);
+      queue.statistics().reset();
+      EXPECT_TRUE(queue.push(5, 60));
+      EXPECT_TRUE(queue.push(6, 30));
+      EXPECT_TRUE(queue.push(7, 30));
+      EXPECT_EQ(std::vector<int>({6, 7}), drain(queue));
+      EXPECT_EQ(1u, queue.statistics().dropped_items);
+      EXPECT_EQ(60u, queue.statistics().dropped_bytes);
+
+      // 0 disables the byte limit
+      queue.setMaxBytes(0);
+      EXPECT_EQ(0u, queue.getMaxBytes());
+      EXPECT_TRUE(queue.push(8, 1000));
+      EXPECT_TRUE(queue.push(9, 1000));
+      EXPECT_EQ(2u, queue.size());
+    }
+
+    TEST_F(TestBoundedQueue, Test_dropWholeFrame)
+    {
+      QueueType queue(4, 0, common::BackpressurePolicy::DROP_WHOLE_FRAME);
+
+      // frame 0 fits, frame 1 overflows on its second item
+      EXPECT_TRUE(queue.push(0, 1, true));
+      EXPECT_TRUE(queue.push(1, 1, false));
+      EXPECT_TRUE(queue.push(2, 1, false));
+      EXPECT_TRUE(queue.push(10, 1, true));
+      EXPECT_FALSE(queue.push(11, 1, false));
+
+      // the queued start of frame 1 went with it and the rest of frame 1 is dropped
+      EXPECT_EQ(3u, queue.size());
+      EXPECT_FALSE(queue.push(12, 1, false));
+      EXPECT_EQ(3u, queue.statistics().dropped_items);
+      EXPECT_EQ(1u, queue.statistics().dropped_frames);
+
+      // the next frame start is accepted
+      EXPECT_TRUE(queue.push(20, 1, true));
+      EXPECT_EQ(std::vector<int>({0, 1, 2, 20}), drain(queue));
+    }
+
+    TEST_F(TestBoundedQueue, Test_dropWholeFrameAtStart)
+    {
+      QueueType queue(2, 0, common::BackpressurePolicy::DROP_WHOLE_FRAME);
+
+      EXPECT_TRUE(queue.push(0, 1, true));
+      EXPECT_TRUE(queue.push(1, 1, false));
+
+      // a frame start that does not fit is dropped on its own, then the rest of its frame
+      EXPECT_FALSE(queue.push(10, 1, true));
+      EXPECT_EQ(std::vector<int>({0, 1}), drain(queue));
+      EXPECT_FALSE(queue.push(11, 1, false));
+      EXPECT_EQ(0u, queue.size());
+      EXPECT_EQ(2u, queue.statistics().dropped_items);
+      EXPECT_EQ(1u, queue.statistics().dropped_frames);
+
+      EXPECT_TRUE(queue.push(20, 1, true));
+      EXPECT_EQ(std::vector<int>({20}), drain(queue));
+    }
+
+    TEST_F(TestBoundedQueue, Test_closeReleasesWaiters)
+    {
+      QueueType queue(1, 0, common::BackpressurePolicy::BLOCK_PRODUCER);
+
+      int item = -1;
+      bool popped = true;
+      std::thread consumer([&]{ popped = queue.pop(item); });
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      queue.close();
+      consumer.join();
+      EXPECT_FALSE(popped);
+      EXPECT_FALSE(queue.push(0));
+
+      queue.open();
+      ASSERT_TRUE(queue.push(0));
+      bool pushed = true;
+      std::thread producer([&]{ pushed = queue.push(1); });
+      waitForBlock(queue, 1);
+      queue.close();
+      producer.join();
+      EXPECT_FALSE(pushed);
+      EXPECT_EQ(1u, queue.statistics().blocked_count);
+
+      // open discards what was queued without counting it as dropped
+      queue.open();
+      EXPECT_EQ(0u, queue.size());
+      EXPECT_EQ(0u, queue.statistics().dropped_items);
+    }
+
+    TEST_F(TestBoundedQueue, Test_statisticsReset)
+    {
+      QueueType queue(1, 0, common::BackpressurePolicy::DROP_NEWEST);
+      queue.push(0, 5);
+      queue.push(1, 5);
+      EXPECT_EQ(1u, queue.statistics().dropped_items);
+
+      queue.statistics().reset();
+      EXPECT_EQ(0u, queue.statistics().dropped_items);
+      EXPECT_EQ(0u, queue.statistics().dropped_bytes);
+      EXPECT_EQ(0u, queue.statistics().dropped_frames);
+      EXPECT_EQ(0u, queue.statistics().blocked_count);
+      EXPECT_EQ(0u, queue.statistics().blocked_ns);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
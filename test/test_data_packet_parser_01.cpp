@@ -0,0 +1,216 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/parsers/data_packet_parser_01.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks DataPacketParser01 against the per point conversion and per packet
+     *         ring numbering it is specified by.
+     */
+    class TestDataPacketParser01 : public ::testing::Test
+    {
+    public:
+
+      TestDataPacketParser01()
+      {
+      }
+
+      virtual ~TestDataPacketParser01()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      // one packet 0x01 in network order
+      std::vector<char> packet01(std::uint32_t sequence, const std::vector<client::DataPoint01>& points)
+      {
+        std::vector<char> ret(sizeof(client::PacketHeader) + sizeof(client::DataHeader01)
+                              + points.size() * sizeof(client::DataPoint01));
+
+        client::PacketHeader& header = *reinterpret_cast<client::PacketHeader*>(ret.data());
+        header.signature = htonl(client::SIGNATURE);
+        header.size = htonl(ret.size());
+        header.seconds = htonl(1000);
+        header.nanoseconds = htonl(sequence * 1000);
+        header.version_major = 0;
+        header.version_minor = 1;
+        header.version_patch = 0;
+        header.packet_type = 0x01;
+
+        client::DataHeader01& data_header =
+          *reinterpret_cast<client::DataHeader01*>(ret.data() + sizeof(client::PacketHeader));
+        data_header.sequence = htonl(sequence);
+        data_header.status = 0;
+        data_header.point_count = htonl(points.size());
+        data_header.reserved = 0;
+
+        client::DataPoint01* data_points = reinterpret_cast<client::DataPoint01*>(
+          ret.data() + sizeof(client::PacketHeader) + sizeof(client::DataHeader01));
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+          data_points[i].horizontal_angle = htons(points[i].horizontal_angle);
+          data_points[i].vertical_angle = htons(points[i].vertical_angle);
+          data_points[i].range = htonl(points[i].range);
+          data_points[i].intensity = htons(points[i].intensity);
+          data_points[i].status = points[i].status;
+          data_points[i].reserved = 0;
+        }
+
+        return ret;
+      }
+
+      // the conversion the parser is specified by, with trig per point and rings numbered through a map
+      std::vector<PointHVDIR> reference(const std::vector<client::DataPoint01>& points)
+      {
+        std::vector<PointHVDIR> ret(points.size());
+        std::map<float, int> ring_angles;
+        int ring_num = 0;
+
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+          double H = static_cast<double>(points[i].horizontal_angle) * 1E-4;
+          double V = static_cast<double>(points[i].vertical_angle) * 1E-4;
+          ret[i].d = static_cast<double>(points[i].range) * 1E-6;
+
+          double cosH = std::cos(H);
+          ret[i].h = std::atan2(std::sin(H), cosH * std::cos(V));
+          ret[i].v = std::asin(cosH * std::sin(V));
+          ret[i].intensity = points[i].intensity;
+
+          if (ring_angles.count(V) == 0)
+          {
+            bool ring_found = false;
+            for (auto ring_angle : ring_angles)
+            {
+              if (std::fabs(V - ring_angle.first) < 0.1 * 3.14 / 180)
+              {
+                ring_angles[V] = ring_angle.second;
+                ring_found = true;
+                break;
+              }
+            }
+            if (!ring_found)
+            {
+              ring_angles[V] = ring_num++;
+            }
+          }
+          ret[i].ring = ring_angles[V];
+        }
+
+        return ret;
+      }
+    };
+
+    TEST_F(TestDataPacketParser01, Test_parse)
+    {
+      // rings a little apart with jitter of a few counts, visited in a different order each packet
+      const std::vector<std::int16_t> ring_angles = {-2200, -1000, -300, 0, 15, 400, 2500, 31000};
+
+      std::default_random_engine engine;
+      std::uniform_int_distribution<int> jitter(-12, 12);
+      std::uniform_int_distribution<int> horizontal(-31416, 31416);
+      std::uniform_int_distribution<std::uint32_t> range(0, 200000000);
+
+      client::DataPacketParser01 parser;
+
+      for (std::uint32_t sequence = 0; sequence < 50; ++sequence)
+      {
+        std::vector<std::int16_t> order = ring_angles;
+        std::shuffle(order.begin(), order.end(), engine);
+        order.resize(1 + sequence % order.size());
+
+        std::vector<client::DataPoint01> points(1000);
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+          points[i].horizontal_angle = static_cast<std::int16_t>(horizontal(engine));
+          points[i].vertical_angle = static_cast<std::int16_t>(order[i % order.size()] + jitter(engine));
+          points[i].range = range(engine);
+          points[i].intensity = static_cast<std::uint16_t>(i);
+          points[i].status = 0;
+        }
+        // the extremes of the angle range
+        points[0].horizontal_angle = -32768;
+        points[1].horizontal_angle = 32767;
+
+        auto packet = packet01(sequence, points);
+        ASSERT_TRUE(parser.validate(packet));
+
+        PointCloudHVDIRPtr cloud;
+        ASSERT_TRUE(parser.parse(packet, cloud));
+        ASSERT_EQ(cloud->header.seq, sequence);
+
+        auto expected = reference(points);
+        ASSERT_EQ(cloud->size(), expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+          const PointHVDIR& point = cloud->points[i];
+          EXPECT_EQ(std::memcmp(&point.h, &expected[i].h, sizeof(float)), 0) << sequence << " " << i;
+          EXPECT_EQ(std::memcmp(&point.v, &expected[i].v, sizeof(float)), 0) << sequence << " " << i;
+          EXPECT_EQ(point.d, expected[i].d);
+          EXPECT_EQ(point.intensity, expected[i].intensity);
+          ASSERT_EQ(point.ring, expected[i].ring) << sequence << " " << i;
+        }
+      }
+    }
+
+    TEST_F(TestDataPacketParser01, Test_view)
+    {
+      // the view reads the same packet as the full deserialize, without copying the points
+      std::vector<client::DataPoint01> points(5);
+      for (std::size_t i = 0; i < points.size(); ++i)
+      {
+        points[i].horizontal_angle = static_cast<std::int16_t>(-1000 * i);
+        points[i].vertical_angle = static_cast<std::int16_t>(10 * i);
+        points[i].range = 1000000 + i;
+        points[i].intensity = static_cast<std::uint16_t>(300 + i);
+        points[i].status = static_cast<std::uint8_t>(i);
+      }
+
+      auto packet = packet01(7, points);
+      client::DataPacket01View view(packet.data());
+      client::DataPacket01 data_packet;
+      client::deserialize(packet.data(), data_packet);
+
+      EXPECT_EQ(view.packetHeader().size, packet.size());
+      EXPECT_EQ(view.dataHeader().sequence, 7u);
+      ASSERT_EQ(view.size(), points.size());
+      ASSERT_EQ(data_packet.data_points.size(), points.size());
+      for (std::size_t i = 0; i < points.size(); ++i)
+      {
+        client::DataPoint01 point = view[i];
+        EXPECT_EQ(point.horizontal_angle, points[i].horizontal_angle);
+        EXPECT_EQ(point.vertical_angle, points[i].vertical_angle);
+        EXPECT_EQ(point.range, points[i].range);
+        EXPECT_EQ(point.intensity, points[i].intensity);
+        EXPECT_EQ(point.status, points[i].status);
+        EXPECT_EQ(data_packet.data_points[i].range, points[i].range);
+      }
+
+      // sizes are still checked against the point count
+      reinterpret_cast<client::DataHeader01*>(packet.data() + sizeof(client::PacketHeader))->point_count = htonl(6);
+      EXPECT_THROW(client::DataPacket01View view(packet.data()), client::SizeMismatchError);
+      EXPECT_THROW(client::deserialize(packet.data(), data_packet), client::SizeMismatchError);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
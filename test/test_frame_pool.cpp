@@ -0,0 +1,188 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/common/pointcloud_types.h>
+#include <quanergy/common/frame_pool.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks FramePool recycling, its capacity and reservation, and the footprint counters. */
+    class TestFramePool : public ::testing::Test
+    {
+    public:
+      typedef common::FramePool<PointCloudHVDIR> PoolType;
+
+      TestFramePool()
+      {
+      }
+
+      virtual ~TestFramePool()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+    };
+
+    TEST_F(TestFramePool, Test_recycle)
+    {
+      PoolType pool;
+
+      PoolType::CloudPtr cloud = pool.acquire();
+      PointCloudHVDIR* raw = cloud.get();
+      cloud->resize(10);
+      cloud->header.seq = 7;
+      cloud->header.frame_id = "sensor";
+      cloud->is_dense = false;
+      common::setArrivalTime(cloud, 1234);
+      EXPECT_EQ(1234u, common::getArrivalTime(cloud));
+      cloud.reset();
+
+      // the released cloud comes back empty with a fresh header and arrival time
+      cloud = pool.acquire();
+      EXPECT_EQ(raw, cloud.get());
+      EXPECT_TRUE(cloud->empty());
+      EXPECT_EQ(0u, cloud->header.seq);
+      EXPECT_TRUE(cloud->header.frame_id.empty());
+      EXPECT_TRUE(cloud->is_dense);
+      EXPECT_EQ(0u, common::getArrivalTime(cloud));
+
+      common::FramePoolFootprint footprint = pool.footprint();
+      EXPECT_EQ(1u, footprint.allocations);
+      EXPECT_EQ(1u, footprint.in_use);
+      EXPECT_EQ(0u, footprint.pooled_clouds);
+    }
+
+    TEST_F(TestFramePool, Test_capacity)
+    {
+      PoolType pool(2);
+      EXPECT_EQ(2u, pool.capacity());
+
+      std::vector<PoolType::CloudPtr> clouds;
+      for (int i = 0; i < 3; ++i)
+        clouds.push_back(pool.acquire());
+
+      common::FramePoolFootprint footprint = pool.footprint();
+      EXPECT_EQ(3u, footprint.allocations);
+      EXPECT_EQ(3u, footprint.in_use);
+      EXPECT_EQ(3u, footprint.high_water_mark);
+      EXPECT_EQ(0u, footprint.pooled_clouds);
+
+      // the pool keeps two; the third is freed
+      clouds.clear();
+      footprint = pool.footprint();
+      EXPECT_EQ(0u, footprint.in_use);
+      EXPECT_EQ(3u, footprint.high_water_mark);
+      EXPECT_EQ(2u, footprint.pooled_clouds);
+
+      for (int i = 0; i < 3; ++i)
+        clouds.push_back(pool.acquire());
+
+      footprint = pool.footprint();
+      EXPECT_EQ(4u, footprint.allocations);
+      EXPECT_EQ(3u, footprint.high_water_mark);
+    }
+
+    TEST_F(TestFramePool, Test_reservation)
+    {
+      PoolType pool;
+      EXPECT_EQ(0u, pool.reservePoints());
+
+      // an eighth of headroom over the largest recent frame
+      pool.observeFrameSize(800);
+      EXPECT_EQ(900u, pool.reservePoints());
+      pool.observeFrameSize(400);
+      EXPECT_EQ(900u, pool.reservePoints());
+
+      PoolType::CloudPtr cloud = pool.acquire();
+      EXPECT_GE(cloud->points.capacity(), 900u);
+      EXPECT_EQ(900u, pool.footprint().reserve_points);
+
+      // the large frame ages out of the history
+      for (std::size_t i = 0; i < common::FRAME_POOL_SIZE_HISTORY; ++i)
+        pool.observeFrameSize(400);
+
+      EXPECT_EQ(450u, pool.reservePoints());
+
+      pool.setMaxReserve(300);
+      EXPECT_EQ(300u, pool.reservePoints());
+      pool.observeFrameSize(1000);
+      EXPECT_EQ(300u, pool.reservePoints());
+    }
+
+    TEST_F(TestFramePool, Test_shrink)
+    {
+      PoolType pool;
+      pool.observeFrameSize(800);
+
+      // within twice the reservation a recycled cloud keeps its capacity
+      PoolType::CloudPtr cloud = pool.acquire();
+      cloud->resize(1500);
+      std::size_t kept = cloud->points.capacity();
+      ASSERT_LE(kept, 1800u);
+      cloud.reset();
+
+      cloud = pool.acquire();
+      EXPECT_EQ(kept, cloud->points.capacity());
+
+      // beyond that it goes back to the reservation
+      cloud->resize(5000);
+      cloud.reset();
+      EXPECT_GE(pool.footprint().pooled_bytes, 5000 * sizeof(PointCloudHVDIR::PointType));
+
+      cloud = pool.acquire();
+      EXPECT_GE(cloud->points.capacity(), 900u);
+      EXPECT_LE(cloud->points.capacity(), 1800u);
+      EXPECT_EQ(1u, pool.footprint().allocations);
+    }
+
+    TEST_F(TestFramePool, Test_footprint)
+    {
+      PoolType pool(3);
+      pool.observeFrameSize(64);
+
+      PoolType::CloudPtr first = pool.acquire();
+      PoolType::CloudPtr second = pool.acquire();
+      std::size_t bytes = first->points.capacity() * sizeof(PointCloudHVDIR::PointType);
+      first.reset();
+
+      common::FramePoolFootprint footprint = pool.footprint();
+      EXPECT_EQ(1u, footprint.pooled_clouds);
+      EXPECT_EQ(bytes, footprint.pooled_bytes);
+      EXPECT_EQ(1u, footprint.in_use);
+      EXPECT_EQ(2u, footprint.high_water_mark);
+      EXPECT_EQ(2u, footprint.allocations);
+      EXPECT_EQ(72u, footprint.reserve_points);
+    }
+
+    TEST_F(TestFramePool, Test_outlivePool)
+    {
+      PoolType::CloudPtr cloud;
+      {
+        PoolType pool;
+        cloud = pool.acquire();
+        cloud->resize(10);
+        common::setArrivalTime(cloud, 99);
+      }
+
+      // still usable, and releasing it after the pool is gone frees it
+      EXPECT_EQ(10u, cloud->size());
+      EXPECT_EQ(99u, common::getArrivalTime(cloud));
+      cloud.reset();
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
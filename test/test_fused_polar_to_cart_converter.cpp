@@ -0,0 +1,165 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <random>
+#include <gtest/gtest.h>
+#include <quanergy/modules/encoder_angle_calibration.h>
+#include <quanergy/modules/distance_filter.h>
+#include <quanergy/modules/ring_intensity_filter.h>
+#include <quanergy/modules/polar_to_cart_converter.h>
+#include <quanergy/modules/fused_polar_to_cart_converter.h>
+#include <quanergy/parsers/data_packet_parser_m_series.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks FusedPolarToCartConverter against the chain of modules it replaces. */
+    class TestFusedPolarToCartConverter : public ::testing::Test
+    {
+    public:
+
+      TestFusedPolarToCartConverter()
+      {
+      }
+
+      virtual ~TestFusedPolarToCartConverter()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      // an organized cloud of M-series like points, some of them missing
+      PointCloudHVDIRPtr cloud(std::size_t columns)
+      {
+        std::default_random_engine engine;
+        std::uniform_real_distribution<float> horizontal(-M_PI, M_PI);
+        std::uniform_real_distribution<float> distance(0.f, 120.f);
+        std::uniform_int_distribution<int> intensity(0, 255);
+
+        PointCloudHVDIRPtr ret(new PointCloudHVDIR());
+        ret->header.stamp = 1234;
+        ret->header.seq = 5;
+        ret->header.frame_id = "quanergy";
+
+        for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+        {
+          for (std::size_t column = 0; column < columns; ++column)
+          {
+            PointHVDIR point;
+            point.h = horizontal(engine);
+            point.v = client::M8_VERTICAL_ANGLES[laser];
+            point.d = (column % 53 == 0) ? std::numeric_limits<float>::quiet_NaN() : distance(engine);
+            point.intensity = intensity(engine);
+            point.ring = laser;
+            ret->points.push_back(point);
+          }
+        }
+
+        // the extremes of the angle range, where encoder correction wraps
+        ret->points[1].h = -M_PI;
+        ret->points[2].h = M_PI;
+
+        ret->width = columns;
+        ret->height = client::M_SERIES_NUM_LASERS;
+        ret->is_dense = false;
+        return ret;
+      }
+    };
+
+    TEST_F(TestFusedPolarToCartConverter, Test_chain)
+    {
+      const double amplitude = 0.01;
+      const double phase = 0.5;
+
+      calibration::EncoderAngleCalibration encoder_corrector;
+      client::DistanceFilter distance_filter;
+      client::RingIntensityFilter ring_intensity_filter;
+      client::PolarToCartConverter cartesian_converter;
+      client::FusedPolarToCartConverter fused_converter;
+
+      encoder_corrector.setParams(amplitude, phase);
+      fused_converter.setEncoderParams(amplitude, phase);
+
+      distance_filter.setMinimumDistanceThreshold(1.f);
+      distance_filter.setMaximumDistanceThreshold(100.f);
+      fused_converter.setMinimumDistanceThreshold(1.f);
+      fused_converter.setMaximumDistanceThreshold(100.f);
+
+      for (std::uint16_t i = 0; i < client::M_SERIES_NUM_LASERS; ++i)
+      {
+        ring_intensity_filter.setRingFilterMinimumRangeThreshold(i, 10.f + i);
+        ring_intensity_filter.setRingFilterMinimumIntensityThreshold(i, 100);
+        fused_converter.setRingFilterMinimumRangeThreshold(i, 10.f + i);
+        fused_converter.setRingFilterMinimumIntensityThreshold(i, 100);
+      }
+
+      PointCloudXYZIRPtr expected;
+      encoder_corrector.connect([&](const PointCloudHVDIRPtr& pc){ distance_filter.slot(pc); });
+      distance_filter.connect([&](const PointCloudHVDIRPtr& pc){ ring_intensity_filter.slot(pc); });
+      ring_intensity_filter.connect([&](const PointCloudHVDIRPtr& pc){ cartesian_converter.slot(pc); });
+      cartesian_converter.connect([&](const PointCloudXYZIRPtr& pc){ expected = pc; });
+
+      std::vector<PointCloudXYZIRPtr> results;
+      fused_converter.connect([&](const PointCloudXYZIRPtr& pc){ results.push_back(pc); });
+
+      auto input = cloud(500);
+
+      // the fused converter leaves its input as it is; the corrector corrects in place
+      fused_converter.slot(input);
+      fused_converter.slot(input);
+      encoder_corrector.slot(input);
+
+      ASSERT_TRUE(expected);
+      ASSERT_EQ(results.size(), 2u);
+
+      for (const auto& result : results)
+      {
+        EXPECT_EQ(result->header.stamp, expected->header.stamp);
+        EXPECT_EQ(result->header.seq, expected->header.seq);
+        EXPECT_EQ(result->header.frame_id, expected->header.frame_id);
+        EXPECT_EQ(result->width, expected->width);
+        EXPECT_EQ(result->height, expected->height);
+        EXPECT_EQ(result->is_dense, expected->is_dense);
+        ASSERT_EQ(result->size(), expected->size());
+
+        std::size_t filtered = 0;
+        for (std::size_t i = 0; i < expected->size(); ++i)
+        {
+          const PointXYZIR& point = result->points[i];
+          const PointXYZIR& expected_point = expected->points[i];
+
+          EXPECT_EQ(point.intensity, expected_point.intensity);
+          EXPECT_EQ(point.ring, expected_point.ring);
+          ASSERT_EQ(std::isnan(point.x), std::isnan(expected_point.x)) << i;
+          if (std::isnan(expected_point.x))
+          {
+            EXPECT_TRUE(std::isnan(point.y) && std::isnan(point.z));
+            ++filtered;
+            continue;
+          }
+
+          // the encoder correction may round to a neighboring float angle
+          EXPECT_NEAR(point.x, expected_point.x, 1E-4) << i;
+          EXPECT_NEAR(point.y, expected_point.y, 1E-4) << i;
+          EXPECT_EQ(point.z, expected_point.z) << i;
+        }
+
+        // every filter had something to do
+        EXPECT_GT(filtered, expected->size() / 10);
+      }
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
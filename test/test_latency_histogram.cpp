@@ -0,0 +1,100 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/client/latency_histogram.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks LatencyHistogram counts and percentile bounds. */
+    class TestLatencyHistogram : public ::testing::Test
+    {
+    public:
+
+      TestLatencyHistogram()
+      {
+      }
+
+      virtual ~TestLatencyHistogram()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+    };
+
+    TEST_F(TestLatencyHistogram, Test_percentiles)
+    {
+      client::LatencyHistogram histogram;
+      EXPECT_EQ(0u, histogram.count());
+      EXPECT_EQ(0u, histogram.percentile(0.5));
+
+      // small values are exact
+      for (std::uint64_t i = 0; i < 8; ++i)
+        histogram.record(i);
+
+      EXPECT_EQ(8u, histogram.count());
+      EXPECT_EQ(0u, histogram.percentile(0.));
+      EXPECT_EQ(3u, histogram.percentile(0.5));
+      EXPECT_EQ(7u, histogram.percentile(1.));
+
+      histogram.reset();
+      EXPECT_EQ(0u, histogram.count());
+
+      // 1 to 100000 ns; every percentile is an upper bound within 25% of the true value
+      const std::uint64_t count = 100000;
+      for (std::uint64_t i = 1; i <= count; ++i)
+        histogram.record(i);
+
+      EXPECT_EQ(count, histogram.count());
+      for (double p : {0.01, 0.1, 0.5, 0.9, 0.99, 0.999, 1.})
+      {
+        std::uint64_t exact = static_cast<std::uint64_t>(p * count);
+        std::uint64_t value = histogram.percentile(p);
+        EXPECT_GE(value, exact) << p;
+        EXPECT_LE(value, exact + exact / 4) << p;
+      }
+
+      // the largest values land in the last bucket
+      histogram.reset();
+      histogram.record(~std::uint64_t(0));
+      EXPECT_EQ(~std::uint64_t(0), histogram.percentile(1.));
+    }
+
+    TEST_F(TestLatencyHistogram, Test_concurrentRecord)
+    {
+      client::LatencyHistogram histogram;
+
+      const std::size_t per_thread = 100000;
+      std::vector<std::thread> threads;
+      for (std::size_t t = 0; t < 4; ++t)
+      {
+        threads.emplace_back([&histogram, t]
+                             {
+                               for (std::size_t i = 0; i < per_thread; ++i)
+                                 histogram.record(t * 1000 + i % 1000);
+                             });
+      }
+
+      for (auto& thread : threads)
+        thread.join();
+
+      EXPECT_EQ(4 * per_thread, histogram.count());
+      EXPECT_LE(histogram.percentile(1.), 3999u + 3999u / 4);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
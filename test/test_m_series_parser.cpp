@@ -0,0 +1,1118 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/parsers/data_packet_parser_00.h>
+#include <quanergy/parsers/data_packet_parser_04.h>
+#include <quanergy/parsers/data_packet_parser_06.h>
+#include <quanergy/parsers/firing_decoder.h>
+#include <quanergy/parsers/variadic_packet_parser.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks the M-series parsers, which decode straight from the network buffer,
+     *         against the packet as read by the full-packet deserialize functions.
+     */
+    class TestMSeriesParser : public ::testing::Test
+    {
+    public:
+
+      TestMSeriesParser()
+      {
+      }
+
+      virtual ~TestMSeriesParser()
+      {
+      }
+
+      virtual void SetUp()
+      {
+        position_ = 0;
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      void setHeader(client::PacketHeader& header, std::size_t size, std::uint8_t packet_type)
+      {
+        header.signature = htonl(client::SIGNATURE);
+        header.size = htonl(size);
+        header.seconds = htonl(1000);
+        header.nanoseconds = htonl(position_ * 1000);
+        header.version_major = 0;
+        header.version_minor = 1;
+        header.version_patch = 0;
+        header.packet_type = packet_type;
+      }
+
+      // distances with a missing return per firing and some duplicate returns
+      std::uint32_t distance(int firing, int laser, int ret)
+      {
+        if (ret == 0 && laser == firing % client::M_SERIES_NUM_LASERS)
+          return 0;
+        if (ret == 1 && laser == (firing + 3) % client::M_SERIES_NUM_LASERS)
+          return distance(firing, laser, 2);
+
+        return 100000 + 1000 * firing + 10 * laser + ret;
+      }
+
+      // one packet 0x00 in network order; positions advance 100 counts per firing
+      std::vector<char> packet00(int packet_index)
+      {
+        std::vector<char> ret(sizeof(client::DataPacket00));
+        client::DataPacket00& packet = *reinterpret_cast<client::DataPacket00*>(ret.data());
+        setHeader(packet.packet_header, ret.size(), 0x00);
+
+        for (int f = 0; f < client::M_SERIES_FIRING_PER_PKT; ++f)
+        {
+          int firing = packet_index * client::M_SERIES_FIRING_PER_PKT + f;
+          client::MSeriesFiringData& data = packet.data_body.data[f];
+          data.position = htons(nextPosition());
+
+          for (int r = 0; r < client::M_SERIES_NUM_RETURNS; ++r)
+          {
+            for (int l = 0; l < client::M_SERIES_NUM_LASERS; ++l)
+            {
+              data.returns_distances[r][l] = htonl(distance(firing, l, r));
+              data.returns_intensities[r][l] = static_cast<std::uint8_t>(firing + l + r);
+            }
+          }
+        }
+
+        packet.data_body.version = htons(5);
+        packet.data_body.status = 0;
+        return ret;
+      }
+
+      // one packet 0x04 in network order
+      std::vector<char> packet04(int packet_index)
+      {
+        std::vector<char> ret(sizeof(client::DataPacket04));
+        client::DataPacket04& packet = *reinterpret_cast<client::DataPacket04*>(ret.data());
+        setHeader(packet.packet_header, ret.size(), 0x04);
+
+        for (int f = 0; f < client::M_SERIES_FIRING_PER_PKT; ++f)
+        {
+          int firing = packet_index * client::M_SERIES_FIRING_PER_PKT + f;
+          client::MSeriesFiringData04& data = packet.data.firings[f];
+          data.position = htons(nextPosition());
+
+          for (int l = 0; l < client::M_SERIES_NUM_LASERS; ++l)
+          {
+            data.radius[l] = htonl(distance(firing, l, 0));
+            data.intensity[l] = static_cast<std::uint8_t>(firing + l);
+          }
+        }
+
+        return ret;
+      }
+
+      // M1 range of a firing; some are missing and some returns equal the last
+      std::uint32_t m1Distance(int firing, int ret)
+      {
+        if (ret < 2 && firing % 5 == ret)
+          return m1Distance(firing, 2);
+
+        return (firing % 37 == 0) ? 0 : 100000 + 10 * firing + ret;
+      }
+
+      // one packet 0x06 in network order; positions advance 4 counts per firing
+      template <std::uint8_t R>
+      std::vector<char> packet06(int packet_index)
+      {
+        std::vector<char> ret(sizeof(client::DataPacket06<R>));
+        client::DataPacket06<R>& packet = *reinterpret_cast<client::DataPacket06<R>*>(ret.data());
+        setHeader(packet.packet_header, ret.size(), 0x06);
+        packet.data_header.status = 0;
+        packet.data_header.return_id = (R == 1) ? 0 : 3;
+
+        for (int f = 0; f < client::M_SERIES_FIRING_PER_PKT; ++f)
+        {
+          int firing = packet_index * client::M_SERIES_FIRING_PER_PKT + f;
+          client::M1FiringData<R>& data = packet.data.firings[f];
+          data.position = htons(firing * 4 % client::M_SERIES_NUM_ROT_ANGLES);
+
+          for (int r = 0; r < R; ++r)
+          {
+            data.radius[r] = htonl(m1Distance(firing, r));
+            data.intensity[r] = static_cast<std::uint8_t>(firing + r);
+          }
+        }
+
+        return ret;
+      }
+
+      std::uint16_t nextPosition()
+      {
+        std::uint16_t ret = position_;
+        position_ = (position_ + 100) % client::M_SERIES_NUM_ROT_ANGLES;
+        return ret;
+      }
+
+      // parse packets until the first cloud completes
+      template <class PARSER, class MAKE_PACKET>
+      PointCloudHVDIRPtr firstCloud(PARSER& parser, MAKE_PACKET make_packet,
+                                    std::vector<std::vector<char>>& packets)
+      {
+        PointCloudHVDIRPtr result;
+        for (int i = 0; i < 10 && !result; ++i)
+        {
+          packets.push_back(make_packet(i));
+          PointCloudHVDIRPtr cloud;
+          if (parser.parse(packets.back(), cloud))
+            result = cloud;
+        }
+
+        return result;
+      }
+
+      void expectPoint(const PointHVDIR& point, std::uint32_t distance, double scaling,
+                       std::uint8_t intensity, int laser)
+      {
+        if (distance == 0)
+        {
+          EXPECT_TRUE(std::isnan(point.d));
+        }
+        else
+        {
+          EXPECT_EQ(point.d, static_cast<float>(static_cast<float>(distance) * scaling));
+        }
+        EXPECT_EQ(point.intensity, intensity);
+        EXPECT_EQ(point.ring, laser);
+        EXPECT_EQ(point.v, static_cast<float>(client::M8_VERTICAL_ANGLES[laser]));
+      }
+
+      // instruction sets usable on this machine
+      std::vector<client::DecodeInstructionSet> instructionSets()
+      {
+        std::vector<client::DecodeInstructionSet> ret;
+        for (auto instruction_set : {client::DecodeInstructionSet::SCALAR,
+                                     client::DecodeInstructionSet::SSE4,
+                                     client::DecodeInstructionSet::AVX2})
+        {
+          if (client::FiringDecoder::isSupported(instruction_set))
+            ret.push_back(instruction_set);
+        }
+
+        return ret;
+      }
+
+      // parse packets with a parser module in batches of increasing size; returns all clouds completed
+      template <class MODULE>
+      std::vector<PointCloudHVDIRPtr> parseBatches(MODULE& module, const std::vector<std::vector<char>>& packets)
+      {
+        std::vector<PointCloudHVDIRPtr> ret;
+        module.connect([&ret](const PointCloudHVDIRPtr& cloud) { ret.push_back(cloud); });
+
+        std::size_t batch_size = 1;
+        for (std::size_t i = 0; i < packets.size(); i += batch_size++)
+        {
+          std::vector<std::shared_ptr<std::vector<char>>> batch;
+          for (std::size_t j = i; j < std::min(packets.size(), i + batch_size); ++j)
+            batch.push_back(std::make_shared<std::vector<char>>(packets[j]));
+
+          module.batchSlot(batch);
+        }
+
+        return ret;
+      }
+
+      /// a firing as read by the full-packet deserialize functions, with the points a parser should give for it
+      struct ReferenceFiring
+      {
+        int position;
+        /// in cloud order; h is left 0 and checked against the position instead
+        std::vector<PointHVDIR> points;
+      };
+
+      // the point of a deserialized range; missing ranges and rings outside the mask are NaN
+      static PointHVDIR referencePoint(std::uint32_t distance, double scaling, std::uint8_t intensity,
+                                       int ring, double v, bool in_ring)
+      {
+        PointHVDIR point;
+        point.h = 0.f;
+        point.v = static_cast<float>(v);
+        point.d = (distance == 0 || !in_ring) ? std::numeric_limits<float>::quiet_NaN()
+                                              : static_cast<float>(static_cast<float>(distance) * scaling);
+        point.intensity = intensity;
+        point.ring = ring;
+        return point;
+      }
+
+      // whether a firing at an encoder position is in the region of interest of Test_decodeMatchesDeserialize
+      static bool inRegion(int position)
+      {
+        return position >= 8667 || position < 1733 || position == 5000;
+      }
+
+      // the firings of a packet 0x00; all returns leave out missing ones, those equal to the last and masked rings
+      void reference00(const std::vector<char>& buffer, int return_selection, bool region, std::uint8_t ring_mask,
+                       std::vector<ReferenceFiring>& firings)
+      {
+        client::DataPacket00 packet;
+        client::deserialize(buffer.data(), packet);
+        const double scaling = (packet.data_body.version >= 5) ? 0.00001 : 0.01;
+
+        for (const auto& firing : packet.data_body.data)
+        {
+          ReferenceFiring reference;
+          reference.position = firing.position;
+
+          for (int l = 0; l < client::M_SERIES_NUM_LASERS && (!region || inRegion(firing.position)); ++l)
+          {
+            const bool in_ring = (ring_mask & (1u << l)) != 0;
+            for (int r = 0; r < client::M_SERIES_NUM_RETURNS; ++r)
+            {
+              const std::uint32_t d = firing.returns_distances[r][l];
+              if (return_selection == client::ALL_RETURNS
+                  ? (d == 0 || (r < 2 && d == firing.returns_distances[2][l]) || !in_ring)
+                  : r != return_selection)
+                continue;
+
+              reference.points.push_back(referencePoint(d, scaling, firing.returns_intensities[r][l], l,
+                                                        client::M8_VERTICAL_ANGLES[l], in_ring));
+            }
+          }
+
+          firings.push_back(reference);
+        }
+      }
+
+      // the firings of a packet 0x04; a point per laser
+      void reference04(const std::vector<char>& buffer, bool region, std::uint8_t ring_mask,
+                       std::vector<ReferenceFiring>& firings)
+      {
+        client::DataPacket04 packet;
+        client::deserialize(buffer.data(), packet);
+
+        for (const auto& firing : packet.data.firings)
+        {
+          ReferenceFiring reference;
+          reference.position = firing.position;
+
+          for (int l = 0; l < client::M_SERIES_NUM_LASERS && (!region || inRegion(firing.position)); ++l)
+          {
+            reference.points.push_back(referencePoint(firing.radius[l], 0.00001, firing.intensity[l], l,
+                                                      client::M8_VERTICAL_ANGLES[l], (ring_mask & (1u << l)) != 0));
+          }
+
+          firings.push_back(reference);
+        }
+      }
+
+      // the firings of a packet 0x06; all returns leave out missing ones and those equal to the last
+      template <std::uint8_t R>
+      void reference06(const std::vector<char>& buffer, int return_selection, bool region,
+                       std::vector<ReferenceFiring>& firings)
+      {
+        client::DataPacket06<R> packet;
+        client::deserialize(buffer.data(), packet);
+
+        for (const auto& firing : packet.data.firings)
+        {
+          ReferenceFiring reference;
+          reference.position = firing.position;
+
+          for (int r = 0; r < R && (!region || inRegion(firing.position)); ++r)
+          {
+            const std::uint32_t d = firing.radius[r];
+            if (return_selection == client::ALL_RETURNS
+                ? (d == 0 || (r < 2 && d == firing.radius[R - 1]))
+                : r != (R == 1 ? 0 : return_selection))
+              continue;
+
+            reference.points.push_back(referencePoint(d, 0.00001, firing.intensity[r], 0, 0., true));
+          }
+
+          firings.push_back(reference);
+        }
+      }
+
+      // whether a point is the reference point of a firing at an encoder position; NaN ranges compare equal
+      static bool samePoint(const PointHVDIR& point, const PointHVDIR& reference, int position)
+      {
+        long count = std::lround(point.h * client::M_SERIES_NUM_ROT_ANGLES / (2. * M_PI));
+        if (count < 0)
+          count += client::M_SERIES_NUM_ROT_ANGLES;
+
+        return count == position && point.v == reference.v && point.ring == reference.ring &&
+               point.intensity == reference.intensity &&
+               ((std::isnan(point.d) && std::isnan(reference.d)) || point.d == reference.d);
+      }
+
+      // the points of a firing in a cloud: a column if organized, else the points from first on
+      static bool firingInCloud(const PointCloudHVDIR& cloud, bool organized, std::size_t first,
+                                const ReferenceFiring& firing)
+      {
+        if (organized)
+        {
+          if (first >= cloud.width || firing.points.size() != client::M_SERIES_NUM_LASERS)
+            return false;
+
+          for (int l = 0; l < client::M_SERIES_NUM_LASERS; ++l)
+          {
+            // organized top down
+            if (!samePoint(cloud.at(first, client::M_SERIES_NUM_LASERS - 1 - l), firing.points[l], firing.position))
+              return false;
+          }
+
+          return true;
+        }
+
+        if (first + firing.points.size() > cloud.size())
+          return false;
+
+        for (std::size_t i = 0; i < firing.points.size(); ++i)
+        {
+          if (!samePoint(cloud.points[first + i], firing.points[i], firing.position))
+            return false;
+        }
+
+        return true;
+      }
+
+      // check that each cloud holds the points of consecutive reference firings; firings are only skipped
+      // before a cloud starts, past a full cloud or in one dropped for its size. Returns how many had points.
+      std::size_t expectReferenceClouds(const std::vector<PointCloudHVDIRPtr>& clouds,
+                                        const std::vector<ReferenceFiring>& firings, bool organized)
+      {
+        std::size_t skipped = 0;
+        std::size_t next = 0;
+        // first and last firing of each cloud
+        std::vector<std::pair<std::size_t, std::size_t>> cloud_firings;
+
+        for (std::size_t c = 0; c < clouds.size(); ++c)
+        {
+          const PointCloudHVDIR& cloud = *clouds[c];
+          EXPECT_EQ(cloud.header.seq, c);
+          EXPECT_EQ(cloud.height, organized ? static_cast<std::uint32_t>(client::M_SERIES_NUM_LASERS) : 1u);
+          EXPECT_EQ(cloud.size(), static_cast<std::size_t>(cloud.width) * cloud.height);
+          EXPECT_GT(cloud.size(), 0u);
+
+          bool dense = true;
+          for (const auto& point : cloud.points)
+            dense = dense && !std::isnan(point.d);
+          EXPECT_EQ(cloud.is_dense, dense) << c;
+
+          // the firing the cloud starts with
+          while (next < firings.size() &&
+                 (firings[next].points.empty() || !firingInCloud(cloud, organized, 0, firings[next])))
+          {
+            skipped += !firings[next].points.empty();
+            ++next;
+          }
+          const std::size_t cloud_first = next;
+
+          // followed by the next ones, without any left out
+          std::size_t first = 0;
+          const std::size_t end = organized ? cloud.width : cloud.size();
+          while (first < end)
+          {
+            if (next >= firings.size())
+            {
+              ADD_FAILURE() << "cloud " << c << " has points past the firings at " << first;
+              return skipped;
+            }
+
+            if (!firings[next].points.empty())
+            {
+              if (!firingInCloud(cloud, organized, first, firings[next]))
+              {
+                ADD_FAILURE() << "cloud " << c << " at " << first << " is not firing " << next;
+                return skipped;
+              }
+
+              first += organized ? 1 : firings[next].points.size();
+            }
+
+            ++next;
+          }
+
+          cloud_firings.push_back(std::make_pair(cloud_first, next - 1));
+        }
+
+        // without size limits, clouds are the revolutions, ending as the firings turn past the back of the sensor
+        auto turns = [&firings](std::size_t i)
+        {
+          const int half = client::M_SERIES_NUM_ROT_ANGLES / 2;
+          return (firings[i].position + half) % client::M_SERIES_NUM_ROT_ANGLES <
+                 (firings[i - 1].position + half) % client::M_SERIES_NUM_ROT_ANGLES;
+        };
+
+        for (std::size_t c = 0; c < cloud_firings.size() && skipped == 0; ++c)
+        {
+          for (std::size_t i = cloud_firings[c].first + 1; i <= cloud_firings[c].second; ++i)
+            EXPECT_FALSE(turns(i)) << "cloud " << c << " at firing " << i;
+
+          if (c > 0)
+          {
+            bool turned = false;
+            for (std::size_t i = cloud_firings[c - 1].second + 1; i <= cloud_firings[c].first; ++i)
+              turned = turned || turns(i);
+            EXPECT_TRUE(turned) << "cloud " << c;
+          }
+        }
+
+        return skipped;
+      }
+
+      std::uint16_t position_ = 0;
+    };
+
+    TEST_F(TestMSeriesParser, Test_parse00SingleReturn)
+    {
+      client::DataPacketParser00 parser;
+      parser.setVerticalAngles(client::SensorType::M8);
+      parser.setReturnSelection(1);
+
+      std::vector<std::vector<char>> packets;
+      auto cloud = firstCloud(parser, [this](int i) { return packet00(i); }, packets);
+      ASSERT_TRUE(cloud);
+      ASSERT_EQ(cloud->height, client::M_SERIES_NUM_LASERS);
+
+      const unsigned int width = cloud->width;
+      for (unsigned int c = 0; c < width; ++c)
+      {
+        client::DataPacket00 reference;
+        client::deserialize(packets[c / client::M_SERIES_FIRING_PER_PKT].data(), reference);
+        const auto& firing = reference.data_body.data[c % client::M_SERIES_FIRING_PER_PKT];
+
+        for (int l = 0; l < client::M_SERIES_NUM_LASERS; ++l)
+        {
+          // organized top down
+          const auto& point = cloud->at(c, client::M_SERIES_NUM_LASERS - 1 - l);
+          expectPoint(point, firing.returns_distances[1][l], 0.00001, firing.returns_intensities[1][l], l);
+          EXPECT_EQ(point.h, cloud->at(c, 0).h);
+        }
+
+        if (c > 0)
+        {
+          EXPECT_GT(cloud->at(c, 0).h, cloud->at(c - 1, 0).h);
+        }
+      }
+    }
+
+    TEST_F(TestMSeriesParser, Test_parse00AllReturns)
+    {
+      client::DataPacketParser00 parser;
+      parser.setVerticalAngles(client::SensorType::M8);
+      parser.setReturnSelection(client::ALL_RETURNS);
+
+      std::vector<std::vector<char>> packets;
+      auto cloud = firstCloud(parser, [this](int i) { return packet00(i); }, packets);
+      ASSERT_TRUE(cloud);
+      ASSERT_EQ(cloud->height, 1u);
+      EXPECT_TRUE(cloud->is_dense);
+
+      // missing returns are dropped and returns equal to the last are kept once
+      std::size_t index = 0;
+      for (std::size_t p = 0; p < packets.size() && index < cloud->size(); ++p)
+      {
+        client::DataPacket00 reference;
+        client::deserialize(packets[p].data(), reference);
+
+        for (int f = 0; f < client::M_SERIES_FIRING_PER_PKT && index < cloud->size(); ++f)
+        {
+          const auto& firing = reference.data_body.data[f];
+          for (int l = 0; l < client::M_SERIES_NUM_LASERS; ++l)
+          {
+            for (int r = 0; r < client::M_SERIES_NUM_RETURNS; ++r)
+            {
+              std::uint32_t d = firing.returns_distances[r][l];
+              if (d == 0 || (r < 2 && d == firing.returns_distances[2][l]))
+                continue;
+
+              ASSERT_LT(index, cloud->size());
+              expectPoint(cloud->points[index++], d, 0.00001, firing.returns_intensities[r][l], l);
+            }
+          }
+        }
+      }
+
+      EXPECT_EQ(index, cloud->size());
+    }
+
+    TEST_F(TestMSeriesParser, Test_parse04)
+    {
+      client::DataPacketParser04 parser;
+      parser.setVerticalAngles(client::SensorType::M8);
+
+      // a half and then full revolutions, so rows are spread out and compacted again
+      std::vector<std::vector<char>> packets;
+      std::vector<PointCloudHVDIRPtr> clouds;
+      for (int i = 0; clouds.size() < 4; ++i)
+      {
+        ASSERT_LT(i, 20);
+        packets.push_back(packet04(i));
+        PointCloudHVDIRPtr cloud;
+        if (parser.parse(packets.back(), cloud))
+          clouds.push_back(cloud);
+      }
+
+      std::size_t firing_offset = 0;
+      for (const auto& cloud : clouds)
+      {
+        ASSERT_EQ(cloud->height, client::M_SERIES_NUM_LASERS);
+        ASSERT_EQ(cloud->size(), cloud->width * cloud->height);
+        // every firing has a missing return
+        EXPECT_FALSE(cloud->is_dense);
+
+        for (unsigned int c = 0; c < cloud->width; ++c)
+        {
+          std::size_t firing_index = firing_offset + c;
+          client::DataPacket04 reference;
+          client::deserialize(packets[firing_index / client::M_SERIES_FIRING_PER_PKT].data(), reference);
+          const auto& firing = reference.data.firings[firing_index % client::M_SERIES_FIRING_PER_PKT];
+
+          for (int l = 0; l < client::M_SERIES_NUM_LASERS; ++l)
+          {
+            // organized top down
+            const auto& point = cloud->at(c, client::M_SERIES_NUM_LASERS - 1 - l);
+            expectPoint(point, firing.radius[l], 0.00001, firing.intensity[l], l);
+          }
+        }
+
+        firing_offset += cloud->width;
+      }
+    }
+
+    TEST_F(TestMSeriesParser, Test_decodeBitIdentical)
+    {
+      client::FiringDecoder scalar(client::DecodeInstructionSet::SCALAR);
+
+      // edge cases and the full range of radii, where the float conversion has to round
+      std::vector<std::uint32_t> values = {0, 1, 0xFFFF, 0x10000, 0xFFFFFF, 0x1000001, 0x1000003,
+                                           0x7FFFFFFF, 0x80000000, 0x80000081, 0xFFFFFF7F, 0xFFFFFFFF};
+      std::mt19937 engine(3);
+      while (values.size() < 8000)
+      {
+        values.push_back(engine() >> (engine() % 32));
+      }
+
+      for (auto instruction_set : instructionSets())
+      {
+        client::FiringDecoder decoder(instruction_set);
+
+        for (double scaling : {0.01, 0.00001})
+        {
+          for (std::size_t i = 0; i + client::FIRING_DECODER_LANES <= values.size(); ++i)
+          {
+            std::uint32_t radii[client::FIRING_DECODER_LANES];
+            std::uint32_t shifted[client::FIRING_DECODER_LANES];
+            for (int l = 0; l < client::FIRING_DECODER_LANES; ++l)
+            {
+              radii[l] = htonl(values[i + l]);
+              shifted[l] = htonl(values[i + (l + 1) % client::FIRING_DECODER_LANES]);
+            }
+            // some lanes equal
+            shifted[i % client::FIRING_DECODER_LANES] = radii[i % client::FIRING_DECODER_LANES];
+
+            float expected[client::FIRING_DECODER_LANES];
+            float ranges[client::FIRING_DECODER_LANES];
+            ASSERT_EQ(decoder.decode(radii, scaling, ranges), scalar.decode(radii, scaling, expected));
+            ASSERT_EQ(std::memcmp(ranges, expected, sizeof(ranges)), 0) << instruction_set << " at " << i;
+            ASSERT_EQ(decoder.equal(radii, shifted), scalar.equal(radii, shifted));
+          }
+        }
+      }
+    }
+
+    TEST_F(TestMSeriesParser, Test_parseBitIdentical)
+    {
+      // every instruction set gives the same clouds as the scalar one
+      std::vector<PointCloudHVDIR::VectorType> expected;
+
+      for (auto instruction_set : instructionSets())
+      {
+        std::vector<PointCloudHVDIR::VectorType> clouds;
+        for (int return_selection : {0, client::ALL_RETURNS})
+        {
+          SetUp();
+          client::DataPacketParser00 parser00;
+          parser00.setVerticalAngles(client::SensorType::M8);
+          parser00.setReturnSelection(return_selection);
+          parser00.setDecodeInstructionSet(instruction_set);
+
+          std::vector<std::vector<char>> packets;
+          auto cloud = firstCloud(parser00, [this](int i) { return packet00(i); }, packets);
+          ASSERT_TRUE(cloud);
+          clouds.push_back(cloud->points);
+        }
+
+        SetUp();
+        client::DataPacketParser04 parser04;
+        parser04.setVerticalAngles(client::SensorType::M8);
+        parser04.setDecodeInstructionSet(instruction_set);
+
+        std::vector<std::vector<char>> packets;
+        auto cloud = firstCloud(parser04, [this](int i) { return packet04(i); }, packets);
+        ASSERT_TRUE(cloud);
+        clouds.push_back(cloud->points);
+
+        if (expected.empty())
+          expected = clouds;
+
+        ASSERT_EQ(clouds.size(), expected.size());
+        for (std::size_t i = 0; i < clouds.size(); ++i)
+        {
+          ASSERT_EQ(clouds[i].size(), expected[i].size());
+          for (std::size_t j = 0; j < clouds[i].size(); ++j)
+          {
+            // bitwise so NaN ranges compare too
+            const PointHVDIR& point = clouds[i][j];
+            const PointHVDIR& expected_point = expected[i][j];
+            ASSERT_EQ(std::memcmp(&point.h, &expected_point.h, sizeof(float)), 0) << instruction_set;
+            ASSERT_EQ(std::memcmp(&point.v, &expected_point.v, sizeof(float)), 0) << instruction_set;
+            ASSERT_EQ(std::memcmp(&point.d, &expected_point.d, sizeof(float)), 0) << instruction_set;
+            ASSERT_EQ(point.intensity, expected_point.intensity) << instruction_set;
+            ASSERT_EQ(point.ring, expected_point.ring) << instruction_set;
+          }
+        }
+      }
+    }
+
+    TEST_F(TestMSeriesParser, Test_parse06)
+    {
+      // a cloud per revolution of 2600 firings, serially and from batches decoded on a pool;
+      // the first cloud ends half way as clouds start at the back of the sensor
+      const int firings_per_revolution = client::M_SERIES_NUM_ROT_ANGLES / 4;
+      const double scaling = 0.00001;
+
+      std::vector<std::vector<char>> packets;
+      for (int i = 0; i < 200; ++i)
+        packets.push_back(packet06<1>(i));
+
+      for (std::size_t threads : {0, 2})
+      {
+        client::PacketParserModule<client::VariadicPacketParser<PointCloudHVDIRPtr, client::DataPacketParser06>> module;
+        std::vector<PointCloudHVDIRPtr> clouds;
+        if (threads == 0)
+        {
+          for (const auto& packet : packets)
+          {
+            PointCloudHVDIRPtr cloud;
+            if (module.parse(packet, cloud))
+              clouds.push_back(cloud);
+          }
+        }
+        else
+        {
+          module.setDecodeThreads(threads);
+          clouds = parseBatches(module, packets);
+        }
+
+        ASSERT_EQ(clouds.size(), 4u) << threads;
+        for (std::size_t c = 0; c < clouds.size(); ++c)
+        {
+          const PointCloudHVDIR& cloud = *clouds[c];
+          const int first_firing = (c == 0) ? 0 : (2 * c - 1) * firings_per_revolution / 2;
+          const int firings = (c == 0) ? firings_per_revolution / 2 : firings_per_revolution;
+
+          EXPECT_EQ(cloud.header.seq, c);
+          EXPECT_EQ(cloud.height, 1u);
+          ASSERT_EQ(cloud.size(), static_cast<std::size_t>(firings)) << threads;
+          EXPECT_FALSE(cloud.is_dense);
+
+          for (int i = 0; i < firings; ++i)
+          {
+            const int firing = first_firing + i;
+            const PointHVDIR& point = cloud.points[i];
+            const std::uint32_t distance = m1Distance(firing, 0);
+            if (distance == 0)
+            {
+              ASSERT_TRUE(std::isnan(point.d)) << threads;
+            }
+            else
+            {
+              ASSERT_EQ(point.d, static_cast<float>(static_cast<float>(distance) * scaling)) << threads;
+            }
+            ASSERT_EQ(point.intensity, static_cast<std::uint8_t>(firing)) << threads;
+            ASSERT_EQ(point.v, 0.f);
+            ASSERT_EQ(point.ring, 0);
+          }
+        }
+      }
+    }
+
+    TEST_F(TestMSeriesParser, Test_dispatch)
+    {
+      // packets are routed by type and version, also when the types alternate
+      client::VariadicPacketParser<PointCloudHVDIRPtr,
+                                   client::DataPacketParser00,
+                                   client::DataPacketParser04> parser;
+      client::DataPacketParser00 parser00;
+      client::DataPacketParser04 parser04;
+      parser.get<0>().setVerticalAngles(client::SensorType::M8);
+      parser.get<1>().setVerticalAngles(client::SensorType::M8);
+      parser00.setVerticalAngles(client::SensorType::M8);
+      parser04.setVerticalAngles(client::SensorType::M8);
+
+      for (int i = 0; i < 20; ++i)
+      {
+        std::vector<char> packet = (i % 2 == 0) ? packet00(i) : packet04(i);
+        ASSERT_TRUE(parser.validate(packet));
+
+        PointCloudHVDIRPtr cloud;
+        PointCloudHVDIRPtr expected;
+        EXPECT_EQ(parser.validateParse(packet, cloud),
+                  (i % 2 == 0) ? parser00.parse(packet, expected) : parser04.parse(packet, expected));
+        EXPECT_EQ(static_cast<bool>(cloud), static_cast<bool>(expected));
+        if (cloud && expected)
+        {
+          EXPECT_EQ(cloud->size(), expected->size());
+        }
+      }
+
+      std::vector<char> packet = packet04(0);
+      reinterpret_cast<client::PacketHeader*>(packet.data())->version_minor = 2;
+      EXPECT_FALSE(parser.validate(packet));
+      PointCloudHVDIRPtr cloud;
+      EXPECT_THROW(parser.validateParse(packet, cloud), client::InvalidPacketError);
+
+      // parse and parsePrepared report it instead
+      EXPECT_FALSE(parser.parse(packet, cloud));
+      EXPECT_FALSE(parser.parsePrepared(packet, nullptr, cloud));
+
+      reinterpret_cast<client::PacketHeader*>(packet.data())->version_minor = 1;
+      reinterpret_cast<client::PacketHeader*>(packet.data())->packet_type = 0x06;
+      EXPECT_FALSE(parser.validate(packet));
+
+      packet.resize(sizeof(client::PacketHeader) - 1);
+      EXPECT_FALSE(parser.validate(packet));
+    }
+
+    TEST_F(TestMSeriesParser, Test_decodeMatchesDeserialize)
+    {
+      // parsing serially and decoding batches on a worker pool give the points the full-packet deserialize
+      // functions read, for every return selection, with and without a region of interest and size limits
+      typedef client::VariadicPacketParser<PointCloudHVDIRPtr,
+                                           client::DataPacketParser00,
+                                           client::DataPacketParser04,
+                                           client::DataPacketParser06> Parser;
+
+      struct PacketType
+      {
+        std::uint8_t type;
+        std::uint8_t returns;
+        std::vector<int> return_selections;
+        int packets;
+        int firings_per_revolution;
+      };
+
+      const std::vector<PacketType> packet_types = {
+        {0x00, 3, {0, 1, 2, client::ALL_RETURNS}, 40, client::M_SERIES_NUM_ROT_ANGLES / 100},
+        {0x04, 1, {0, client::ALL_RETURNS}, 40, client::M_SERIES_NUM_ROT_ANGLES / 100},
+        {0x06, 1, {0}, 200, client::M_SERIES_NUM_ROT_ANGLES / 4},
+        {0x06, 3, {0, 1, 2, client::ALL_RETURNS}, 200, client::M_SERIES_NUM_ROT_ANGLES / 4}};
+
+      const std::vector<client::AzimuthInterval> region = {{8667, 1733}, {5000, 5001}};
+      const std::uint8_t ring_mask = 0xB5;
+
+      enum Limit { NONE, REGION, SIZE };
+
+      for (const auto& packet_type : packet_types)
+      {
+        SetUp();
+        std::vector<std::vector<char>> packets;
+        for (int i = 0; i < packet_type.packets; ++i)
+        {
+          if (packet_type.type == 0x00)
+            packets.push_back(packet00(i));
+          else if (packet_type.type == 0x04)
+            packets.push_back(packet04(i));
+          else if (packet_type.returns == 1)
+            packets.push_back(packet06<1>(i));
+          else
+            packets.push_back(packet06<3>(i));
+        }
+
+        for (int return_selection : packet_type.return_selections)
+        {
+          for (Limit limit : {NONE, REGION, SIZE})
+          {
+            const bool in_region = (limit == REGION);
+            const std::uint8_t mask = in_region ? ring_mask : client::ALL_RINGS;
+            std::vector<ReferenceFiring> firings;
+            for (const auto& packet : packets)
+            {
+              if (packet_type.type == 0x00)
+                reference00(packet, return_selection, in_region, mask, firings);
+              else if (packet_type.type == 0x04)
+                reference04(packet, in_region, mask, firings);
+              else if (packet_type.returns == 1)
+                reference06<1>(packet, return_selection, in_region, firings);
+              else
+                reference06<3>(packet, return_selection, in_region, firings);
+            }
+
+            // the first cloud is half a revolution; limits drop it and cut the others short
+            std::size_t points = 0;
+            for (const auto& firing : firings)
+              points += firing.points.size();
+            const std::size_t points_per_revolution = points * packet_type.firings_per_revolution / firings.size();
+            const std::int32_t minimum = points_per_revolution * 6 / 10;
+            const std::int32_t maximum = points_per_revolution * 8 / 10;
+
+            const bool organized = (packet_type.type == 0x04) ||
+                                   (packet_type.type == 0x00 && return_selection != client::ALL_RETURNS);
+            std::vector<PointCloudHVDIRPtr> expected;
+
+            for (std::size_t threads : {0, 1, 2, 4})
+            {
+              client::PacketParserModule<Parser> module;
+              module.get<0>().setVerticalAngles(client::SensorType::M8);
+              module.get<1>().setVerticalAngles(client::SensorType::M8);
+              module.get<0>().setReturnSelection(return_selection);
+              module.get<1>().setReturnSelection(return_selection);
+              module.get<2>().setReturnSelection(return_selection);
+              if (limit == REGION)
+              {
+                module.get<0>().setRegionOfInterest(region, ring_mask);
+                module.get<1>().setRegionOfInterest(region, ring_mask);
+                module.get<2>().setRegionOfInterest(region);
+              }
+              else if (limit == SIZE)
+              {
+                module.get<0>().setCloudSizeLimits(minimum, maximum);
+                module.get<1>().setCloudSizeLimits(minimum, maximum);
+                module.get<2>().setCloudSizeLimits(minimum, maximum);
+              }
+
+              std::vector<PointCloudHVDIRPtr> clouds;
+              if (threads == 0)
+              {
+                for (const auto& packet : packets)
+                {
+                  PointCloudHVDIRPtr cloud;
+                  if (module.parse(packet, cloud))
+                    clouds.push_back(cloud);
+                }
+              }
+              else
+              {
+                module.setDecodeThreads(threads);
+                EXPECT_EQ(module.getDecodeThreads(), threads);
+                clouds = parseBatches(module, packets);
+              }
+
+              SCOPED_TRACE(::testing::Message() << "type " << static_cast<int>(packet_type.type)
+                           << " returns " << static_cast<int>(packet_type.returns)
+                           << " selection " << return_selection << " limit " << limit << " threads " << threads);
+
+              ASSERT_GE(clouds.size(), 2u);
+              const std::size_t skipped = expectReferenceClouds(clouds, firings, organized);
+              if (limit == SIZE)
+              {
+                EXPECT_GT(skipped, 0u);
+                for (const auto& cloud : clouds)
+                {
+                  EXPECT_GT(cloud->size(), static_cast<std::size_t>(minimum));
+                  // the firing that fills a cloud is kept whole
+                  EXPECT_LT(cloud->size(), static_cast<std::size_t>(maximum) +
+                                           client::M_SERIES_NUM_LASERS * client::M_SERIES_NUM_RETURNS);
+                }
+              }
+              else
+              {
+                EXPECT_EQ(skipped, 0u);
+              }
+
+              // stamps are interpolated the same way whichever way the packet was decoded
+              if (threads == 0)
+              {
+                expected = clouds;
+                continue;
+              }
+
+              ASSERT_EQ(clouds.size(), expected.size());
+              for (std::size_t i = 0; i < clouds.size(); ++i)
+              {
+                EXPECT_EQ(clouds[i]->header.stamp, expected[i]->header.stamp);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    TEST_F(TestMSeriesParser, Test_sectors)
+    {
+      // sectors put back together give the clouds, organized or not
+      for (int return_selection : {0, client::ALL_RETURNS})
+      {
+        SetUp();
+        client::DataPacketParser00 parser;
+        parser.setVerticalAngles(client::SensorType::M8);
+        parser.setReturnSelection(return_selection);
+        parser.setDegreesOfSweepPerSector(30.);
+        EXPECT_DOUBLE_EQ(parser.getDegreesOfSweepPerSector(), 30.);
+
+        // sectors of the next cloud may come before the cloud completed by the same packet
+        std::deque<PointCloudHVDIRPtr> sectors;
+        parser.connectSector([&sectors](const PointCloudHVDIRPtr& sector) { sectors.push_back(sector); });
+
+        int clouds = 0;
+        std::uint32_t sector_seq = 0;
+        for (int i = 0; i < 20; ++i)
+        {
+          PointCloudHVDIRPtr cloud;
+          if (!parser.parse(packet00(i), cloud))
+            continue;
+
+          ++clouds;
+
+          std::size_t offset = 0;
+          std::size_t cloud_sectors = 0;
+          while (offset < cloud->width)
+          {
+            ASSERT_FALSE(sectors.empty());
+            PointCloudHVDIRPtr sector = sectors.front();
+            sectors.pop_front();
+            ++cloud_sectors;
+
+            EXPECT_EQ(sector->header.seq, sector_seq++);
+            EXPECT_EQ(sector->height, cloud->height);
+            ASSERT_EQ(sector->size(), static_cast<std::size_t>(sector->width) * sector->height);
+            ASSERT_LE(offset + sector->width, cloud->width);
+
+            for (std::uint32_t row = 0; row < sector->height; ++row)
+            {
+              for (std::uint32_t column = 0; column < sector->width; ++column)
+              {
+                const PointHVDIR& point = sector->points[row * sector->width + column];
+                const PointHVDIR& expected = cloud->points[row * cloud->width + offset + column];
+                ASSERT_EQ(point.h, expected.h);
+                ASSERT_EQ(point.ring, expected.ring);
+                ASSERT_EQ(std::memcmp(&point.d, &expected.d, sizeof(float)), 0);
+              }
+            }
+
+            offset += sector->width;
+          }
+
+          // a full revolution in 30 degree sectors; the first cloud starts halfway
+          EXPECT_EQ(cloud_sectors, clouds == 1 ? 6u : 12u);
+        }
+
+        EXPECT_GT(clouds, 2);
+      }
+    }
+
+    TEST_F(TestMSeriesParser, Test_regionOfInterest)
+    {
+      // a wedge wrapping past count 0, a single count, and half the rings
+      const std::vector<client::AzimuthInterval> region = {{8667, 1733}, {5000, 5001}};
+      const std::uint8_t ring_mask = 0xB5;
+
+      // the encoder count a horizontal angle comes from
+      auto inRegion = [](float h)
+      {
+        long count = std::lround(h * client::M_SERIES_NUM_ROT_ANGLES / (2. * M_PI));
+        if (count < 0)
+          count += client::M_SERIES_NUM_ROT_ANGLES;
+        return count >= 8667 || count < 1733 || count == 5000;
+      };
+
+      typedef client::VariadicPacketParser<PointCloudHVDIRPtr,
+                                           client::DataPacketParser00,
+                                           client::DataPacketParser06> Parser;
+
+      // clouds complete at the same firings with the same stamps; only the points in the region are left
+      for (int return_selection : {0, client::ALL_RETURNS})
+      {
+        for (bool m1 : {false, true})
+        {
+          SetUp();
+          std::vector<std::vector<char>> packets;
+          for (int i = 0; i < (m1 ? 200 : 40); ++i)
+            packets.push_back(m1 ? packet06<3>(i) : packet00(i));
+
+          std::vector<PointCloudHVDIRPtr> expected;
+
+          for (std::size_t threads : {0, 1, 2})
+          {
+            client::PacketParserModule<Parser> module;
+            module.get<0>().setVerticalAngles(client::SensorType::M8);
+            module.get<0>().setReturnSelection(return_selection);
+            module.get<1>().setReturnSelection(return_selection);
+            if (threads != 0)
+            {
+              EXPECT_FALSE(module.get<0>().hasRegionOfInterest());
+              module.get<0>().setRegionOfInterest(region, ring_mask);
+              module.get<1>().setRegionOfInterest(region);
+              EXPECT_TRUE(module.get<0>().hasRegionOfInterest());
+              module.setDecodeThreads(threads);
+            }
+
+            auto clouds = parseBatches(module, packets);
+
+            if (threads == 0)
+            {
+              expected = clouds;
+              ASSERT_GT(expected.size(), 2u);
+              continue;
+            }
+
+            ASSERT_EQ(clouds.size(), expected.size()) << threads;
+            for (std::size_t i = 0; i < clouds.size(); ++i)
+            {
+              const PointCloudHVDIR& cloud = *clouds[i];
+              const PointCloudHVDIR& full = *expected[i];
+              EXPECT_EQ(cloud.header.stamp, full.header.stamp);
+              EXPECT_EQ(cloud.header.seq, full.header.seq);
+
+              const bool organized = (return_selection != client::ALL_RETURNS && !m1);
+              std::vector<PointHVDIR> points;
+              for (std::size_t j = 0; j < full.size(); ++j)
+              {
+                PointHVDIR point = full.points[j];
+                const bool in_ring = m1 || (ring_mask & (1u << point.ring));
+                if (!inRegion(point.h) || (!organized && !in_ring))
+                  continue;
+
+                // organized clouds keep their rows
+                if (!in_ring)
+                  point.d = std::numeric_limits<float>::quiet_NaN();
+                points.push_back(point);
+              }
+
+              ASSERT_EQ(cloud.size(), points.size()) << threads;
+              ASSERT_GT(cloud.size(), 0u);
+              EXPECT_EQ(cloud.height, organized ? static_cast<std::uint32_t>(client::M_SERIES_NUM_LASERS) : 1u);
+              EXPECT_EQ(cloud.is_dense, !organized && full.is_dense);
+              for (std::size_t j = 0; j < points.size(); ++j)
+              {
+                const PointHVDIR& point = cloud.points[j];
+                ASSERT_EQ(point.h, points[j].h) << threads;
+                ASSERT_EQ(point.ring, points[j].ring) << threads;
+                ASSERT_EQ(point.intensity, points[j].intensity) << threads;
+                ASSERT_EQ(std::memcmp(&point.d, &points[j].d, sizeof(float)), 0) << threads;
+              }
+            }
+          }
+        }
+      }
+
+      client::DataPacketParser06 parser;
+      EXPECT_THROW(parser.setRegionOfInterest({{0, client::M_SERIES_NUM_ROT_ANGLES + 1}}), client::InvalidRegionOfInterest);
+      EXPECT_THROW(parser.setRegionOfInterest({{-1, 100}}), client::InvalidRegionOfInterest);
+      parser.setRegionOfInterest({}, 0xFE);
+      EXPECT_TRUE(parser.hasRegionOfInterest());
+      parser.setRegionOfInterest({});
+      EXPECT_FALSE(parser.hasRegionOfInterest());
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,113 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/client/packet_buffer_pool.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks PacketBufferPool recycling and its exhaustion and high water counters. */
+    class TestPacketBufferPool : public ::testing::Test
+    {
+    public:
+      typedef client::PacketBufferPool PoolType;
+
+      TestPacketBufferPool()
+      {
+      }
+
+      virtual ~TestPacketBufferPool()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+    };
+
+    TEST_F(TestPacketBufferPool, Test_recycle)
+    {
+      PoolType pool(1, 256);
+      EXPECT_EQ(1u, pool.capacity());
+
+      PoolType::BufferType buffer = pool.acquire(100);
+      std::vector<char>* raw = buffer.get();
+      EXPECT_EQ(100u, buffer->size());
+      EXPECT_GE(buffer->capacity(), 256u);
+      EXPECT_EQ(1u, pool.inUse());
+
+      PoolType::setArrivalTime(buffer, 1234);
+      EXPECT_EQ(1234u, PoolType::arrivalTime(buffer));
+      buffer.reset();
+      EXPECT_EQ(0u, pool.inUse());
+
+      // the same vector comes back, resized, with a fresh arrival time
+      buffer = pool.acquire(200);
+      EXPECT_EQ(raw, buffer.get());
+      EXPECT_EQ(200u, buffer->size());
+      EXPECT_EQ(0u, PoolType::arrivalTime(buffer));
+      EXPECT_EQ(0u, pool.exhaustedCount());
+
+      // buffers not from a pool have no arrival time
+      PoolType::BufferType other = std::make_shared<std::vector<char>>(10);
+      PoolType::setArrivalTime(other, 1234);
+      EXPECT_EQ(0u, PoolType::arrivalTime(other));
+    }
+
+    TEST_F(TestPacketBufferPool, Test_exhaustion)
+    {
+      PoolType pool(2, 64);
+
+      std::vector<PoolType::BufferType> buffers;
+      for (int i = 0; i < 5; ++i)
+        buffers.push_back(pool.acquire(128));
+
+      // three transient buffers, each reserved for the larger of the request and the reserve
+      EXPECT_EQ(3u, pool.exhaustedCount());
+      EXPECT_EQ(5u, pool.inUse());
+      EXPECT_EQ(5u, pool.highWaterMark());
+      EXPECT_GE(buffers.back()->capacity(), 128u);
+
+      // the pool keeps two; the rest are freed
+      buffers.clear();
+      EXPECT_EQ(0u, pool.inUse());
+      EXPECT_EQ(5u, pool.highWaterMark());
+
+      for (int i = 0; i < 2; ++i)
+        buffers.push_back(pool.acquire(128));
+
+      EXPECT_EQ(3u, pool.exhaustedCount());
+      EXPECT_EQ(5u, pool.highWaterMark());
+
+      buffers.push_back(pool.acquire(128));
+      EXPECT_EQ(4u, pool.exhaustedCount());
+    }
+
+    TEST_F(TestPacketBufferPool, Test_outlivePool)
+    {
+      PoolType::BufferType buffer;
+      {
+        PoolType pool(1);
+        buffer = pool.acquire(10);
+        PoolType::setArrivalTime(buffer, 99);
+      }
+
+      // still usable, and releasing it after the pool is gone frees it
+      EXPECT_EQ(10u, buffer->size());
+      EXPECT_EQ(99u, PoolType::arrivalTime(buffer));
+      buffer.reset();
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
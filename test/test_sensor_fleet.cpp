@@ -0,0 +1,173 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <gtest/gtest.h>
+#include <quanergy/client/sensor_fleet.h>
+
+#include "loopback_server.h"
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Runs several loopback sensors on shared io and dispatch threads in each handoff mode. */
+    class TestSensorFleet : public ::testing::TestWithParam<client::HandoffMode>
+    {
+    public:
+
+      TestSensorFleet()
+      {
+      }
+
+      virtual ~TestSensorFleet()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      /// what one sensor signaled
+      struct Received
+      {
+        std::mutex                  mutex;
+        std::vector<std::uint32_t>  sequences;
+        std::atomic<int>            in_slot {0};
+        std::atomic<bool>           concurrent {false};
+        std::atomic<bool>           corrupt {false};
+      };
+    };
+
+    TEST_P(TestSensorFleet, Test_perSensorOrder)
+    {
+      const std::size_t sensors = 5;
+      const std::uint32_t count = 400;
+      const std::size_t queue_size = 16;
+
+      // each sensor sends its own numbered packets in bursts
+      std::vector<std::unique_ptr<LoopbackServer>> servers;
+      std::vector<std::vector<std::vector<char>>> sent(sensors);
+      for (std::size_t s = 0; s < sensors; ++s)
+      {
+        LoopbackServer::Chunks chunks;
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+          if (i % 20 == 0)
+            chunks.emplace_back();
+
+          sent[s].push_back(makePacket(i % 3 ? 200 : 6632, static_cast<std::uint32_t>(s * 100000 + i)));
+          chunks.back().insert(chunks.back().end(), sent[s].back().begin(), sent[s].back().end());
+        }
+
+        servers.emplace_back(new LoopbackServer());
+        servers.back()->serve(chunks, std::chrono::milliseconds(1));
+      }
+
+      client::SensorFleet fleet(2, 2);
+      std::vector<std::unique_ptr<Received>> received;
+      for (std::size_t s = 0; s < sensors; ++s)
+      {
+        client::SensorClient& sensor = fleet.addSensor("127.0.0.1", servers[s]->port(), queue_size);
+        sensor.setHandoffMode(GetParam());
+        sensor.setReceiveMode(s % 2 ? client::ReceiveMode::BULK : client::ReceiveMode::PER_PACKET);
+
+        // waiting would stall the other sensors on the io thread
+        EXPECT_THROW(sensor.setBackpressurePolicy(common::BackpressurePolicy::BLOCK_PRODUCER),
+                     std::invalid_argument);
+
+        received.emplace_back(new Received());
+        Received* r = received.back().get();
+        const std::vector<std::vector<char>>* expected = &sent[s];
+        sensor.connect([r, expected](const client::SensorClient::ResultType& packet)
+                       {
+                         if (r->in_slot.fetch_add(1) != 0)
+                           r->concurrent = true;
+
+                         auto header = reinterpret_cast<const client::PacketHeader*>(packet->data());
+                         std::uint32_t sequence = client::deserialize(header->seconds);
+                         std::uint32_t i = sequence % 100000;
+                         if (i >= expected->size() || *packet != (*expected)[i])
+                           r->corrupt = true;
+
+                         {
+                           std::lock_guard<std::mutex> lk(r->mutex);
+                           r->sequences.push_back(sequence);
+                         }
+
+                         r->in_slot.fetch_sub(1);
+                       });
+      }
+
+      std::exception_ptr eptr;
+      std::thread thread([&fleet, &eptr]
+                         {
+                           try
+                           {
+                             fleet.run();
+                           }
+                           catch (...)
+                           {
+                             eptr = std::current_exception();
+                           }
+                         });
+
+      // every packet is either signaled or counted as dropped; queued ones must not get stranded
+      auto done = [&]
+      {
+        for (std::size_t s = 0; s < sensors; ++s)
+        {
+          std::lock_guard<std::mutex> lk(received[s]->mutex);
+          if (received[s]->sequences.size() + fleet.sensor(s).queueStatistics().dropped_items < count)
+            return false;
+        }
+
+        return true;
+      };
+
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      while (!done() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+      EXPECT_TRUE(done());
+
+      fleet.stop();
+      thread.join();
+      for (auto& server : servers)
+        server->join();
+
+      EXPECT_FALSE(eptr);
+
+      for (std::size_t s = 0; s < sensors; ++s)
+      {
+        const Received& r = *received[s];
+        EXPECT_FALSE(r.concurrent) << s;
+        EXPECT_FALSE(r.corrupt) << s;
+        EXPECT_FALSE(fleet.sensor(s).error()) << s;
+
+        // in order and only this sensor's packets
+        ASSERT_FALSE(r.sequences.empty()) << s;
+        EXPECT_EQ(s, r.sequences.front() / 100000) << s;
+        for (std::size_t i = 1; i < r.sequences.size(); ++i)
+        {
+          EXPECT_EQ(s, r.sequences[i] / 100000) << s;
+          EXPECT_LT(r.sequences[i - 1], r.sequences[i]) << s;
+        }
+
+        EXPECT_EQ(count, r.sequences.size() + fleet.sensor(s).queueStatistics().dropped_items) << s;
+      }
+    }
+
+    INSTANTIATE_TEST_CASE_P(HandoffModes, TestSensorFleet,
+                            ::testing::Values(client::HandoffMode::LOCKED_QUEUE,
+                                              client::HandoffMode::SPSC_RING));
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,75 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include <quanergy/common/sin_cos_table.h>
+#include <quanergy/parsers/data_packet_parser_m_series.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks SinCosTable against std::sin and std::cos on and off its grid. */
+    class TestSinCosTable : public ::testing::Test
+    {
+    public:
+
+      TestSinCosTable()
+      {
+      }
+
+      virtual ~TestSinCosTable()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      void expectNear(double angle)
+      {
+        double sin, cos;
+        common::SinCosTable::instance().sinCos(angle, sin, cos);
+        EXPECT_NEAR(sin, std::sin(angle), 1E-11) << angle;
+        EXPECT_NEAR(cos, std::cos(angle), 1E-11) << angle;
+      }
+    };
+
+    TEST_F(TestSinCosTable, Test_accuracy)
+    {
+      // the horizontal angles of M-series firings, as the parsers compute them and stored as float
+      for (int i = 0; i <= client::M_SERIES_NUM_ROT_ANGLES; ++i)
+      {
+        int j = (i + client::M_SERIES_NUM_ROT_ANGLES / 2) % client::M_SERIES_NUM_ROT_ANGLES;
+        double angle = static_cast<double>(j) / client::M_SERIES_NUM_ROT_ANGLES * 2. * M_PI - M_PI;
+        expectNear(angle);
+        expectNear(static_cast<float>(angle));
+      }
+
+      // laser elevations, which are off the grid
+      for (double angle : client::M8_VERTICAL_ANGLES)
+        expectNear(static_cast<float>(angle));
+      for (double angle : client::MQ8_VERTICAL_ANGLES)
+        expectNear(static_cast<float>(angle));
+
+      // anywhere in between, and past a revolution either way
+      for (double angle = -20.; angle < 20.; angle += 0.000123)
+        expectNear(angle);
+
+      double sin, cos;
+      common::SinCosTable::instance().sinCos(std::nan(""), sin, cos);
+      EXPECT_TRUE(std::isnan(sin));
+      EXPECT_TRUE(std::isnan(cos));
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
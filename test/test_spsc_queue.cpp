@@ -0,0 +1,167 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <thread>
+#include <gtest/gtest.h>
+#include <quanergy/client/spsc_queue.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Checks SPSCQueue bounds and ordering and the SpinParkWaiter wake-up protocol. */
+    class TestSPSCQueue : public ::testing::Test
+    {
+    public:
+
+      TestSPSCQueue()
+      {
+      }
+
+      virtual ~TestSPSCQueue()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      /// push count values from one thread and pop them on another, waiting with waiter
+      void stress(std::size_t capacity, std::size_t count, client::SpinParkWaiter& waiter)
+      {
+        client::SPSCQueue<std::size_t> queue(capacity);
+        std::atomic<bool> done {false};
+        std::atomic<std::size_t> max_size {0};
+
+        std::thread producer([&]
+                             {
+                               for (std::size_t i = 0; i < count; ++i)
+                               {
+                                 std::size_t value = i;
+                                 while (!queue.push(std::move(value)))
+                                   std::this_thread::yield();
+
+                                 waiter.notify();
+                               }
+
+                               done = true;
+                               waiter.notifyAll();
+                             });
+
+        std::size_t expected = 0;
+        std::size_t value = 0;
+        while (expected < count)
+        {
+          waiter.wait([&]{return (!queue.empty() || done);});
+
+          max_size = std::max<std::size_t>(max_size, queue.size());
+          while (queue.pop(value))
+          {
+            ASSERT_EQ(expected, value);
+            ++expected;
+          }
+        }
+
+        producer.join();
+
+        EXPECT_EQ(count, expected);
+        EXPECT_TRUE(queue.empty());
+        EXPECT_FALSE(queue.pop(value));
+        EXPECT_LE(max_size, capacity);
+      }
+    };
+
+    TEST_F(TestSPSCQueue, Test_fullEmpty)
+    {
+      // not a power of two; the storage is rounded up but the capacity is not
+      client::SPSCQueue<int> queue(5);
+      EXPECT_EQ(5u, queue.capacity());
+      EXPECT_TRUE(queue.empty());
+
+      int value = -1;
+      EXPECT_FALSE(queue.pop(value));
+      EXPECT_EQ(-1, value);
+
+      for (int i = 0; i < 5; ++i)
+      {
+        int item = i;
+        EXPECT_TRUE(queue.push(std::move(item)));
+      }
+
+      EXPECT_EQ(5u, queue.size());
+
+      int rejected = 5;
+      EXPECT_FALSE(queue.push(std::move(rejected)));
+      EXPECT_EQ(5, rejected);
+
+      for (int i = 0; i < 5; ++i)
+      {
+        EXPECT_TRUE(queue.pop(value));
+        EXPECT_EQ(i, value);
+      }
+
+      EXPECT_TRUE(queue.empty());
+      EXPECT_FALSE(queue.pop(value));
+    }
+
+    TEST_F(TestSPSCQueue, Test_wrapAround)
+    {
+      client::SPSCQueue<int> queue(3);
+
+      // stay partly full while the indices pass the storage size many times
+      int next_push = 0;
+      int next_pop = 0;
+      for (int round = 0; round < 100; ++round)
+      {
+        while (queue.size() < queue.capacity())
+        {
+          int item = next_push;
+          ASSERT_TRUE(queue.push(std::move(item)));
+          ++next_push;
+        }
+
+        int extra = next_push;
+        EXPECT_FALSE(queue.push(std::move(extra)));
+
+        for (int i = 0; i < 1 + round % 3; ++i)
+        {
+          int value = -1;
+          ASSERT_TRUE(queue.pop(value));
+          EXPECT_EQ(next_pop, value);
+          ++next_pop;
+        }
+      }
+
+      int value = -1;
+      while (queue.pop(value))
+      {
+        EXPECT_EQ(next_pop, value);
+        ++next_pop;
+      }
+
+      EXPECT_EQ(next_push, next_pop);
+    }
+
+    TEST_F(TestSPSCQueue, Test_stressSpinning)
+    {
+      client::SpinParkWaiter waiter;
+      stress(100, 200000, waiter);
+    }
+
+    TEST_F(TestSPSCQueue, Test_stressParking)
+    {
+      // no spinning, so the consumer parks whenever it catches up and relies on notify
+      client::SpinParkWaiter waiter(0);
+      stress(7, 200000, waiter);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,458 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <gtest/gtest.h>
+#include <quanergy/client/sensor_client.h>
+
+#include "loopback_server.h"
+
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sched.h>
+#endif
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Feeds SensorClient scripted byte streams over loopback in each receive mode. */
+    class TestTCPClient : public ::testing::TestWithParam<client::ReceiveMode>
+    {
+    public:
+
+      TestTCPClient()
+      {
+      }
+
+      virtual ~TestTCPClient()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      /// concatenate packets of the given sizes, numbered from 0
+      static std::vector<char> stream(const std::vector<std::uint32_t>& sizes,
+                                      std::vector<std::vector<char>>& packets)
+      {
+        std::vector<char> ret;
+        for (std::uint32_t size : sizes)
+        {
+          packets.push_back(makePacket(size, static_cast<std::uint32_t>(packets.size())));
+          ret.insert(ret.end(), packets.back().begin(), packets.back().end());
+        }
+
+        return ret;
+      }
+
+      /// cut bytes into chunks, cycling through the chunk sizes
+      static LoopbackServer::Chunks cut(const std::vector<char>& bytes, const std::vector<std::size_t>& chunk_sizes)
+      {
+        LoopbackServer::Chunks ret;
+        std::size_t offset = 0;
+        for (std::size_t i = 0; offset < bytes.size(); ++i)
+        {
+          std::size_t size = std::min(chunk_sizes[i % chunk_sizes.size()], bytes.size() - offset);
+          ret.emplace_back(bytes.begin() + offset, bytes.begin() + offset + size);
+          offset += size;
+        }
+
+        return ret;
+      }
+
+      /// run the client against the server until count packets were signaled, then stop it
+      std::exception_ptr receive(client::SensorClient& client, LoopbackServer& server,
+                                 PacketCollector& collector, std::size_t count)
+      {
+        client.setReceiveMode(GetParam());
+        client.connect([&collector](const client::SensorClient::ResultType& packet) { collector(packet); });
+
+        std::exception_ptr eptr;
+        std::thread thread([&client, &eptr]
+                           {
+                             try
+                             {
+                               client.run();
+                             }
+                             catch (...)
+                             {
+                               eptr = std::current_exception();
+                             }
+                           });
+
+        EXPECT_TRUE(collector.waitFor(count));
+        client.stop();
+        thread.join();
+        server.join();
+
+        return eptr;
+      }
+    };
+
+    TEST_P(TestTCPClient, Test_splitReads)
+    {
+      // cuts land inside headers, inside bodies and across packet boundaries
+      std::vector<std::vector<char>> packets;
+      auto bytes = stream(std::vector<std::uint32_t>(12, 6632), packets);
+
+      LoopbackServer server;
+      server.serve(cut(bytes, {7, 13, 777, 4000, 1}), std::chrono::milliseconds(1));
+
+      client::SensorClient client("127.0.0.1", server.port());
+      client.setBulkReadSize(1024);
+
+      PacketCollector collector;
+      EXPECT_FALSE(receive(client, server, collector, packets.size()));
+      EXPECT_TRUE(packets == collector.packets());
+      EXPECT_EQ(0u, client.framingStatistics().resyncs);
+    }
+
+    TEST_P(TestTCPClient, Test_severalPerRead)
+    {
+      // many packets per write, and packet sizes changing mid read
+      std::vector<std::vector<char>> packets;
+      std::vector<std::uint32_t> sizes(50, 200);
+      sizes.insert(sizes.end(), 10, 6632);
+      sizes.insert(sizes.end(), 30, 100);
+      sizes.insert(sizes.end(), {6632, 200, 6632, 100, 100, 6632});
+      auto bytes = stream(sizes, packets);
+
+      LoopbackServer server;
+      server.serve(cut(bytes, {bytes.size() / 2 + 3, bytes.size()}));
+
+      client::SensorClient client("127.0.0.1", server.port());
+
+      PacketCollector collector;
+      EXPECT_FALSE(receive(client, server, collector, packets.size()));
+      EXPECT_TRUE(packets == collector.packets());
+      EXPECT_EQ(0u, client.framingStatistics().resyncs);
+    }
+
+    TEST_P(TestTCPClient, Test_resync)
+    {
+      // bytes that never form a plausible header, a header of an unknown type and one too large
+      std::vector<char> noise(37, 0x5A);
+      std::vector<char> unknown_type = makePacket(100, 0, 0x7F);
+      unknown_type.resize(sizeof(client::PacketHeader) + 11);
+      std::vector<char> too_large = makePacket(sizeof(client::PacketHeader), 0);
+      reinterpret_cast<client::PacketHeader*>(too_large.data())->size = htonl(0x7FFFFFFF);
+
+      std::vector<std::vector<char>> packets;
+      std::vector<char> bytes;
+      std::uint64_t garbage_bytes = 0;
+      for (std::uint32_t i = 0; i < 12; ++i)
+      {
+        packets.push_back(makePacket(i % 2 ? 6632 : 200, i));
+        bytes.insert(bytes.end(), packets.back().begin(), packets.back().end());
+
+        std::vector<char> garbage;
+        if (i == 2)
+          garbage = noise;
+        else if (i == 5)
+          garbage = unknown_type;
+        else if (i == 8)
+        {
+          garbage = too_large;
+          garbage.insert(garbage.end(), noise.begin(), noise.end());
+        }
+
+        bytes.insert(bytes.end(), garbage.begin(), garbage.end());
+        garbage_bytes += garbage.size();
+      }
+
+      // garbage within a read and garbage straddling reads
+      for (const auto& chunk_sizes : std::vector<std::vector<std::size_t>>{{bytes.size()}, {7, 13, 777, 4000, 1}})
+      {
+        LoopbackServer server;
+        server.serve(cut(bytes, chunk_sizes), std::chrono::milliseconds(1));
+
+        client::SensorClient client("127.0.0.1", server.port());
+        client.setResync(true);
+        client.setMaxPacketSize(1024 * 1024);
+        client.setBulkReadSize(1024);
+
+        PacketCollector collector;
+        EXPECT_FALSE(receive(client, server, collector, packets.size()));
+        EXPECT_TRUE(packets == collector.packets());
+        EXPECT_EQ(3u, client.framingStatistics().resyncs);
+        EXPECT_EQ(garbage_bytes, client.framingStatistics().skipped_bytes);
+      }
+    }
+
+    TEST_P(TestTCPClient, Test_invalidHeaderWithoutResync)
+    {
+      std::vector<char> bytes = makePacket(200, 0);
+      bytes.insert(bytes.end(), 37, 0x5A);
+      std::vector<char> packet = makePacket(200, 1);
+      bytes.insert(bytes.end(), packet.begin(), packet.end());
+
+      LoopbackServer server;
+      server.serve(LoopbackServer::Chunks(1, bytes));
+
+      client::SensorClient client("127.0.0.1", server.port());
+      client.setReceiveMode(GetParam());
+
+      // the client stops itself
+      EXPECT_THROW(client.run(), client::InvalidHeaderError);
+      server.join();
+      EXPECT_EQ(0u, client.framingStatistics().resyncs);
+    }
+
+    TEST_P(TestTCPClient, Test_runAgainAfterStop)
+    {
+      // the second run gets a fresh connection with nothing left over from the first
+      std::vector<std::vector<char>> packets;
+      auto first_bytes = stream(std::vector<std::uint32_t>(20, 6632), packets);
+      auto second_bytes = stream(std::vector<std::uint32_t>(20, 200), packets);
+
+      LoopbackServer server;
+      server.serve(std::vector<LoopbackServer::Chunks>{cut(first_bytes, {1000}), cut(second_bytes, {1000})});
+
+      client::SensorClient client("127.0.0.1", server.port());
+      client.setReceiveMode(GetParam());
+
+      PacketCollector collector;
+      client.connect([&collector](const client::SensorClient::ResultType& packet) { collector(packet); });
+
+      for (std::size_t run = 0; run < 2; ++run)
+      {
+        std::exception_ptr eptr;
+        std::thread thread([&client, &eptr]
+                           {
+                             try
+                             {
+                               client.run();
+                             }
+                             catch (...)
+                             {
+                               eptr = std::current_exception();
+                             }
+                           });
+
+        EXPECT_TRUE(collector.waitFor(run == 0 ? 20 : 40));
+        client.stop();
+        thread.join();
+        EXPECT_FALSE(eptr) << run;
+      }
+
+      server.join();
+
+      EXPECT_TRUE(packets == collector.packets());
+    }
+
+    INSTANTIATE_TEST_CASE_P(ReceiveModes, TestTCPClient,
+                            ::testing::Values(client::ReceiveMode::PER_PACKET,
+                                              client::ReceiveMode::BULK,
+                                              client::ReceiveMode::IO_URING));
+
+    /** \brief Checks reconnect backoff and the connect timeout against loopback ports. */
+    class TestTCPClientConnect : public ::testing::Test
+    {
+    public:
+
+      TestTCPClientConnect()
+      {
+      }
+
+      virtual ~TestTCPClientConnect()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+
+      /// a loopback port nobody listens on, so connecting is refused right away
+      static std::string refusedPort()
+      {
+        boost::asio::io_service io_service;
+        boost::asio::ip::tcp::acceptor acceptor(io_service, boost::asio::ip::tcp::endpoint(
+                                                  boost::asio::ip::address_v4::loopback(), 0));
+        return std::to_string(acceptor.local_endpoint().port());
+      }
+    };
+
+    TEST_F(TestTCPClientConnect, Test_backoff)
+    {
+      const std::chrono::milliseconds initial(20);
+      const std::chrono::milliseconds max(80);
+
+      client::SensorClient client("127.0.0.1", refusedPort());
+      client.setReconnect(true, initial, max);
+
+      std::thread thread([&client]
+                         {
+                           EXPECT_NO_THROW(client.run());
+                         });
+
+      // note when each attempt happens
+      std::vector<std::chrono::steady_clock::time_point> attempts;
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(700);
+      std::uint64_t seen = 0;
+      while (std::chrono::steady_clock::now() < deadline)
+      {
+        std::uint64_t count = client.connectionStatistics().connect_attempts;
+        if (count != seen)
+        {
+          attempts.push_back(std::chrono::steady_clock::now());
+          seen = count;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+
+      client.stop();
+      thread.join();
+
+      EXPECT_EQ(0u, client.connectionStatistics().connects);
+      EXPECT_EQ(client.connectionStatistics().connect_attempts, client.connectionStatistics().connect_failures);
+
+      // doubling from 20 ms, then held at 80 ms; timers never fire early, so measured from the
+      // first attempt each one comes no sooner than the sum of the delays before it
+      ASSERT_GE(attempts.size(), 6u);
+      std::chrono::milliseconds delay = initial;
+      std::chrono::milliseconds total(0);
+      for (std::size_t i = 1; i < attempts.size(); ++i)
+      {
+        total += delay;
+        auto since_first = std::chrono::duration_cast<std::chrono::milliseconds>(attempts[i] - attempts.front());
+        EXPECT_GE(since_first.count(), total.count() - 5) << i;
+
+        auto interval = std::chrono::duration_cast<std::chrono::milliseconds>(attempts[i] - attempts[i - 1]);
+        if (delay == max)
+        {
+          EXPECT_LT(interval.count(), 2 * max.count()) << i;
+        }
+
+        delay = std::min(delay * 2, max);
+      }
+    }
+
+    TEST_F(TestTCPClientConnect, Test_connectTimeout)
+    {
+      // with its backlog full, the listener ignores further connection attempts
+      boost::asio::io_service io_service;
+      boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), 0);
+      boost::asio::ip::tcp::acceptor acceptor(io_service);
+      acceptor.open(endpoint.protocol());
+      acceptor.bind(endpoint);
+      acceptor.listen(0);
+
+      std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> fillers;
+      for (int i = 0; i < 4; ++i)
+      {
+        fillers.emplace_back(new boost::asio::ip::tcp::socket(io_service));
+        fillers.back()->async_connect(acceptor.local_endpoint(), [](const boost::system::error_code&) {});
+      }
+
+      client::SensorClient client("127.0.0.1", std::to_string(acceptor.local_endpoint().port()));
+      client.setConnectTimeout(std::chrono::milliseconds(100));
+
+      auto start = std::chrono::steady_clock::now();
+      EXPECT_THROW(client.run(), client::SocketBindError);
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+      EXPECT_GE(elapsed.count(), 100);
+      EXPECT_LT(elapsed.count(), 1000);
+      EXPECT_EQ(1u, client.connectionStatistics().connect_attempts);
+      EXPECT_EQ(1u, client.connectionStatistics().connect_timeouts);
+      EXPECT_EQ(1u, client.connectionStatistics().connect_failures);
+    }
+
+#ifdef __linux__
+    TEST_F(TestTCPClientConnect, Test_ioThreadOptionsRestored)
+    {
+      cpu_set_t before;
+      ASSERT_EQ(0, pthread_getaffinity_np(pthread_self(), sizeof(before), &before));
+      int policy_before = 0;
+      sched_param param_before;
+      ASSERT_EQ(0, pthread_getschedparam(pthread_self(), &policy_before, &param_before));
+
+      client::TCPClientOptions options;
+      options.io_thread.cpus = {0};
+      options.io_thread.policy = client::SchedulingPolicy::FIFO;
+      options.io_thread.priority = 1;
+
+      client::SensorClient client("127.0.0.1", refusedPort());
+      client.setOptions(options);
+      EXPECT_THROW(client.run(), client::SocketBindError);
+      EXPECT_TRUE(client.appliedOptions().io_thread.affinity);
+
+      // the calling thread is back as it was, whether or not real-time scheduling was allowed
+      cpu_set_t after;
+      ASSERT_EQ(0, pthread_getaffinity_np(pthread_self(), sizeof(after), &after));
+      EXPECT_TRUE(CPU_EQUAL(&before, &after));
+
+      int policy_after = 0;
+      sched_param param_after;
+      ASSERT_EQ(0, pthread_getschedparam(pthread_self(), &policy_after, &param_after));
+      EXPECT_EQ(policy_before, policy_after);
+      EXPECT_EQ(param_before.sched_priority, param_after.sched_priority);
+    }
+#endif
+
+    /** \brief Checks the silent header check used to resynchronize. */
+    class TestPacketHeader : public ::testing::Test
+    {
+    public:
+
+      TestPacketHeader()
+      {
+      }
+
+      virtual ~TestPacketHeader()
+      {
+      }
+
+      virtual void SetUp()
+      {
+      }
+
+      virtual void TearDown()
+      {
+      }
+    };
+
+    TEST_F(TestPacketHeader, Test_isPlausibleHeader)
+    {
+      const std::size_t max_packet_size = 10000;
+      auto header = [](const std::vector<char>& packet)
+      {
+        return *reinterpret_cast<const client::PacketHeader*>(packet.data());
+      };
+
+      for (std::uint8_t type : {0x00, 0x01, 0x04, 0x06})
+        EXPECT_TRUE(client::isPlausibleHeader(header(makePacket(6632, 0, type)), max_packet_size));
+
+      EXPECT_FALSE(client::isPlausibleHeader(header(makePacket(6632, 0, 0x02)), max_packet_size));
+      EXPECT_FALSE(client::isPlausibleHeader(header(makePacket(6632, 0, 0xFF)), max_packet_size));
+
+      // size bounds are inclusive
+      EXPECT_TRUE(client::isPlausibleHeader(header(makePacket(sizeof(client::PacketHeader), 0)), max_packet_size));
+      EXPECT_TRUE(client::isPlausibleHeader(header(makePacket(max_packet_size, 0)), max_packet_size));
+      EXPECT_FALSE(client::isPlausibleHeader(header(makePacket(max_packet_size + 1, 0)), max_packet_size));
+
+      auto packet = makePacket(100, 0);
+      reinterpret_cast<client::PacketHeader*>(packet.data())->size = htonl(sizeof(client::PacketHeader) - 1);
+      EXPECT_FALSE(client::isPlausibleHeader(header(packet), max_packet_size));
+
+      packet = makePacket(100, 0);
+      packet[1] ^= 0x01;
+      EXPECT_FALSE(client::isPlausibleHeader(header(packet), max_packet_size));
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
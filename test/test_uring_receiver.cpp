@@ -0,0 +1,189 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <thread>
+#include <functional>
+#include <gtest/gtest.h>
+#include <quanergy/client/uring_receiver.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /** \brief Receives over a loopback connection with UringReceiver; skipped where io_uring
+     *         multishot receive is not available.
+     */
+    class TestUringReceiver : public ::testing::Test
+    {
+    public:
+
+      TestUringReceiver()
+        : acceptor_(io_service_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+        , client_(io_service_)
+        , server_(io_service_)
+        , timer_(io_service_)
+      {
+      }
+
+      virtual ~TestUringReceiver()
+      {
+      }
+
+      virtual void SetUp()
+      {
+        client_.connect(acceptor_.local_endpoint());
+        acceptor_.accept(server_);
+      }
+
+      virtual void TearDown()
+      {
+        if (sender_.joinable())
+          sender_.join();
+      }
+
+      /// make a receiver, or null if io_uring is not available here
+      std::unique_ptr<client::UringReceiver> makeReceiver(std::size_t buffer_count, std::size_t buffer_size)
+      {
+        try
+        {
+          return std::unique_ptr<client::UringReceiver>(
+            new client::UringReceiver(io_service_, client_, buffer_count, buffer_size));
+        }
+        catch (boost::system::system_error& e)
+        {
+          std::cout << "io_uring not available: " << e.what() << std::endl;
+          return nullptr;
+        }
+      }
+
+      /// write bytes from another thread in chunks, then optionally close
+      void send(const std::vector<char>& bytes, std::size_t chunk_size, bool close)
+      {
+        sender_ = std::thread([this, bytes, chunk_size, close]
+                              {
+                                boost::system::error_code error;
+                                for (std::size_t offset = 0; offset < bytes.size() && !error; offset += chunk_size)
+                                {
+                                  boost::asio::write(server_, boost::asio::buffer(
+                                    bytes.data() + offset, std::min(chunk_size, bytes.size() - offset)), error);
+                                }
+
+                                if (close)
+                                  server_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, error);
+                              });
+      }
+
+      /// reap until count bytes arrived or an error, for at most 5 s
+      boost::system::error_code receive(client::UringReceiver& receiver, std::size_t count, std::vector<char>& received)
+      {
+        boost::system::error_code result;
+        bool timed_out = false;
+
+        std::function<void ()> wait = [&]
+        {
+          receiver.asyncWait([&](const boost::system::error_code& error)
+                             {
+                               result = error;
+                               if (!result)
+                               {
+                                 receiver.reap([&](const char* data, std::size_t size)
+                                               {
+                                                 received.insert(received.end(), data, data + size);
+                                               }, result);
+                               }
+
+                               if (!result && received.size() < count)
+                                 wait();
+                               else
+                                 timer_.cancel();
+                             });
+        };
+
+        timer_.expires_from_now(std::chrono::seconds(5));
+        timer_.async_wait([&](const boost::system::error_code& error)
+                          {
+                            if (!error)
+                            {
+                              timed_out = true;
+                              io_service_.stop();
+                            }
+                          });
+
+        wait();
+        io_service_.reset();
+        io_service_.run();
+
+        EXPECT_FALSE(timed_out);
+        return result;
+      }
+
+      static std::vector<char> pattern(std::size_t size)
+      {
+        std::vector<char> ret(size);
+        for (std::size_t i = 0; i < size; ++i)
+          ret[i] = static_cast<char>(i * 31 + i / 251);
+
+        return ret;
+      }
+
+    protected:
+      boost::asio::io_service         io_service_;
+      boost::asio::ip::tcp::acceptor  acceptor_;
+      boost::asio::ip::tcp::socket    client_;
+      boost::asio::ip::tcp::socket    server_;
+      boost::asio::steady_timer       timer_;
+      std::thread                     sender_;
+    };
+
+    TEST_F(TestUringReceiver, Test_receiveInOrder)
+    {
+      // few small buffers, so the kernel runs out and the receive has to be armed again
+      auto receiver = makeReceiver(4, 256);
+      if (!receiver)
+        GTEST_SKIP();
+
+      std::vector<char> bytes = pattern(1 << 20);
+      send(bytes, 10000, false);
+
+      std::vector<char> received;
+      EXPECT_FALSE(receive(*receiver, bytes.size(), received));
+      EXPECT_TRUE(bytes == received);
+    }
+
+    TEST_F(TestUringReceiver, Test_eof)
+    {
+      auto receiver = makeReceiver(8, 1024);
+      if (!receiver)
+        GTEST_SKIP();
+
+      std::vector<char> bytes = pattern(5000);
+      send(bytes, 777, true);
+
+      std::vector<char> received;
+      EXPECT_EQ(boost::asio::error::eof, receive(*receiver, bytes.size() + 1, received));
+      EXPECT_TRUE(bytes == received);
+    }
+
+    TEST_F(TestUringReceiver, Test_closeWhileArmed)
+    {
+      auto receiver = makeReceiver(8, 1024);
+      if (!receiver)
+        GTEST_SKIP();
+
+      // cancelling the armed receive hands the socket back untouched
+      receiver.reset();
+
+      std::vector<char> bytes = pattern(100);
+      boost::asio::write(server_, boost::asio::buffer(bytes));
+
+      std::vector<char> received(bytes.size());
+      boost::asio::read(client_, boost::asio::buffer(received));
+      EXPECT_TRUE(bytes == received);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */